@@ -41,6 +41,7 @@ function(configure_imgui target_name)
             ${CMAKE_CURRENT_SOURCE_DIR}/external/imgui/backends
         )
         target_link_libraries(${target_name} PRIVATE imgui)
+        target_compile_definitions(${target_name} PRIVATE SHADERVIEWER_IMGUI)
         message(STATUS "ImGui found and added to build")
     else()
         message(WARNING "ImGui not found at external/imgui/. Please clone it there.")
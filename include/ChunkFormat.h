@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+
+// On-disk layout of chunked meshes, written by tools/meshchunk and streamed
+// by ChunkedMesh:
+//
+//   Header | vertex payloads, each page-aligned | Node table
+//
+// Nodes form an octree in breadth-first order (so a node's children are
+// contiguous). Leaves hold the original triangles of their cell; every
+// inner node holds a simplified version of everything below it, so each
+// level of the tree is a level of detail. Vertices are the same interleaved
+// [position | normal | texcoord] floats ObjModel draws.
+namespace ChunkFormat {
+
+constexpr char Magic[8] = {'S', 'V', 'C', 'H', 'N', 'K', '0', '1'};
+constexpr uint32_t FloatsPerVertex = 8;
+constexpr uint64_t PayloadAlignment = 4096;
+
+struct Header {
+    char magic[8];
+    uint32_t nodeCount;
+    uint32_t reserved;
+    uint64_t nodeTableOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+static_assert(sizeof(Header) == 48, "Header layout is part of the file format");
+
+struct Node {
+    float boundsMin[3]; // of the node's triangles, which cover its subtree
+    float boundsMax[3];
+    float geometricError; // how far the simplified surface may be off; 0 for leaves
+    uint32_t firstChild;  // index of the first of `childCount` contiguous children
+    uint32_t childCount;
+    uint32_t vertexCount;
+    uint64_t vertexOffset; // bytes from the start of the file
+};
+static_assert(sizeof(Node) == 48, "Node layout is part of the file format");
+
+} // namespace ChunkFormat
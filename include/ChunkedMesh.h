@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "ChunkFormat.h"
+#include "GLResource.h"
+#include "MappedFile.h"
+
+class Shader;
+class ThreadPool;
+
+// Mesh streamed from a chunk file written by tools/meshchunk. The file is
+// memory-mapped, never read whole: each frame update() walks the octree,
+// refining wherever a node's geometric error would show as more than a
+// few pixels, and only the chosen nodes have to be resident.
+//
+// Missing nodes are requested in order of screen-space error. Their pages
+// are faulted in on the thread pool, then uploaded on the GL thread within
+// a per-frame byte budget. When resident nodes exceed the memory cap, the
+// least recently used ones are evicted first. A node is replaced by its
+// children only once they are all resident, so the surface never has
+// holes while detail streams in.
+class ChunkedMesh {
+public:
+    struct Stats {
+        size_t nodes = 0;
+        size_t resident = 0;
+        size_t residentBytes = 0;
+        size_t drawn = 0;
+        size_t queued = 0;        // wanted but not resident
+        size_t capLimited = 0;    // wanted, but the cap holds only drawn nodes
+        size_t uploadedBytes = 0; // this frame
+    };
+
+    ChunkedMesh(const std::string& path, ThreadPool& pool);
+    ~ChunkedMesh();
+
+    ChunkedMesh(const ChunkedMesh&) = delete;
+    ChunkedMesh& operator=(const ChunkedMesh&) = delete;
+
+    bool isLoaded() const { return !m_Nodes.empty(); }
+
+    // Largest tolerated error, in pixels
+    void setErrorThreshold(float pixels) { m_ErrorThreshold = pixels; }
+    void setUploadBudget(size_t bytesPerFrame) { m_UploadBudget = bytesPerFrame; }
+    void setMemoryCap(size_t bytes) { m_MemoryCap = bytes; }
+    size_t memoryCap() const { return m_MemoryCap; }
+
+    // Model-space bounds, as with ObjModel
+    const glm::vec3& getBoundsMin() const { return m_BoundsMin; }
+    const glm::vec3& getBoundsMax() const { return m_BoundsMax; }
+
+    // Call once per frame on the GL thread, before drawing. `model` places
+    // the mesh; `viewportHeight` is in pixels.
+    void update(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                const glm::vec3& cameraPosition, int viewportHeight);
+
+    // Draws the nodes update() selected; untextured, white
+    void draw(const Shader& shader) const;
+    void drawGeometry() const;
+
+    // Whether wanted nodes are still on their way, or arrived after this
+    // frame was selected. Requests held back by the memory cap do not count:
+    // they wait for the view to change, not for the loader
+    bool isStreaming() const { return m_Stats.queued > 0 || m_Stats.uploadedBytes > 0; }
+    const Stats& stats() const { return m_Stats; }
+
+private:
+    struct Node {
+        ChunkFormat::Node disk;
+        glm::vec3 center;
+        float radius = 0.0f;
+
+        GLVertexArray vao;
+        GLBuffer vbo;
+        uint64_t lastUsed = 0; // frame
+        float priority = 0.0f; // screen-space error when requested
+        std::future<void> prefetch; // pages faulted in on the pool
+    };
+
+    bool isVisible(const Node& node) const;
+    float screenError(const Node& node) const;
+    void select(uint32_t index);
+    void request(uint32_t index, float priority);
+    void stream();
+    bool makeRoom(size_t bytes);
+    void upload(uint32_t index);
+    void evict(Node& node);
+
+    ThreadPool& m_Pool;
+    MappedFile m_File;
+    std::vector<Node> m_Nodes;
+    glm::vec3 m_BoundsMin = glm::vec3(0.0f), m_BoundsMax = glm::vec3(0.0f);
+
+    float m_ErrorThreshold = 1.5f;
+    size_t m_UploadBudget = 32u << 20;
+    size_t m_MemoryCap = 512u << 20;
+
+    // Per-frame state of update()
+    uint64_t m_Frame = 0;
+    glm::vec4 m_Planes[6];
+    glm::vec3 m_Camera = glm::vec3(0.0f); // in model space
+    float m_PixelsPerUnit = 0.0f;         // at distance 1
+    std::vector<uint32_t> m_Draw;
+    std::vector<uint32_t> m_Requests;
+    Stats m_Stats;
+};
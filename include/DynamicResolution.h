@@ -0,0 +1,71 @@
+#pragma once
+#include <memory>
+#include <glad/gl.h>
+#include "GLResource.h"
+#include "GpuTimer.h"
+#include "Shader.h"
+
+class ShaderWatcher;
+
+// Renders the scene into an offscreen target whose size follows the GPU
+// time of the scene pass: the scale drops as soon as the scene goes over
+// the target time and creeps back up while there is headroom. The result is
+// upscaled into the default framebuffer with a bilinear blit or a
+// sharpening pass (shaders/upscale.frag).
+class DynamicResolution {
+public:
+    enum class Filter { Bilinear, Sharpen };
+
+    explicit DynamicResolution(ShaderWatcher* watcher = nullptr);
+    ~DynamicResolution();
+
+    DynamicResolution(const DynamicResolution&) = delete;
+    DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+    // GPU time budget for the scene pass, in milliseconds
+    void setTargetTime(double milliseconds) { m_TargetTime = milliseconds; }
+    void setScaleRange(float minScale, float maxScale);
+
+    // Disabled renders straight into the default framebuffer at full size
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_Enabled; }
+    void setFilter(Filter filter) { m_Filter = filter; }
+    Filter filter() const { return m_Filter; }
+
+    // Framebuffer size, as reported by the resize callback
+    void resize(int width, int height);
+
+    // Binds the render target and viewport for the scene and starts timing
+    void beginScene();
+    // Stops timing, upscales into the default framebuffer and picks the
+    // scale for the next frames
+    void endScene();
+
+    float scale() const { return m_Enabled ? m_Scale : 1.0f; }
+    int renderWidth() const;
+    int renderHeight() const;
+    double gpuTime() const { return m_GpuTime; } // smoothed, milliseconds
+
+private:
+    void allocate();
+    void adapt(double milliseconds);
+    void release();
+
+    ShaderWatcher* m_Watcher;
+    std::unique_ptr<Shader> m_Upscale;
+    GpuTimer m_Timer;
+
+    GLFramebuffer m_Framebuffer;
+    GLTexture m_Color;
+    GLRenderbuffer m_Depth;
+    GLVertexArray m_EmptyVAO; // core profile needs one bound for attribute-less draws
+    int m_Width = 0, m_Height = 0; // framebuffer size; the target is allocated at this size
+
+    bool m_Enabled = true;
+    Filter m_Filter = Filter::Sharpen;
+    double m_TargetTime = 12.0;
+    float m_MinScale = 0.25f, m_MaxScale = 1.0f;
+    float m_Scale = 1.0f;
+    double m_GpuTime = 0.0;
+    int m_Cooldown = 0; // frames before measurements reflect the last scale change
+};
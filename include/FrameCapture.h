@@ -0,0 +1,97 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/gl.h>
+#include "GLResource.h"
+
+class ThreadPool;
+
+// Screenshots and video capture of the default framebuffer that do not
+// stall the render loop: glReadPixels writes into a ring of pixel pack
+// buffers, each fenced, and a buffer is only mapped once its fence has
+// signalled, normally a frame or two later. Encoding runs on the thread
+// pool; a writer thread appends encoded video frames to the output in
+// order.
+class FrameCapture {
+public:
+    enum class VideoFormat {
+        PngSequence, // path is a printf pattern, e.g. "frames/%05d.png"
+        Y4M,         // YUV4MPEG2 4:2:0, readable by ffmpeg and most players
+        RawRGBA,     // headerless top-down RGBA frames
+        FFmpeg,      // piped to a local ffmpeg, which picks the container from the path
+    };
+
+    // From the path: "%...png" -> PNG sequence, .y4m, .rgba/.raw, else ffmpeg
+    static VideoFormat formatForPath(const std::string& path);
+
+    explicit FrameCapture(ThreadPool& pool, size_t ringSize = 3);
+    // Finishes every pending readback, encode and write
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Taken by the next captureFrame()
+    void screenshot(const std::string& path);
+
+    // Records every captureFrame() until stopRecording(). The size is fixed
+    // for the whole recording; a resize ends it.
+    bool startRecording(const std::string& path, int fps, int width, int height);
+    void stopRecording();
+    bool isRecording() const { return m_Recording; }
+    size_t recordedFrames() const { return m_FrameIndex; }
+    // Animation time step while recording: 1 / fps, independent of how
+    // long frames take to render or encode
+    double timeStep() const { return 1.0 / m_Fps; }
+
+    // Call after the frame is rendered, before swapping: queues a readback
+    // when a screenshot is pending or a recording runs, and hands earlier
+    // readbacks that have completed to the encoders
+    void captureFrame(int width, int height);
+
+private:
+    struct Slot {
+        GLBuffer buffer;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+        int width = 0, height = 0;
+        std::string screenshotPath;
+        bool video = false;
+        uint64_t frameIndex = 0;
+    };
+
+    void collect(bool wait);
+    void finish(Slot& slot);
+    void writerLoop();
+
+    ThreadPool& m_Pool;
+    std::vector<Slot> m_Slots;
+    size_t m_Next = 0;
+    std::string m_PendingScreenshot;
+    std::vector<std::future<void>> m_Stills;
+
+    // Recording
+    bool m_Recording = false;
+    VideoFormat m_Format = VideoFormat::Y4M;
+    std::string m_Path;
+    int m_Fps = 60;
+    int m_Width = 0, m_Height = 0;
+    uint64_t m_FrameIndex = 0;
+    FILE* m_Output = nullptr;
+    bool m_OutputIsPipe = false;
+
+    // Encoded frames in submission order, consumed by the writer thread
+    std::deque<std::future<std::vector<unsigned char>>> m_WriteQueue;
+    std::mutex m_WriteMutex;
+    std::condition_variable m_WriteReady;
+    std::condition_variable m_WriteDrained;
+    bool m_WriterStopping = false;
+    std::thread m_Writer;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+
+// Decides when the viewer draws. On demand, a frame is only drawn when
+// something changed (requestRedraw()) or the scene animates (setAnimating());
+// otherwise the loop blocks in glfwWaitEventsTimeout instead of spinning.
+// Drawn frames can be capped to a maximum rate; pacing sleeps for most of
+// the wait and spins the last stretch, since OS sleeps overshoot.
+class FrameScheduler {
+public:
+    explicit FrameScheduler(double maxFps = 0.0);
+
+    // Off draws every iteration, like a plain poll loop
+    void setOnDemand(bool onDemand) { m_OnDemand = onDemand; }
+    bool isOnDemand() const { return m_OnDemand; }
+
+    // 0 = uncapped; setting the current cap again changes nothing
+    void setMaxFps(double fps);
+    double maxFps() const { return m_MaxFps; }
+
+    void requestRedraw() { m_Dirty = true; }
+    // Re-evaluated every frame, e.g. "the bound program reads `time`"
+    void setAnimating(bool animating) { m_Animating = animating; }
+    // Background work (shader builds, texture streaming) that needs the
+    // loop to come around again soon even when there is nothing to draw
+    void setBusy(bool busy) { m_Busy = busy; }
+
+    bool shouldDraw() const { return !m_OnDemand || m_Dirty || m_Animating; }
+
+    // Blocks until an input/window event arrives or the timeout passes.
+    // The idle timeout should be no longer than any polling interval that
+    // must keep running (e.g. ShaderWatcher's).
+    void waitForEvents();
+    void setIdleTimeout(double seconds) { m_IdleTimeout = seconds; }
+
+    // Call right before swapping: waits until the frame is due under the
+    // cap and clears the redraw request
+    void frameDone();
+
+    // Frames drawn per second, averaged over the last second or so
+    double drawnFps() const { return m_DrawnFps; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void paceUntil(Clock::time_point deadline);
+
+    bool m_OnDemand = true;
+    bool m_Dirty = true;
+    bool m_Animating = false;
+    bool m_Busy = false;
+    double m_MaxFps = 0.0;
+    double m_IdleTimeout = 0.25;
+    double m_BusyTimeout = 0.005;
+
+    Clock::time_point m_NextFrame;
+    Clock::duration m_SleepSlack = std::chrono::milliseconds(1); // observed oversleep, spun instead
+
+    Clock::time_point m_CountStart = Clock::now();
+    int m_FrameCount = 0;
+    double m_DrawnFps = 0.0;
+};
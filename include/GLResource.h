@@ -0,0 +1,139 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glad/gl.h>
+
+enum class GLResourceType {
+    Buffer,
+    Texture,
+    Renderbuffer,
+    Framebuffer,
+    VertexArray,
+    Query,
+    Shader,
+    Program,
+};
+constexpr size_t GLResourceTypeCount = 8;
+
+const char* resourceTypeName(GLResourceType type);
+
+// Where a GL object was created, for leak reports
+struct GLSite {
+    const char* file;
+    int line;
+};
+#define GL_HERE GLSite{__FILE__, __LINE__}
+
+// Every GL object created through GLObject, with a label, the GPU memory
+// its owner says it holds, and its creation site. Keeps per-type totals
+// and the peak of the total for the overlay and the report at exit.
+class GLRegistry {
+public:
+    struct Entry {
+        GLResourceType type;
+        GLuint id = 0;
+        std::string label;
+        size_t bytes = 0;
+        GLSite site;
+    };
+
+    static GLRegistry& shared();
+
+    // glObjectLabel (GL 4.3 / KHR_debug) is outside the GL 3.3 loader;
+    // `load` (e.g. glfwGetProcAddress) fetches it when the driver has it,
+    // so debuggers and driver messages show the labels
+    void enableLabels(GLADloadfunc load);
+
+    // Generates and registers an object; `shaderType` is the stage of
+    // shader objects
+    GLuint create(GLResourceType type, const std::string& label, GLSite site, GLenum shaderType = 0);
+    // Deletes and unregisters it
+    void destroy(GLResourceType type, GLuint id);
+
+    void setBytes(GLResourceType type, GLuint id, size_t bytes);
+    size_t bytes(GLResourceType type, GLuint id) const;
+
+    // Call once per frame on the GL thread: glGen* only reserves names, so
+    // labels are attached once the objects exist (after their first bind)
+    void update();
+
+    size_t liveCount(GLResourceType type) const;
+    size_t liveBytes(GLResourceType type) const;
+    size_t totalBytes() const;
+    size_t peakBytes() const;
+
+    // One line for the overlay: total, peak and the types holding memory
+    std::string summary() const;
+    // Prints every object still registered; returns how many there are
+    size_t reportLeaks(std::ostream& out) const;
+
+private:
+    using ObjectLabelProc = void(GLAD_API_PTR*)(GLenum identifier, GLuint name, GLsizei length, const GLchar* label);
+
+    static uint64_t key(GLResourceType type, GLuint id) { return (uint64_t(type) << 32) | id; }
+
+    mutable std::mutex m_Mutex;
+    std::unordered_map<uint64_t, Entry> m_Entries;
+    std::vector<uint64_t> m_Unlabelled;
+    size_t m_Count[GLResourceTypeCount] = {};
+    size_t m_Bytes[GLResourceTypeCount] = {};
+    size_t m_Total = 0;
+    size_t m_Peak = 0;
+    ObjectLabelProc m_ObjectLabel = nullptr;
+};
+
+// Owning handle to one GL object, registered with GLRegistry for as long
+// as it lives. Converts to GLuint, so it drops into GL calls as is.
+template <GLResourceType Type>
+class GLObject {
+public:
+    GLObject() = default;
+    ~GLObject() { reset(); }
+
+    GLObject(GLObject&& other) noexcept : m_ID(std::exchange(other.m_ID, 0)) {}
+    GLObject& operator=(GLObject&& other) noexcept {
+        if (this != &other) {
+            reset();
+            m_ID = std::exchange(other.m_ID, 0);
+        }
+        return *this;
+    }
+    GLObject(const GLObject&) = delete;
+    GLObject& operator=(const GLObject&) = delete;
+
+    // Replaces the object held, if any
+    void create(const std::string& label, GLSite site, GLenum shaderType = 0) {
+        reset();
+        m_ID = GLRegistry::shared().create(Type, label, site, shaderType);
+    }
+    void reset() {
+        if (m_ID)
+            GLRegistry::shared().destroy(Type, m_ID);
+        m_ID = 0;
+    }
+
+    // GPU memory held, as allocated by the owner (glBufferData, glTexImage*, ...)
+    void setBytes(size_t bytes) { GLRegistry::shared().setBytes(Type, m_ID, bytes); }
+    size_t bytes() const { return GLRegistry::shared().bytes(Type, m_ID); }
+
+    GLuint id() const { return m_ID; }
+    operator GLuint() const { return m_ID; }
+
+private:
+    GLuint m_ID = 0;
+};
+
+using GLBuffer = GLObject<GLResourceType::Buffer>;
+using GLTexture = GLObject<GLResourceType::Texture>;
+using GLRenderbuffer = GLObject<GLResourceType::Renderbuffer>;
+using GLFramebuffer = GLObject<GLResourceType::Framebuffer>;
+using GLVertexArray = GLObject<GLResourceType::VertexArray>;
+using GLQuery = GLObject<GLResourceType::Query>;
+using GLShader = GLObject<GLResourceType::Shader>;
+using GLProgram = GLObject<GLResourceType::Program>;
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/gl.h>
+#include "GLTraceFormat.h"
+
+// Records every GL call the application makes through glad into a binary
+// trace (see GLTraceFormat.h) that tools/glreplay re-issues headlessly:
+// arguments, return values, the client memory pointers refer to, CPU time
+// per call and frame boundaries. It hooks glad's debug pre/post callbacks,
+// so it sees exactly what the debug build already checks with glGetError;
+// calls made outside glad (ImGui's own loader) are not in the trace.
+class GLTracer {
+public:
+    static GLTracer& shared();
+
+    // Installs the callbacks (which keep glad's error reporting while no
+    // trace runs) and starts writing `path`; the size is the framebuffer's
+    bool start(const std::string& path, int width, int height);
+    // Writes the remaining records and closes the file
+    void stop();
+    bool isRecording() const { return m_Output != nullptr; }
+
+    // Call once per frame on the GL thread, before swapping
+    void frameDone();
+
+    size_t recordedCalls() const { return m_Calls; }
+    size_t recordedFrames() const { return m_Frames; }
+    uint64_t writtenBytes() const { return m_Written + m_Pending.size(); }
+    // Calls whose pointer arguments could not be sized; replay skips them
+    size_t unsizedCalls() const { return m_Unsized; }
+
+private:
+    struct Mapping {
+        const uint8_t* data = nullptr;
+        size_t length = 0;
+        bool write = false;
+    };
+
+    GLTracer() = default;
+
+    static void preCall(const char* name, GLADapiproc function, int count, ...);
+    static void postCall(void* result, const char* name, GLADapiproc function, int count, ...);
+
+    void record(const char* name, void* result, va_list* arguments);
+    uint32_t functionId(const char* name);
+    void trackBuffers(const std::string& name, const GLTraceFormat::Value* values, GLTraceFormat::Value result);
+    GLuint boundBuffer(GLenum target) const;
+    void flush(bool force);
+
+    std::FILE* m_Output = nullptr;
+    std::vector<uint8_t> m_Pending;
+    uint64_t m_Written = 0;
+
+    // Keyed by glad's name literals, which never move
+    std::unordered_map<const char*, uint32_t> m_Ids;
+    std::vector<const GLTraceFormat::FunctionInfo*> m_Functions;
+    GLTraceFormat::ClientState m_State;
+
+    // Buffer bindings and mappings, to capture what the application wrote
+    // into a mapping when it is unmapped
+    std::unordered_map<GLenum, GLuint> m_Bindings;
+    std::unordered_map<GLuint, GLuint> m_ElementBuffers; // per vertex array
+    GLuint m_VertexArray = 0;
+    std::unordered_map<GLuint, size_t> m_BufferSizes;
+    std::unordered_map<GLuint, Mapping> m_Mappings;
+    std::vector<uint8_t> m_Unmapped;
+    bool m_HasUnmapped = false;
+
+    std::chrono::steady_clock::time_point m_CallStart, m_PreviousFrame;
+    size_t m_Calls = 0;
+    size_t m_Frames = 0;
+    size_t m_Unsized = 0;
+    bool m_Installed = false;
+};
@@ -0,0 +1,213 @@
+#pragma once
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <glad/gl.h>
+
+// Binary GL call trace, written by GLTracer and read by tools/glreplay.
+//
+//   header   Magic, u32 Version, u32 framebuffer width, u32 height
+//   records  u8 Tag, then
+//     Function  varint id, varint length, name        (before its first call)
+//     Call      varint id, varint duration (ns of CPU time in the driver),
+//               the arguments, the return value,
+//               varint payload count, then per payload
+//                 varint parameter index, varint size, bytes
+//     Frame     varint ns since the previous Frame
+//     End
+//
+// Values are stored by Kind: integers as LEB128 varints (zigzag for signed
+// types), floats and doubles as raw little-endian bytes, pointers as
+// varints of their address. Replay only reuses a pointer's value where it
+// is an offset into a bound buffer; client memory behind a pointer goes
+// into a payload. Payload index == parameter count carries the bytes
+// written into a mapping, attached to the glUnmapBuffer that ends it.
+namespace GLTraceFormat {
+
+constexpr char Magic[8] = {'S', 'V', 'G', 'L', 'T', 'R', 'C', '1'};
+constexpr uint32_t Version = 1;
+constexpr size_t MaxParams = 16; // GL 3.3 tops out at 11
+
+enum Tag : uint8_t { Function = 1, Call = 2, Frame = 3, End = 4 };
+
+enum class Kind : uint8_t { Void, Unsigned, Signed, Float, Double, Pointer };
+
+// What a parameter means to replay
+enum class Role : uint8_t {
+    Value,      // reissued as recorded
+    Object,     // a GL name, remapped to the one replay created
+    Objects,    // const array of `n` names (glDelete*)
+    NewObjects, // array glGen* fills with `n` names
+    Location,   // uniform location in the current program
+    Sync,
+    CString,    // const GLchar*, stored with its terminator
+    StringList, // const GLchar* const*, `count` strings (glShaderSource)
+    Input,      // other const client memory (or a buffer offset)
+    Output,     // written by GL; replay passes scratch memory
+};
+
+// Object name spaces, for remapping
+enum class Space : uint8_t {
+    None, Buffer, Texture, Program, Shader, Framebuffer, Renderbuffer, VertexArray, Query, Sampler, Count
+};
+
+union Value {
+    uint64_t u;
+    int64_t i;
+    double f;
+};
+
+struct Param {
+    std::string type; // e.g. "const GLfloat *"
+    std::string name;
+    Kind kind = Kind::Unsigned;
+    Role role = Role::Value;
+    Space space = Space::None;
+};
+
+struct FunctionInfo {
+    const char* name;
+    Kind result;
+    Space resultSpace; // glCreateShader, glCreateProgram
+    std::vector<Param> params;
+
+    // Decodes the promoted arguments glad's debug callbacks pass on
+    void (*read)(va_list* arguments, Value* values);
+    Value (*readResult)(const void* result);
+    // Calls the real (non-debug) glad pointer
+    Value (*call)(const Value* values);
+
+    int find(const char* param) const;
+};
+
+// Every function in GLTraceFunctions.inc, in its order
+const std::vector<FunctionInfo>& functions();
+const FunctionInfo* findFunction(const std::string& name);
+
+// Pixel-store and buffer state that decides how many bytes pointer
+// arguments refer to; both sides track it from the calls themselves
+struct ClientState {
+    GLuint unpackBuffer = 0, packBuffer = 0;
+    GLint unpackAlignment = 4, unpackRowLength = 0, unpackImageHeight = 0;
+    GLint packAlignment = 4, packRowLength = 0;
+
+    void observe(const FunctionInfo& function, const Value* values);
+};
+
+// Client memory behind pointer parameter `index`: 0 when the pointer is
+// null or an offset into a bound buffer (reissue the value as is),
+// SIZE_MAX when unknown
+size_t clientBytes(const FunctionInfo& function, size_t index, const Value* values, const ClientState& state);
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value);
+bool getVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value);
+void putValue(std::vector<uint8_t>& out, Kind kind, Value value);
+bool getValue(const uint8_t*& in, const uint8_t* end, Kind kind, Value& value);
+
+// Glue between glad's PFN typedefs and Values
+
+template <typename T>
+constexpr Kind kindOf() {
+    if constexpr (std::is_void_v<T>)
+        return Kind::Void;
+    else if constexpr (std::is_pointer_v<T>)
+        return Kind::Pointer;
+    else if constexpr (std::is_same_v<T, float>)
+        return Kind::Float;
+    else if constexpr (std::is_floating_point_v<T>)
+        return Kind::Double;
+    else if constexpr (std::is_signed_v<T>)
+        return Kind::Signed;
+    else
+        return Kind::Unsigned;
+}
+
+template <typename T>
+Value toValue(T value) {
+    Value result;
+    result.u = 0;
+    if constexpr (std::is_pointer_v<T>)
+        result.u = reinterpret_cast<uintptr_t>(value);
+    else if constexpr (std::is_floating_point_v<T>)
+        result.f = value;
+    else if constexpr (std::is_signed_v<T>)
+        result.i = value;
+    else
+        result.u = value;
+    return result;
+}
+
+template <typename T>
+T fromValue(Value value) {
+    if constexpr (std::is_pointer_v<T>)
+        return reinterpret_cast<T>(static_cast<uintptr_t>(value.u));
+    else if constexpr (std::is_floating_point_v<T>)
+        return static_cast<T>(value.f);
+    else if constexpr (std::is_signed_v<T>)
+        return static_cast<T>(value.i);
+    else
+        return static_cast<T>(value.u);
+}
+
+// Variadic arguments arrive promoted: small integers as int, floats as double
+template <typename T>
+Value readArgument(va_list* arguments) {
+    if constexpr (std::is_pointer_v<T>)
+        return toValue(reinterpret_cast<T>(va_arg(*arguments, void*)));
+    else if constexpr (std::is_floating_point_v<T>)
+        return toValue(va_arg(*arguments, double));
+    else if constexpr (sizeof(T) < sizeof(int))
+        return toValue(static_cast<T>(va_arg(*arguments, int)));
+    else
+        return toValue(va_arg(*arguments, T));
+}
+
+template <typename F>
+struct FunctionTraits;
+
+template <typename R, typename... Args>
+struct FunctionTraits<R(GLAD_API_PTR*)(Args...)> {
+    using Pointer = R(GLAD_API_PTR*)(Args...);
+
+    static std::vector<Kind> kinds() { return {kindOf<Args>()...}; }
+    static Kind result() { return kindOf<R>(); }
+
+    static void read(va_list* arguments, Value* values) {
+        size_t n = 0;
+        ((values[n++] = readArgument<Args>(arguments)), ...);
+        (void)arguments;
+        (void)values;
+        (void)n;
+    }
+
+    static Value readResult(const void* result) {
+        if constexpr (std::is_void_v<R>) {
+            (void)result;
+            return Value{};
+        } else {
+            return result ? toValue(*static_cast<const R*>(result)) : Value{};
+        }
+    }
+
+    static Value call(Pointer function, const Value* values) {
+        return callWith(function, values, std::index_sequence_for<Args...>());
+    }
+
+private:
+    template <size_t... I>
+    static Value callWith(Pointer function, const Value* values, std::index_sequence<I...>) {
+        (void)values;
+        if constexpr (std::is_void_v<R>) {
+            function(fromValue<Args>(values[I])...);
+            return Value{};
+        } else {
+            return toValue(function(fromValue<Args>(values[I])...));
+        }
+    }
+};
+
+} // namespace GLTraceFormat
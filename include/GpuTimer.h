@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glad/gl.h>
+#include "GLResource.h"
+
+// GL_TIME_ELAPSED measurements that never stall the pipeline: each
+// begin()/end() pair takes the next query of a small ring, and results are
+// only read once the driver reports them available (usually 1-3 frames
+// later). Only one timer can be running at a time (a GL restriction).
+class GpuTimer {
+public:
+    explicit GpuTimer(size_t depth = 4);
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    // If every query is still in flight the measurement is skipped
+    void begin();
+    void end();
+
+    // Newest completed measurement in milliseconds; false if nothing new
+    // has completed since the last call
+    bool poll(double& milliseconds);
+
+private:
+    std::vector<GLQuery> m_Queries;
+    size_t m_Next = 0;    // used by the next begin()
+    size_t m_Pending = 0; // submitted but not read; the oldest is m_Next - m_Pending
+    bool m_Running = false;
+};
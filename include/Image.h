@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// CPU-side 8-bit RGBA image. Rows are stored bottom-up to match OpenGL's
+// texture origin, so OBJ texcoords can be used unchanged.
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // width * height * 4
+
+    size_t byteSize() const { return pixels.size(); }
+};
+
+bool readFileBytes(const std::string& path, std::vector<unsigned char>& bytes);
+
+// Decodes TGA (raw/RLE) and binary PPM/PGM natively; any format stb_image
+// understands when external/stb/stb_image.h is present.
+bool decodeImage(const std::vector<unsigned char>& bytes, Image& out, std::string& error);
+
+// PNG (8-bit RGB, alpha dropped) with per-row filtering and a fixed-Huffman
+// deflate stream; rows are flipped back to PNG's top-down order.
+void encodePNG(const Image& image, std::vector<unsigned char>& out);
+
+// Full mip chain with a 2x2 box filter, level 0 being the input image.
+std::vector<Image> buildMipChain(Image base);
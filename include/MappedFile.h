@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are read from disk on
+// first access, so files far larger than RAM can be mapped and only the
+// parts in use occupy memory (and the OS can drop them again).
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return m_Data != nullptr; }
+    const unsigned char* data() const { return m_Data; }
+    size_t size() const { return m_Size; }
+
+    // Hints that [offset, offset + length) will be read soon; a no-op where
+    // the platform has no such hint
+    void willNeed(size_t offset, size_t length) const;
+
+private:
+    const unsigned char* m_Data = nullptr;
+    size_t m_Size = 0;
+#ifdef _WIN32
+    void* m_File = nullptr;
+    void* m_Mapping = nullptr;
+#endif
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+// Small triangle cluster of a mesh that can be culled on its own
+struct Meshlet {
+    glm::vec3 center = glm::vec3(0.0f); // bounding sphere, model space
+    float radius = 0.0f;
+    glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f); // average face normal
+    float coneCutoff = 1.0f;            // sine of the normal cone's half angle; 1 = never back-facing
+    GLint first = 0;                    // vertex range in the model's vertex buffer
+    GLsizei count = 0;
+    uint32_t material = 0;
+};
+
+namespace Meshlets {
+
+constexpr size_t MaxVertices = 64;
+constexpr size_t MaxTriangles = 124;
+
+struct Stats {
+    size_t total = 0;
+    size_t outside = 0;
+    size_t backFacing = 0;
+};
+
+// Partitions the non-indexed triangles in vertices[first, first + count)
+// (interleaved, `stride` floats per vertex, position first) into meshlets of
+// at most MaxVertices unique vertices and MaxTriangles triangles, and
+// reorders that range so every meshlet is contiguous. Clusters are grown
+// greedily over shared vertices, preferring triangles that add none.
+std::vector<Meshlet> build(std::vector<float>& vertices, size_t stride, GLint first, GLsizei count,
+                           uint32_t material);
+
+// Clustered vertices and meshlets, valid while `sourceHash` (of the
+// unclustered vertex data) matches. Written to a temporary name first.
+bool writeCache(const std::string& path, uint64_t sourceHash, const std::vector<float>& vertices,
+                const std::vector<Meshlet>& meshlets);
+bool readCache(const std::string& path, uint64_t sourceHash, std::vector<float>& vertices,
+               std::vector<Meshlet>& meshlets);
+
+// View-dependent tests, all in model space. Planes come from
+// extractFrustum() and must be normalized (xyz unit length).
+void extractFrustum(const glm::mat4& modelViewProjection, glm::vec4 planes[6]);
+bool isOutside(const Meshlet& meshlet, const glm::vec4 planes[6]);
+bool isBackFacing(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+
+} // namespace Meshlets
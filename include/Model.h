@@ -1,5 +1,6 @@
 #pragma once
 #include <glad/gl.h>
+#include "GLResource.h"
 
 class Model {
 public:
@@ -7,5 +8,6 @@ public:
     ~Model();
     void draw() const;
 private:
-    GLuint VAO, VBO;
+    GLVertexArray VAO;
+    GLBuffer VBO;
 };
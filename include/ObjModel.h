@@ -1,13 +1,83 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <vector>
 #include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "GLResource.h"
+#include "Meshlets.h"
+
+class PointCloud;
+class Shader;
+class SoftwareRasterizer;
+class SoftwareTexture;
+class Texture;
+class TextureCache;
 
 class ObjModel {
 public:
-    ObjModel(const std::string& path);
+    // Where the vertices live: in a GL buffer, or in memory for
+    // SoftwareRasterizer, which needs no GL context at all
+    enum class Storage { GPU, CPU };
+
+    // Textures referenced by the OBJ's materials are requested from
+    // `textures` when given; without a cache the model is untextured.
+    // CPU storage decodes them itself and ignores `textures`.
+    // Meshlet clustering is cached in `meshCacheDir` (empty disables).
+    ObjModel(const std::string& path, TextureCache* textures = nullptr,
+             const std::string& meshCacheDir = "cache/meshes", Storage storage = Storage::GPU);
     ~ObjModel();
-    void draw() const;
+    void draw(const Shader& shader) const;
+    // CPU storage only: queues every material range on `target`, which
+    // shades them like default.frag with its current uniforms
+    void draw(SoftwareRasterizer& target) const;
+    // Every triangle in one call, no material state (depth-only passes)
+    void drawGeometry() const;
+    // Like draw(), but skips meshlets outside the frustum or facing away
+    // from the camera; survivors go out in one glMultiDrawArrays per material,
+    // with back-face culling on so single triangles match the meshlet test
+    void drawCulled(const Shader& shader, const glm::mat4& model, const glm::mat4& viewProjection,
+                    const glm::vec3& cameraPosition, Meshlets::Stats& stats) const;
+    // One glDrawArraysInstanced per material for `instances` copies; their
+    // model matrices are read from `buffer` at `offset` (tightly packed
+    // mat4s) by the INSTANCED shader variant. Triangle models only.
+    void drawInstanced(const Shader& shader, GLuint buffer, GLintptr offset, GLsizei instances) const;
+    size_t meshletCount() const { return meshlets.size(); }
+    // Whether any material has a texture (selects the DIFFUSE_MAP shader variant)
+    bool hasTextures() const;
+    // Axis-aligned bounds in model space, i.e. after centering and scaling
+    const glm::vec3& getBoundsMin() const { return boundsMin; }
+    const glm::vec3& getBoundsMax() const { return boundsMax; }
+    // Set instead of triangles when the OBJ has no faces; draw() and
+    // friends then draw its points
+    PointCloud* pointCloud() const { return points.get(); }
 private:
-    GLuint VAO = 0, VBO = 0;
+    struct Material {
+        glm::vec3 diffuseColor = glm::vec3(1.0f);
+        std::shared_ptr<Texture> diffuseMap;
+        std::shared_ptr<SoftwareTexture> softwareMap; // CPU storage
+    };
+    // Contiguous run of vertices sharing one material
+    struct DrawRange {
+        GLint first;
+        GLsizei count;
+        size_t material;
+    };
+
+    void bindMaterial(const Shader& shader, const Material& material) const;
+    void buildMeshlets(std::vector<float>& vertices, const std::string& cacheDir);
+
+    GLVertexArray VAO;
+    GLBuffer VBO;
     GLsizei vertexCount = 0;
+    std::vector<float> cpuVertices; // CPU storage, in the VBO's layout
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    std::vector<Material> materials;
+    std::vector<DrawRange> ranges;
+    std::vector<Meshlet> meshlets; // in vertex order, so grouped by material
+    std::unique_ptr<PointCloud> points;
+
+    // Scratch for drawCulled()
+    mutable std::vector<GLint> drawFirsts;
+    mutable std::vector<GLsizei> drawCounts;
 };
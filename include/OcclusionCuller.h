@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "GLResource.h"
+#include "Shader.h"
+
+class ShaderWatcher;
+
+// Frustum and hierarchical-Z occlusion culling for many objects:
+//  1. the objects visible last frame are depth-rendered into a small
+//     offscreen depth texture (they are the likely occluders)
+//  2. its mip chain is built on the GPU with a max-depth reduction (Hi-Z)
+//  3. one coarse level is copied into a fenced pixel buffer, mapped a
+//     frame or two later once the GPU is done, and reduced further on the CPU
+//  4. each object's AABB is projected with the view that pyramid was
+//     rendered from and its nearest depth compared to the farthest depth
+//     stored over its screen rectangle
+// GL 3.3 has no compute or indirect draws, so the test runs on the CPU.
+// The CPU never waits for the GPU; the price is that objects uncovered by
+// camera motion can show up a frame or two late.
+class OcclusionCuller {
+public:
+    struct Object {
+        glm::mat4 model;
+        glm::vec3 boundsMin, boundsMax; // model space
+    };
+
+    struct Stats {
+        size_t objects = 0;
+        size_t frustumCulled = 0;
+        size_t occluded = 0;
+        size_t occluders = 0; // drawn in the depth pass
+        double cpuTime = 0.0; // milliseconds, including the mapped readback
+    };
+
+    // `width` is the depth pass resolution cap; its height follows the aspect
+    explicit OcclusionCuller(int width = 512, ShaderWatcher* watcher = nullptr);
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Off leaves frustum culling only
+    void setOcclusionEnabled(bool enabled) { m_OcclusionEnabled = enabled; }
+    bool isOcclusionEnabled() const { return m_OcclusionEnabled; }
+
+    // Fills `visible` (one entry per object). `drawDepth(i)` must draw
+    // object i's geometry; the depth shader is bound with view/projection
+    // set, and `model` is set before each call. Changes the framebuffer
+    // and viewport bindings.
+    void cull(const std::vector<Object>& objects, const glm::mat4& view, const glm::mat4& projection, float aspect,
+              const std::function<void(size_t)>& drawDepth, std::vector<char>& visible);
+
+    const Stats& stats() const { return m_Stats; }
+
+private:
+    struct Level {
+        int width = 0, height = 0;
+        std::vector<float> depth;
+    };
+
+    void allocate(int width, int height);
+    void release();
+    void buildPyramid();
+    void readBack(const glm::mat4& viewProjection);
+    void collect();
+    void reducePyramid();
+    void discardReadbacks();
+    bool isOccluded(const glm::vec2& ndcMin, const glm::vec2& ndcMax, float nearestDepth) const;
+
+    ShaderWatcher* m_Watcher;
+    std::unique_ptr<Shader> m_DepthShader;
+    std::unique_ptr<Shader> m_ReduceShader;
+    GLVertexArray m_EmptyVAO;
+
+    GLFramebuffer m_Framebuffer;
+    GLTexture m_DepthTexture; // with a full mip chain of max depths
+    int m_MaxWidth;
+    int m_Width = 0, m_Height = 0;
+    int m_LevelCount = 0;
+    int m_ReadbackLevel = 0;
+
+    std::vector<Level> m_Levels; // CPU pyramid; [0] is the read-back GPU level
+    glm::mat4 m_PyramidViewProjection = glm::mat4(1.0f); // what m_Levels saw
+    bool m_HasPyramid = false;
+
+    // Readback ring for the GPU pyramid's coarsest level
+    struct Readback {
+        GLBuffer buffer;
+        GLsync fence = nullptr;
+        int width = 0, height = 0;
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+    };
+    std::array<Readback, 3> m_Readbacks;
+    size_t m_NextReadback = 0;
+    std::vector<char> m_Occluders; // visible last frame
+    bool m_OcclusionEnabled = true;
+    Stats m_Stats;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "GLResource.h"
+#include "GpuTimer.h"
+#include "Shader.h"
+
+class ShaderWatcher;
+
+// Debug view of where fragments are spent. The scene is drawn again with
+// additive blending into a float target, each fragment that passes the
+// depth test adding either 1 (overdraw) or the measured cost per fragment
+// of its draw (fragment cost: GPU time of the draw with the real shader
+// divided by the fragments it produced). The target is shown through a
+// colormap with a histogram in the corner; the counts are read back
+// asynchronously for the average and the histogram.
+class OverdrawView {
+public:
+    enum class Mode { Overdraw, FragmentCost };
+
+    static constexpr size_t HistogramBins = 16;
+
+    struct Stats {
+        double average = 0.0;       // per covered pixel
+        double screenAverage = 0.0; // per framebuffer pixel
+        double coverage = 0.0;      // fraction of pixels with at least one fragment
+        float maxValue = 0.0f;
+        std::array<float, HistogramBins> histogram{}; // fraction of covered pixels per bin of (0, range]
+    };
+
+    explicit OverdrawView(ShaderWatcher* watcher = nullptr);
+    ~OverdrawView();
+
+    OverdrawView(const OverdrawView&) = delete;
+    OverdrawView& operator=(const OverdrawView&) = delete;
+
+    void setMode(Mode mode) { m_Mode = mode; }
+    Mode mode() const { return m_Mode; }
+    // A depth-only pass first, so only the visible fragment of each pixel
+    // is shaded (and counted)
+    void setDepthPrepass(bool enabled) { m_DepthPrepass = enabled; }
+    bool hasDepthPrepass() const { return m_DepthPrepass; }
+
+    // Framebuffer size, as reported by the resize callback
+    void resize(int width, int height);
+
+    // Renders the heatmap into the default framebuffer. `draw(id, shader)`
+    // issues the draw of object `id` with `shader` bound (setting its
+    // "model" uniform); ids identify draws across frames for their
+    // timings. `sceneShader` must already have its other uniforms set.
+    void render(const std::vector<size_t>& draws, Shader& sceneShader, const glm::mat4& view,
+                const glm::mat4& projection, const std::function<void(size_t, Shader&)>& draw);
+
+    // Values are layers in Overdraw mode and nanoseconds per pixel in
+    // FragmentCost mode; a frame or two old
+    const Stats& stats() const { return m_Stats; }
+    // Value at the top of the colormap and histogram
+    float range() const;
+
+private:
+    // Per-draw GPU time and fragment count, each a ring of queries read
+    // once available and smoothed over frames
+    struct DrawCost {
+        std::unique_ptr<GpuTimer> timer;
+        std::array<GLQuery, 4> samples;
+        size_t next = 0, pending = 0;
+        double time = 0.0;      // milliseconds
+        double fragments = 0.0; // that passed the depth test
+    };
+
+    void allocate();
+    void release();
+    void drawScene(const std::vector<size_t>& draws, Shader& shader, bool timed, bool counted,
+                   const std::function<void(size_t, Shader&)>& draw);
+    void pollCosts();
+    void readBack();
+    void collect();
+
+    ShaderWatcher* m_Watcher;
+    std::unique_ptr<Shader> m_CountShader;
+    std::unique_ptr<Shader> m_DisplayShader;
+
+    GLFramebuffer m_Framebuffer;
+    GLTexture m_Counts; // R32F
+    GLRenderbuffer m_Depth;
+    GLVertexArray m_EmptyVAO;
+    int m_Width = 0, m_Height = 0;
+
+    Mode m_Mode = Mode::Overdraw;
+    bool m_DepthPrepass = false;
+    std::vector<DrawCost> m_Costs; // indexed by draw id
+
+    // Readback ring for the statistics
+    struct Readback {
+        GLBuffer buffer;
+        GLsync fence = nullptr;
+        int width = 0, height = 0;
+        float range = 1.0f;
+    };
+    std::array<Readback, 2> m_Readbacks;
+    size_t m_NextReadback = 0;
+    Stats m_Stats;
+    float m_CostRange = 1.0f; // smoothed maximum in FragmentCost mode
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+struct GLFWwindow;
+
+// Stats display. Built with ImGui (SHADERVIEWER_IMGUI) it is a small panel
+// drawn over the scene; without it the lines are shown in the window title,
+// refreshed a few times per second.
+class Overlay {
+public:
+    // Create after the viewer's own GLFW callbacks are installed: the ImGui
+    // backend chains to them
+    explicit Overlay(GLFWwindow* window);
+    ~Overlay();
+
+    Overlay(const Overlay&) = delete;
+    Overlay& operator=(const Overlay&) = delete;
+
+    // Adds a line, or replaces the value of the line with the same label
+    void set(const std::string& label, const std::string& value);
+    void remove(const std::string& label);
+
+    // Draws into the default framebuffer; call right before swapping
+    void render();
+
+private:
+    GLFWwindow* m_Window;
+    std::string m_Title;
+    std::vector<std::pair<std::string, std::string>> m_Lines; // in insertion order
+    double m_LastTitleUpdate = 0.0;
+};
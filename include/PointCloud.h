@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "GLResource.h"
+
+class Shader;
+
+// Points of a vertex-only OBJ (a scan without faces), drawn as round
+// sprites sized by their distance to the camera.
+//
+// Points are sorted along a Morton curve and then stored coarse to fine:
+// every 2^L-th point of that order first, then the points halfway between
+// those, down to the odd ones, each level still in curve order. Any prefix
+// of the buffer is then an evenly spread subsample of the whole cloud, so
+// drawing fewer points just draws a shorter prefix (with bigger sprites to
+// cover the gaps). update() picks that prefix: no more
+// than a few points per covered pixel, at most the point budget while the
+// view moves, and doubling each frame up to everything once it holds still.
+class PointCloud {
+public:
+    // `positions` as xyz triples in model space; `colors` as rgb triples in
+    // [0, 1], one per point, or empty for white
+    PointCloud(const std::vector<float>& positions, const std::vector<float>& colors, const std::string& label);
+
+    PointCloud(const PointCloud&) = delete;
+    PointCloud& operator=(const PointCloud&) = delete;
+
+    size_t size() const { return m_Count; }
+
+    // Points drawn per frame while the view changes
+    void setPointBudget(size_t points) { m_PointBudget = points; }
+    // Density cap over the cloud's projected bounds
+    void setMaxPointsPerPixel(float points) { m_MaxPointsPerPixel = points; }
+    // Sprite diameter relative to the estimated point spacing
+    void setPointScale(float scale) { m_PointScale = scale; }
+
+    // Call once per frame on the GL thread, before drawing
+    void update(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, int viewportWidth,
+                int viewportHeight);
+
+    // Sets "pointScale" when `shader` has it (shaders/points.vert) and
+    // draws the prefix chosen by update()
+    void draw(const Shader& shader) const;
+    // The same prefix as 1-pixel points, for depth-only passes
+    void drawGeometry() const;
+
+    size_t drawnCount() const { return m_Drawn; }
+    // Whether later frames will draw more points of an unchanged view
+    bool isRefining() const { return m_Drawn < m_Target; }
+
+private:
+    GLVertexArray m_VAO;
+    GLBuffer m_VBO;
+    size_t m_Count = 0;
+    float m_Spacing = 0.0f; // estimated distance between neighbouring points
+    glm::vec3 m_BoundsMin = glm::vec3(0.0f), m_BoundsMax = glm::vec3(0.0f);
+
+    size_t m_PointBudget = 8u << 20;
+    float m_MaxPointsPerPixel = 4.0f;
+    float m_PointScale = 1.5f;
+
+    // Per-frame state of update()
+    glm::mat4 m_LastModelView = glm::mat4(0.0f), m_LastProjection = glm::mat4(0.0f);
+    int m_LastWidth = 0, m_LastHeight = 0;
+    size_t m_Drawn = 0;  // prefix drawn this frame
+    size_t m_Target = 0; // prefix a still view refines to
+    float m_FocalScale = 0.0f;    // projection[1][1]
+};
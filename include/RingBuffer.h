@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+#include "GLResource.h"
+
+// Per-frame dynamic GPU data (instance transforms, uniform blocks) without
+// implicit syncs. One buffer is split into `regions` frame regions; each
+// frame suballocates linearly from the next region, which the GPU finished
+// reading frames ago, and fences it when the frame is submitted. Only if
+// the GPU falls more than `regions - 1` frames behind does beginFrame()
+// wait, and that wait is measured.
+//
+// GL 3.3 has no persistent mapping, so each allocation maps just its own
+// range with GL_MAP_UNSYNCHRONIZED_BIT (the fence already guarantees the
+// GPU is done with it) and commit() unmaps it again before any draw reads
+// the buffer. Only one allocation can be mapped at a time.
+class RingBuffer {
+public:
+    struct Allocation {
+        GLuint buffer = 0;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+        void* data = nullptr; // valid until commit(); null from upload()
+
+        explicit operator bool() const { return size != 0; }
+    };
+
+    struct Stats {
+        size_t frames = 0;
+        size_t waits = 0;         // frames that had to wait for their region
+        double waitTime = 0.0;    // milliseconds, last frame
+        double maxWaitTime = 0.0; // milliseconds, any frame
+        size_t usedBytes = 0;     // last frame, including alignment padding
+        size_t peakBytes = 0;     // any frame
+        size_t overflows = 0;     // allocations that did not fit their region
+    };
+
+    explicit RingBuffer(size_t regionSize, size_t regions = 3, const std::string& label = "RingBuffer");
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    GLuint id() const { return m_Buffer; }
+    size_t regionSize() const { return m_RegionSize; }
+
+    // Call once per frame on the GL thread, before the first allocation
+    void beginFrame();
+    // After the last draw reading this frame's allocations
+    void endFrame();
+
+    // Maps `size` bytes at an `alignment` multiple (any value, e.g.
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT). Empty when the region is full;
+    // the caller falls back to another path for that data.
+    Allocation allocate(size_t size, size_t alignment = 16);
+    // Unmaps the current allocation; needed before GL reads the buffer
+    void commit();
+    // allocate(), copy, commit()
+    Allocation upload(const void* data, size_t size, size_t alignment = 16);
+
+    // Offset alignment glBindBufferRange needs for uniform blocks
+    static size_t uniformAlignment();
+
+    const Stats& stats() const { return m_Stats; }
+
+private:
+    GLBuffer m_Buffer;
+    size_t m_RegionSize;
+    std::vector<GLsync> m_Fences; // one per region; null when never submitted
+    size_t m_Region = 0;
+    size_t m_Head = 0;            // next free byte of the current region
+    bool m_Mapped = false;
+    bool m_InFrame = false;
+    Stats m_Stats;
+};
@@ -1,21 +1,60 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <glad/gl.h>
+#include "GLResource.h"
 
 class Shader {
 public:
-    GLuint ID;
-    Shader(const std::string& vertexPath, const std::string& fragmentPath);
+    GLuint ID = 0;
+    // `defines` ("NAME" or "NAME=VALUE") are injected after #version.
+    // With buildNow == false nothing is compiled until beginBuild().
+    Shader(const std::string& vertexPath, const std::string& fragmentPath,
+           std::vector<std::string> defines = {}, bool buildNow = true);
     ~Shader();
     void use() const;
     void setMat4(const std::string& name, const float* value) const;
     void setFloat(const std::string& name, float value) const;
+    void setInt(const std::string& name, int value) const;
+    // False if the program does not have it or the linker optimized it out
+    bool hasUniform(const std::string& name) const;
+    void setVec2(const std::string& name, const float* value) const;
+    void setVec3(const std::string& name, const float* value) const;
     void reload();
 
+    // Two-phase build for background compilation. beginBuild() submits the
+    // compile and link without waiting for the driver; finishBuild() checks
+    // the result later (e.g. next frame, giving the driver's compiler
+    // threads time to finish) and swaps the program in on success.
+    bool beginBuild();
+    bool finishBuild();
+    bool isBuildPending() const { return m_Pending.program != 0; }
+    bool isReady() const { return m_Program != 0; }
+
+    // Complete info logs; drivers can write far more than a fixed buffer holds
+    static std::string shaderLog(GLuint shader);
+    static std::string programLog(GLuint program);
+
+    // Every file the program was built from, includes resolved (for ShaderWatcher)
+    const std::vector<std::string>& dependencies() const { return m_Dependencies; }
+
 private:
-    GLuint m_Program;
+    GLProgram m_Program;
     std::string m_VertexPath;
     std::string m_FragmentPath;
+    std::vector<std::string> m_Defines;
+    std::vector<std::string> m_Dependencies;
+    uint64_t m_SourceHash = 0; // of the preprocessed sources m_Program was built from
+
+    struct PendingBuild {
+        GLProgram program;
+        GLShader vertex, fragment;
+        uint64_t sourceHash = 0;
+        std::vector<std::string> vertexFiles, fragmentFiles; // for mapping logs
+    };
+    PendingBuild m_Pending;
+
     bool compileAndLink(); 
     
 };
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// GLSL preprocessing done before the driver sees a shader:
+//  - `#include "file"` / `#include <file>`, resolved relative to the
+//    including file first and then to the include directories
+//  - `#pragma once` in included files
+//  - injection of `#define`s right after the `#version` line
+// Every file boundary gets a `#line <line> <file index>` directive, so
+// driver logs can be mapped back to the original file and line.
+class ShaderPreprocessor {
+public:
+    struct Result {
+        bool ok = false;
+        std::string source;
+        std::string error;
+        std::vector<std::string> files; // file index used in #line; [0] is the root
+        uint64_t hash = 0;              // of `source`
+    };
+
+    explicit ShaderPreprocessor(std::vector<std::string> includeDirs = {"shaders/include"});
+
+    // `defines` entries are "NAME" or "NAME=VALUE". Results are cached and
+    // reused until one of the files they were built from changes on disk.
+    Result preprocess(const std::string& path, const std::vector<std::string>& defines = {});
+
+    // Rewrites "<index>:<line>" / "<index>(<line>)" locations in a driver
+    // info log into "<file>:<line>".
+    static std::string mapLog(const std::string& log, const Result& result);
+
+    // Instance used by Shader
+    static ShaderPreprocessor& shared();
+
+private:
+    using Stamp = std::filesystem::file_time_type;
+
+    struct Cached {
+        Result result;
+        std::vector<std::pair<std::string, Stamp>> stamps;
+    };
+
+    bool expand(const std::string& path, const std::vector<std::string>& defines, Result& result,
+                std::vector<std::string>& stack, std::unordered_set<std::string>& once, std::string& out);
+    std::string resolve(const std::string& name, const std::string& includer) const;
+    const std::string* readSource(const std::string& path, Stamp& stamp);
+
+    std::vector<std::string> m_IncludeDirs;
+    std::unordered_map<uint64_t, Cached> m_Results;
+    std::unordered_map<std::string, std::pair<Stamp, std::string>> m_Sources;
+    std::mutex m_Mutex;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Shader.h"
+
+class ShaderWatcher;
+
+// Permutations of one vertex/fragment pair, keyed by a bitmask of feature
+// defines (bit i set => `#define <features[i]> 1`). Variants other than the
+// base one are never compiled synchronously: get() returns the closest
+// ready variant and queues the requested one, and update() builds queued
+// variants a few at a time with Shader's two-phase build.
+class ShaderVariants {
+public:
+    using Mask = uint32_t;
+
+    // The base variant (mask 0) is built immediately so get() always has
+    // something to fall back to.
+    ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath,
+                   std::vector<std::string> features, ShaderWatcher* watcher = nullptr);
+    ~ShaderVariants();
+
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // Bit for a feature name, 0 if unknown
+    Mask feature(const std::string& name) const;
+
+    Shader& get(Mask mask);
+    bool isReady(Mask mask) const;
+
+    // Queue variants for background building
+    void warmUp(Mask mask);
+    void warmUpAll(Mask featureSubset);
+    void reloadAll();
+
+    // Call once per frame on the GL thread: finishes builds submitted last
+    // frame, then submits queued ones until `budget` of CPU time is spent.
+    void update(std::chrono::microseconds budget = std::chrono::microseconds(2000));
+
+    size_t readyCount() const { return m_Ready.size(); }
+    size_t queuedCount() const { return m_Queue.size() + m_InFlight.size(); }
+
+private:
+    // Open-addressing table: variants are looked up every draw, so keep
+    // them in one flat array rather than a node-based map
+    struct Slot {
+        Mask mask = 0;
+        bool occupied = false;
+        bool failed = false; // not retried until its files change or reloadAll()
+        std::unique_ptr<Shader> shader;
+    };
+
+    Slot* find(Mask mask);
+    const Slot* find(Mask mask) const;
+    Slot& findOrCreate(Mask mask);
+    size_t slotIndex(Mask mask) const;
+    void enqueue(Mask mask, bool urgent);
+    void rebuild(Mask mask); // after a file change
+
+    std::string m_VertexPath;
+    std::string m_FragmentPath;
+    std::vector<std::string> m_Features;
+    ShaderWatcher* m_Watcher;
+
+    std::vector<Slot> m_Slots; // capacity is a power of two
+    size_t m_Count = 0;
+    std::vector<Mask> m_Ready;
+    std::deque<Mask> m_Queue;
+    std::vector<Mask> m_InFlight;
+};
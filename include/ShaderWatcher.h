@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Shader;
+
+// Hot reload driven by the include dependency graph: polls the timestamps
+// of every file any watched shader was built from, and on a change rebuilds
+// only the programs whose dependency closure contains that file.
+class ShaderWatcher {
+public:
+    explicit ShaderWatcher(std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+
+    // onChange defaults to a synchronous Shader::reload()
+    void watch(Shader& shader, std::function<void(Shader&)> onChange = {});
+    void unwatch(Shader& shader);
+
+    // Cheap to call every frame; disk is only checked once per interval.
+    // Returns the number of programs that were rebuilt.
+    size_t poll();
+
+private:
+    void rebuildGraph();
+
+    std::chrono::milliseconds m_Interval;
+    std::chrono::steady_clock::time_point m_LastPoll;
+    std::vector<Shader*> m_Shaders;
+    std::unordered_map<Shader*, std::function<void(Shader&)>> m_Handlers;
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_Stamps;
+    std::unordered_map<std::string, std::vector<Shader*>> m_Dependents; // file -> programs using it
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Image.h"
+
+class ThreadPool;
+
+// Material texture for SoftwareRasterizer: the decoded image and its mip
+// chain, sampled like the GL path (repeat, trilinear)
+class SoftwareTexture {
+public:
+    // Null (and a message) when the file cannot be read or decoded
+    static std::shared_ptr<SoftwareTexture> load(const std::string& path);
+
+    // `lod` is log2 of the texel footprint of one pixel
+    glm::vec3 sample(const glm::vec2& uv, float lod) const;
+    int width() const { return m_Levels.empty() ? 0 : m_Levels[0].width; }
+    int height() const { return m_Levels.empty() ? 0 : m_Levels[0].height; }
+
+private:
+    glm::vec3 bilinear(const Image& level, const glm::vec2& uv) const;
+
+    std::vector<Image> m_Levels;
+};
+
+// CPU render backend for machines without a GPU, drawing what default.vert
+// and default.frag draw (Lambert or Blinn-Phong lighting, the animated
+// color or the material's diffuse map) into an RGBA image.
+//
+// Draws are queued and run in finish(), in two parallel passes over the
+// thread pool. Geometry transforms, clips and sets up triangles in chunks
+// and bins each into the 64x64 tiles its bounds touch. Raster then owns
+// one tile per task, so tiles need no locking: it walks the tile's bins in
+// submission order and tests 8x8 blocks against the triangle's edges in
+// 28.4 fixed point, with the top-left rule; with AVX2 a block row's eight
+// pixels are tested and depth-tested at once. Each tile keeps the farthest
+// depth of every block and of the tile, so triangles behind what is
+// already drawn are rejected before any pixel is touched. Raster only
+// stores the nearest triangle per pixel; shading runs once per visible
+// pixel after the tile's last triangle.
+class SoftwareRasterizer {
+public:
+    // What default.vert/default.frag take as uniforms, per draw
+    struct Uniforms {
+        glm::mat4 model = glm::mat4(1.0f);
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        glm::vec3 viewPos = glm::vec3(0.0f);
+        float time = 0.0f;
+        bool blinnPhong = false; // the BLINN_PHONG variant
+    };
+
+    struct Material {
+        glm::vec3 diffuseColor = glm::vec3(1.0f);
+        const SoftwareTexture* diffuseMap = nullptr; // the animated color without one
+    };
+
+    struct Stats {
+        size_t triangles = 0;       // submitted
+        size_t culled = 0;          // outside the frustum or without area
+        size_t clipped = 0;         // crossing a frustum plane
+        size_t binned = 0;          // triangle-tile pairs
+        size_t tilesRejected = 0;   // of those, behind the tile's farthest depth
+        size_t blocksRejected = 0;  // 8x8 blocks behind their farthest depth
+        size_t blocksRasterized = 0;
+        size_t pixelsShaded = 0;
+        double geometryTime = 0.0;  // milliseconds since clear()
+        double rasterTime = 0.0;    // including shading
+    };
+
+    static constexpr int TileSize = 64;
+    static constexpr int BlockSize = 8;
+    static constexpr int MaxSize = 8192; // keeps edge functions in range
+
+    SoftwareRasterizer(ThreadPool& pool, int width, int height);
+    ~SoftwareRasterizer();
+
+    SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+    SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+    void resize(int width, int height);
+    int width() const { return m_Width; }
+    int height() const { return m_Height; }
+
+    // Color and depth (to 1.0); also resets the stats
+    void clear(const glm::vec3& color);
+
+    // Applied to the draws that follow, like a shader's uniforms
+    Uniforms& uniforms() { return m_Uniforms; }
+
+    // Queues `vertexCount` vertices as triangles, in ObjModel's interleaved
+    // layout (position, normal, texcoord: 8 floats). The vertices and the
+    // material's texture must stay alive until finish().
+    void drawTriangles(const float* vertices, size_t vertexCount, const Material& material);
+    // Renders everything queued since the last finish()
+    void finish();
+
+    // Bottom-up like every Image, so encodePNG() writes it the right way up
+    Image image() const;
+
+    const Stats& stats() const { return m_Stats; }
+
+    // AVX2 is used when the CPU has it unless turned off here
+    static bool cpuHasAvx2();
+    void setUseAvx2(bool enabled) { m_UseAvx2 = enabled && cpuHasAvx2(); }
+    bool usesAvx2() const { return m_UseAvx2; }
+
+private:
+    struct Draw {
+        const float* vertices;
+        size_t vertexCount;
+        Material material;
+        Uniforms uniforms;
+        glm::mat4 modelViewProjection;
+        glm::mat3 normalMatrix;
+    };
+    struct Triangle;
+    struct Chunk;
+    struct TileStats;
+
+    void setupChunk(Chunk& chunk);
+    void rasterTile(size_t tile, TileStats& stats);
+    uint32_t shade(const Triangle& triangle, float x, float y) const;
+
+    ThreadPool& m_Pool;
+    int m_Width = 0, m_Height = 0;
+    int m_TilesX = 0, m_TilesY = 0;
+    std::vector<uint8_t> m_Color;  // RGBA, bottom-up rows
+    std::vector<float> m_Depth;    // tile by tile, rows of TileSize within a tile
+    Uniforms m_Uniforms;
+    std::vector<Draw> m_Draws;
+    std::vector<std::unique_ptr<Chunk>> m_Chunks; // reused between frames
+    size_t m_ChunkCount = 0;
+    Stats m_Stats;
+    bool m_UseAvx2 = false;
+};
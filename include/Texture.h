@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/gl.h>
+#include "GLResource.h"
+#include "TextureCompression.h"
+
+class ThreadPool;
+
+// 2D texture streamed in by TextureCache, either RGBA8 or block-compressed.
+// Mip levels are uploaded coarsest-first, so the texture becomes usable (at
+// reduced detail) before the full chain is resident.
+class Texture {
+public:
+    explicit Texture(std::string path);
+    ~Texture();
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    // 0 until at least one mip level is on the GPU
+    GLuint id() const;
+    bool isComplete() const;
+    bool failed() const { return m_Failed; }
+    const std::string& path() const { return m_Path; }
+    BlockFormat format() const { return m_Format; }
+
+private:
+    friend class TextureCache;
+
+    std::string m_Path;
+    GLTexture m_ID;
+    int m_LevelCount = 0;
+    int m_BaseLevel = 0; // finest level uploaded so far; == m_LevelCount when none
+    bool m_Failed = false;
+    BlockFormat m_Format = BlockFormat::RGBA8;
+    size_t m_UncompressedBytes = 0; // uploaded levels as RGBA8
+    std::vector<TextureLevel> m_Levels; // CPU copies, released as each level is uploaded
+    std::shared_ptr<Texture> m_Alias; // same content already loaded from another path
+};
+
+// Ring of pixel unpack buffers. Each upload is staged through the next
+// buffer in the ring and fenced, so the copy into driver memory overlaps
+// with rendering instead of stalling inside glTexSubImage2D.
+class PixelUploadRing {
+public:
+    explicit PixelUploadRing(size_t slotCount = 3);
+    ~PixelUploadRing();
+
+    PixelUploadRing(const PixelUploadRing&) = delete;
+    PixelUploadRing& operator=(const PixelUploadRing&) = delete;
+
+    // Defines `level` of the texture bound to GL_TEXTURE_2D, with
+    // glCompressedTexImage2D for block formats
+    void upload(GLint level, const TextureLevel& data, BlockFormat format);
+
+private:
+    struct Slot {
+        GLBuffer buffer;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+    };
+    std::vector<Slot> m_Slots;
+    size_t m_Next = 0;
+};
+
+// Shares textures between materials and models. Lookups are by path first,
+// then by a hash of the file contents so duplicated files under different
+// names are only uploaded once. Decode, mip generation and block
+// compression run on the thread pool; update() finishes the GL side on the
+// render thread.
+//
+// Compressed mip chains are written to `compressedCacheDir`, keyed by the
+// source hash, so only the first load of an image pays for encoding. An
+// empty directory disables compression, as does a driver without any
+// supported block format.
+class TextureCache {
+public:
+    explicit TextureCache(ThreadPool& pool, std::string compressedCacheDir = "cache/textures");
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    std::shared_ptr<Texture> acquire(const std::string& path);
+
+    // Call once per frame on the GL thread. Uploads at most budgetBytes of
+    // mip data (but always at least one level, so large levels still land).
+    void update(size_t budgetBytes = 16u << 20);
+
+    size_t pendingCount() const { return m_Decoding.size() + m_Uploading.size(); }
+
+    // GPU bytes of the uploaded levels of live textures, and what they
+    // would take as RGBA8; released textures drop out at the next update()
+    size_t residentBytes() const { return m_ResidentBytes; }
+    size_t uncompressedBytes() const { return m_UncompressedBytes; }
+
+private:
+    struct Decoded {
+        uint64_t hash = 0;
+        BlockFormat format = BlockFormat::RGBA8;
+        std::vector<TextureLevel> levels;
+        bool fromCache = false;
+        std::string error;
+    };
+    struct Pending {
+        std::shared_ptr<Texture> texture;
+        std::future<Decoded> result;
+    };
+
+    void beginUpload(const std::shared_ptr<Texture>& texture, Decoded decoded);
+
+    ThreadPool& m_Pool;
+    std::string m_CompressedCacheDir;
+    CompressionSupport m_Support;
+    PixelUploadRing m_Uploads;
+    std::unordered_map<std::string, std::weak_ptr<Texture>> m_ByPath;
+    std::unordered_map<uint64_t, std::weak_ptr<Texture>> m_ByHash;
+    std::vector<Pending> m_Decoding;
+    std::vector<std::shared_ptr<Texture>> m_Uploading;
+    size_t m_ResidentBytes = 0;
+    size_t m_UncompressedBytes = 0;
+};
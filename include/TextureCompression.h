@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/gl.h>
+#include "Image.h"
+
+class ThreadPool;
+
+// glad is generated for plain GL 3.3 core, which lacks the S3TC and BPTC
+// enums even though nearly every desktop driver exposes them.
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+enum class BlockFormat : uint32_t {
+    RGBA8 = 0, // uncompressed
+    BC1,       // RGB + 1-bit alpha, 4 bpp
+    BC3,       // RGBA (BC1 color + BC4 alpha), 8 bpp
+    BC5,       // two independent channels (normal maps), 8 bpp
+    BC7,       // high quality RGBA, 8 bpp
+};
+
+// One mip level in either RGBA8 or block-compressed form
+struct TextureLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> data;
+};
+
+const char* blockFormatName(BlockFormat format);
+GLenum blockFormatGLEnum(BlockFormat format);
+size_t levelByteSize(BlockFormat format, int width, int height);
+
+// Block formats the current context can sample from. Must be called on the GL thread.
+struct CompressionSupport {
+    bool bc1bc3 = false; // EXT_texture_compression_s3tc
+    bool bc5 = false;    // RGTC, core since 3.0
+    bool bc7 = false;    // ARB_texture_compression_bptc / GL 4.2
+
+    static CompressionSupport query();
+};
+
+// Picks the best format for the image's content among the supported ones:
+// BC7 when available, otherwise BC1 for opaque and BC3 for translucent images.
+BlockFormat chooseBlockFormat(const Image& image, const CompressionSupport& support);
+
+// Encodes one RGBA8 image into 4x4 blocks. Block rows are spread over the
+// pool when one is given. Edge blocks of non-multiple-of-4 sizes clamp.
+std::vector<unsigned char> compressImage(const Image& image, BlockFormat format, ThreadPool* pool);
+
+// On-disk transcoded cache. The layout follows KTX2 (identifier, header,
+// level index, levels stored smallest-first) but omits the data format
+// descriptor, so it is only meant to be read back by readTextureCache.
+bool writeTextureCache(const std::string& path, BlockFormat format, uint64_t sourceHash,
+                       const std::vector<TextureLevel>& levels);
+bool readTextureCache(const std::string& path, uint64_t sourceHash, BlockFormat& format,
+                      std::vector<TextureLevel>& levels);
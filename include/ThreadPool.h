@@ -0,0 +1,51 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads for CPU-side work (image decode,
+// mip generation, ...). Tasks must not touch OpenGL: only the thread that
+// owns the context may do that.
+class ThreadPool {
+public:
+    // threadCount == 0 picks hardware_concurrency() - 1 (at least one)
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    auto submit(F&& fn) -> std::future<decltype(fn())> {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.emplace([task]() { (*task)(); });
+        }
+        m_Condition.notify_one();
+        return result;
+    }
+
+    // Runs fn(begin, end) over [0, count) in chunks of `grain` and returns
+    // when all are done. The calling thread works through chunks too, so
+    // this is safe to call from inside a pool task.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    size_t threadCount() const { return m_Workers.size(); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_Workers;
+    std::queue<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stopping = false;
+};
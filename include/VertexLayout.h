@@ -0,0 +1,29 @@
+#pragma once
+#include <glad/gl.h>
+
+// Vertex attribute locations shared by ObjModel (which sets up the VAOs)
+// and the shaders' `layout(location = N)` declarations. shadervalidate
+// checks every vertex shader against this table.
+namespace VertexLayout {
+
+constexpr GLuint Position = 0;
+constexpr GLuint Normal = 1;
+constexpr GLuint TexCoord = 2;
+constexpr GLuint InstanceModel = 3; // mat4, occupies locations 3..6
+constexpr GLuint Color = 7;         // point clouds (PointCloud)
+
+struct Attribute {
+    GLuint location;
+    GLenum type;
+    const char* meaning;
+};
+
+constexpr Attribute Attributes[] = {
+    {Position, GL_FLOAT_VEC3, "position"},
+    {Normal, GL_FLOAT_VEC3, "normal"},
+    {TexCoord, GL_FLOAT_VEC2, "texcoord"},
+    {InstanceModel, GL_FLOAT_MAT4, "instance model matrix"},
+    {Color, GL_FLOAT_VEC4, "color"},
+};
+
+} // namespace VertexLayout
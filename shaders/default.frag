@@ -1,4 +1,6 @@
 #version 330 core
+#include "lighting.glsl"
+
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
@@ -7,15 +9,21 @@ out vec4 FragColor;
 
 uniform float time;
 
+#ifdef DIFFUSE_MAP
+uniform sampler2D diffuseMap;
+uniform bool hasDiffuseMap;
+uniform vec3 diffuseColor;
+#endif
+
 void main() {
     // A simple color based on position and time
     vec3 color = 0.5 + 0.5 * cos(time + FragPos.xyx + vec3(0,2,4));
+#ifdef DIFFUSE_MAP
+    // Material texture, for materials that have one
+    if (hasDiffuseMap)
+        color = texture(diffuseMap, TexCoords).rgb * diffuseColor;
+#endif
     
     // Basic lighting
-    vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
-    float diff = max(dot(Normal, lightDir), 0.0);
-    vec3 diffuse = diff * color;
-    vec3 ambient = 0.1 * color;
-    
-    FragColor = vec4(ambient + diffuse, 1.0);
+    FragColor = vec4(applyLighting(color, Normal, FragPos), 1.0);
 }
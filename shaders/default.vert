@@ -3,17 +3,28 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
+#ifdef INSTANCED
+// Per-instance model matrix, one column per attribute slot
+layout (location = 3) in mat4 aInstanceModel;
+#define MODEL_MATRIX aInstanceModel
+#else
+uniform mat4 model;
+#define MODEL_MATRIX model
+#endif
+
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Matches depth.vert's depths exactly (keep the expressions identical)
+invariant gl_Position;
+
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    FragPos = vec3(MODEL_MATRIX * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(MODEL_MATRIX))) * aNormal;  
     TexCoords = aTexCoords;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
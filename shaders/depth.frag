@@ -0,0 +1,6 @@
+#version 330 core
+
+// Depth only: the occlusion pass has no color attachment
+void main()
+{
+}
@@ -0,0 +1,16 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// With the same expression as default.vert, depths match it bit for bit,
+// which the heatmap's depth prepass relies on under GL_LEQUAL
+invariant gl_Position;
+
+void main()
+{
+    vec3 worldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
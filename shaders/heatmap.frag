@@ -0,0 +1,41 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D counts;
+uniform float range;          // value shown at the top of the colormap
+uniform float histogram[16];  // bin heights, scaled so the largest is 1
+
+// Polynomial fit of the Turbo colormap
+vec3 turbo(float x)
+{
+    const vec4 red4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+    const vec4 green4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+    const vec4 blue4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+    const vec2 red2 = vec2(-152.94239396, 59.28637943);
+    const vec2 green2 = vec2(4.27729857, 2.82956604);
+    const vec2 blue2 = vec2(-89.90310912, 27.34824973);
+    x = clamp(x, 0.0, 1.0);
+    vec4 v4 = vec4(1.0, x, x * x, x * x * x);
+    vec2 v2 = v4.zw * v4.z;
+    return vec3(dot(v4, red4) + dot(v2, red2), dot(v4, green4) + dot(v2, green2), dot(v4, blue4) + dot(v2, blue2));
+}
+
+void main()
+{
+    float value = texture(counts, TexCoords).r;
+    vec3 color = value > 0.0 ? turbo(value / range) : vec3(0.05);
+
+    // Histogram in the bottom-left corner, each bar in its bin's color
+    const vec2 origin = vec2(16.0);
+    const vec2 size = vec2(256.0, 96.0);
+    vec2 local = (gl_FragCoord.xy - origin) / size;
+    if (all(greaterThanEqual(local, vec2(0.0))) && all(lessThan(local, vec2(1.0)))) {
+        int bin = int(local.x * 16.0);
+        float bar = histogram[bin];
+        bool inBar = local.y < bar && fract(local.x * 16.0) < 0.85;
+        color = inBar ? turbo((float(bin) + 1.0) / 16.0) : mix(color, vec3(0.0), 0.6);
+    }
+    FragColor = vec4(color, 1.0);
+}
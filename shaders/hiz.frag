@@ -0,0 +1,20 @@
+#version 330 core
+
+// One step of the Hi-Z pyramid: each texel keeps the farthest depth of the
+// texels it covers in the previous level. With an odd previous size the
+// last row/column also takes the leftover texel, so nothing is dropped.
+uniform sampler2D depth; // previous level only (base level == max level)
+
+void main()
+{
+    ivec2 size = textureSize(depth, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 extent = ivec2(2) + ivec2(equal(base + 3, size));
+
+    float farthest = 0.0;
+    for (int y = 0; y < extent.y; ++y) {
+        for (int x = 0; x < extent.x; ++x)
+            farthest = max(farthest, texelFetch(depth, min(base + ivec2(x, y), size - 1), 0).r);
+    }
+    gl_FragDepth = farthest;
+}
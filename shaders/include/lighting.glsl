@@ -0,0 +1,23 @@
+#pragma once
+// Shared lighting model; include with #include "lighting.glsl".
+// Lambert by default, Blinn-Phong when the BLINN_PHONG variant is selected.
+
+const vec3 LIGHT_DIR = normalize(vec3(1.0, 1.0, 1.0));
+
+#ifdef BLINN_PHONG
+uniform vec3 viewPos;
+#endif
+
+vec3 applyLighting(vec3 color, vec3 normal, vec3 fragPos) {
+    vec3 n = normalize(normal);
+    float diff = max(dot(n, LIGHT_DIR), 0.0);
+    vec3 diffuse = diff * color;
+    vec3 ambient = 0.1 * color;
+#ifdef BLINN_PHONG
+    vec3 halfway = normalize(LIGHT_DIR + normalize(viewPos - fragPos));
+    float spec = diff > 0.0 ? pow(max(dot(n, halfway), 0.0), 32.0) : 0.0;
+    return ambient + diffuse + vec3(0.4 * spec);
+#else
+    return ambient + diffuse;
+#endif
+}
@@ -0,0 +1,11 @@
+#version 330 core
+out vec4 FragColor;
+
+// Added up by the blend unit: 1 per fragment for overdraw, the draw's
+// measured cost per fragment for the fragment-cost view
+uniform float weight;
+
+void main()
+{
+    FragColor = vec4(weight, 0.0, 0.0, 0.0);
+}
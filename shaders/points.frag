@@ -0,0 +1,13 @@
+#version 330 core
+in vec4 Color;
+
+out vec4 FragColor;
+
+void main()
+{
+    // Round sprites
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    if (dot(offset, offset) > 1.0)
+        discard;
+    FragColor = Color;
+}
@@ -0,0 +1,20 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 7) in vec4 aColor;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+// Sprite diameter in pixels at view distance 1 (PointCloud sets it from
+// the point spacing and how many points are drawn)
+uniform float pointScale;
+
+out vec4 Color;
+
+void main()
+{
+    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    gl_Position = projection * viewPos;
+    gl_PointSize = clamp(pointScale / max(-viewPos.z, 1e-3), 1.0, 64.0);
+    Color = aColor;
+}
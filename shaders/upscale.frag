@@ -0,0 +1,28 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 uvScale;   // rendered fraction of the source texture
+uniform vec2 texelSize; // 1 / source texture size
+uniform float sharpness;
+
+void main()
+{
+    // Keep taps inside the rendered region, which only covers part of the texture
+    vec2 limit = uvScale - 0.5 * texelSize;
+    vec2 uv = min(TexCoords * uvScale, limit);
+
+    vec3 center = texture(source, uv).rgb;
+    vec3 north = texture(source, min(uv + vec2(0.0, texelSize.y), limit)).rgb;
+    vec3 south = texture(source, max(uv - vec2(0.0, texelSize.y), vec2(0.0))).rgb;
+    vec3 east = texture(source, min(uv + vec2(texelSize.x, 0.0), limit)).rgb;
+    vec3 west = texture(source, max(uv - vec2(texelSize.x, 0.0), vec2(0.0))).rgb;
+
+    // Unsharp mask, clamped to the neighbourhood so edges do not ring
+    vec3 sharpened = center + sharpness * (4.0 * center - north - south - east - west);
+    vec3 lo = min(center, min(min(north, south), min(east, west)));
+    vec3 hi = max(center, max(max(north, south), max(east, west)));
+    FragColor = vec4(clamp(sharpened, lo, hi), 1.0);
+}
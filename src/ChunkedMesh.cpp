@@ -0,0 +1,263 @@
+#include "ChunkedMesh.h"
+#include "Meshlets.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+#include "VertexLayout.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+// Chunks being faulted in on the pool at once; more only queue up disk reads
+static constexpr size_t kMaxPrefetches = 8;
+
+static constexpr size_t kVertexBytes = ChunkFormat::FloatsPerVertex * sizeof(float);
+
+ChunkedMesh::ChunkedMesh(const std::string& path, ThreadPool& pool) :
+m_Pool(pool)
+{
+    if (!m_File.open(path))
+        return;
+
+    ChunkFormat::Header header;
+    if (m_File.size() < sizeof(header)) {
+        std::cerr << path << " is not a chunked mesh" << std::endl;
+        return;
+    }
+    std::memcpy(&header, m_File.data(), sizeof(header));
+    const uint64_t tableBytes = uint64_t(header.nodeCount) * sizeof(ChunkFormat::Node);
+    if (std::memcmp(header.magic, ChunkFormat::Magic, sizeof(header.magic)) != 0 || header.nodeCount == 0 ||
+        header.nodeTableOffset > m_File.size() || tableBytes > m_File.size() - header.nodeTableOffset) {
+        std::cerr << path << " is not a chunked mesh, or is truncated" << std::endl;
+        return;
+    }
+
+    // Only the node table is copied; vertex data stays in the mapping
+    std::vector<Node> nodes(header.nodeCount);
+    for (uint32_t i = 0; i < header.nodeCount; ++i) {
+        Node& node = nodes[i];
+        std::memcpy(&node.disk, m_File.data() + header.nodeTableOffset + i * sizeof(ChunkFormat::Node),
+                    sizeof(ChunkFormat::Node));
+        const ChunkFormat::Node& disk = node.disk;
+        const bool childrenValid = disk.childCount == 0 ||
+                                   (disk.firstChild > i && disk.firstChild <= header.nodeCount &&
+                                    disk.childCount <= header.nodeCount - disk.firstChild);
+        if (!childrenValid || disk.vertexOffset > m_File.size() ||
+            uint64_t(disk.vertexCount) * kVertexBytes > m_File.size() - disk.vertexOffset) {
+            std::cerr << path << ": node " << i << " is corrupt" << std::endl;
+            return;
+        }
+        const glm::vec3 boundsMin(disk.boundsMin[0], disk.boundsMin[1], disk.boundsMin[2]);
+        const glm::vec3 boundsMax(disk.boundsMax[0], disk.boundsMax[1], disk.boundsMax[2]);
+        node.center = (boundsMin + boundsMax) * 0.5f;
+        node.radius = glm::length(boundsMax - boundsMin) * 0.5f;
+    }
+    m_Nodes = std::move(nodes);
+    m_BoundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    m_BoundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    m_Stats.nodes = m_Nodes.size();
+    std::cout << "Chunked mesh " << path << ": " << m_Nodes.size() << " nodes, "
+              << m_File.size() / (1024 * 1024) << " MiB" << std::endl;
+}
+
+ChunkedMesh::~ChunkedMesh() {
+    // Prefetch tasks read the mapping
+    for (auto& node : m_Nodes) {
+        if (node.prefetch.valid())
+            node.prefetch.wait();
+    }
+}
+
+bool ChunkedMesh::isVisible(const Node& node) const {
+    for (const auto& plane : m_Planes) {
+        if (glm::dot(glm::vec3(plane), node.center) + plane.w < -node.radius)
+            return false;
+    }
+    return true;
+}
+
+float ChunkedMesh::screenError(const Node& node) const {
+    // Nearest point of the bounding sphere, so a node's error never
+    // shrinks as the camera moves into it
+    const float distance = std::max(glm::length(node.center - m_Camera) - node.radius, 1e-4f);
+    return node.disk.geometricError / distance * m_PixelsPerUnit;
+}
+
+void ChunkedMesh::update(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                         const glm::vec3& cameraPosition, int viewportHeight) {
+    if (m_Nodes.empty())
+        return;
+    ++m_Frame;
+
+    // Everything in model space, like the meshlet tests
+    Meshlets::extractFrustum(projection * view * model, m_Planes);
+    m_Camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+    m_PixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+
+    m_Draw.clear();
+    m_Requests.clear();
+    select(0);
+    stream();
+    m_Stats.drawn = m_Draw.size();
+}
+
+void ChunkedMesh::select(uint32_t index) {
+    Node& node = m_Nodes[index];
+    if (!isVisible(node))
+        return;
+    node.lastUsed = m_Frame;
+
+    if (node.disk.childCount > 0 && screenError(node) > m_ErrorThreshold) {
+        bool ready = true;
+        for (uint32_t child = node.disk.firstChild; child < node.disk.firstChild + node.disk.childCount; ++child) {
+            Node& childNode = m_Nodes[child];
+            if (!isVisible(childNode))
+                continue;
+            childNode.lastUsed = m_Frame; // don't evict half of a set still being loaded
+            if (!childNode.vbo) {
+                request(child, screenError(childNode));
+                ready = false;
+            }
+        }
+        if (ready) {
+            for (uint32_t child = node.disk.firstChild; child < node.disk.firstChild + node.disk.childCount; ++child)
+                select(child);
+            return;
+        }
+    }
+
+    if (node.vbo)
+        m_Draw.push_back(index);
+    else // nothing to show here at all: ahead of every refinement
+        request(index, std::numeric_limits<float>::max());
+}
+
+void ChunkedMesh::request(uint32_t index, float priority) {
+    m_Nodes[index].priority = priority;
+    m_Requests.push_back(index);
+}
+
+void ChunkedMesh::stream() {
+    std::sort(m_Requests.begin(), m_Requests.end(),
+              [&](uint32_t a, uint32_t b) { return m_Nodes[a].priority > m_Nodes[b].priority; });
+
+    // A lowered cap applies right away
+    makeRoom(0);
+
+    m_Stats.uploadedBytes = 0;
+    m_Stats.capLimited = 0;
+    size_t prefetching = 0;
+    size_t queued = 0;
+    for (size_t r = 0; r < m_Requests.size(); ++r) {
+        const uint32_t index = m_Requests[r];
+        Node& node = m_Nodes[index];
+        const size_t bytes = node.disk.vertexCount * kVertexBytes;
+        ++queued;
+
+        // Page faults on the pool, not in glBufferData on the GL thread
+        if (!node.prefetch.valid()) {
+            if (prefetching >= kMaxPrefetches)
+                continue;
+            ++prefetching;
+            m_File.willNeed(node.disk.vertexOffset, bytes);
+            const unsigned char* data = m_File.data() + node.disk.vertexOffset;
+            node.prefetch = m_Pool.submit([data, bytes]() {
+                volatile unsigned char sink = 0;
+                for (size_t offset = 0; offset < bytes; offset += 4096)
+                    sink = sink + data[offset];
+            });
+            continue;
+        }
+        if (node.prefetch.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++prefetching;
+            continue;
+        }
+
+        // Always at least one upload per frame, so oversized chunks still land
+        if (m_Stats.uploadedBytes > 0 && m_Stats.uploadedBytes + bytes > m_UploadBudget)
+            continue;
+        // Only what this frame draws is left to evict; requests are in
+        // priority order, so nothing after this one could fit either
+        if (!makeRoom(bytes)) {
+            --queued;
+            m_Stats.capLimited = m_Requests.size() - r;
+            break;
+        }
+        node.prefetch.get();
+        upload(index);
+        m_Stats.uploadedBytes += bytes;
+        --queued;
+    }
+    m_Stats.queued = queued;
+}
+
+bool ChunkedMesh::makeRoom(size_t bytes) {
+    if (m_Stats.residentBytes + bytes <= m_MemoryCap)
+        return true;
+
+    // Least recently used first; nothing this frame selected is a candidate
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < m_Nodes.size(); ++i) {
+        if (m_Nodes[i].vbo && m_Nodes[i].lastUsed < m_Frame)
+            candidates.push_back(i);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [&](uint32_t a, uint32_t b) { return m_Nodes[a].lastUsed < m_Nodes[b].lastUsed; });
+    for (uint32_t index : candidates) {
+        if (m_Stats.residentBytes + bytes <= m_MemoryCap)
+            break;
+        evict(m_Nodes[index]);
+    }
+    return m_Stats.residentBytes + bytes <= m_MemoryCap;
+}
+
+void ChunkedMesh::upload(uint32_t index) {
+    Node& node = m_Nodes[index];
+    const size_t bytes = node.disk.vertexCount * kVertexBytes;
+    const std::string label = "ChunkedMesh node " + std::to_string(index);
+
+    node.vao.create(label, GL_HERE);
+    node.vbo.create(label + " vertices", GL_HERE);
+    glBindVertexArray(node.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, node.vbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, m_File.data() + node.disk.vertexOffset, GL_STATIC_DRAW);
+    node.vbo.setBytes(bytes);
+
+    // Same interleaving as ObjModel
+    glVertexAttribPointer(VertexLayout::Position, 3, GL_FLOAT, GL_FALSE, kVertexBytes, (void*)0);
+    glEnableVertexAttribArray(VertexLayout::Position);
+    glVertexAttribPointer(VertexLayout::Normal, 3, GL_FLOAT, GL_FALSE, kVertexBytes, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(VertexLayout::Normal);
+    glVertexAttribPointer(VertexLayout::TexCoord, 2, GL_FLOAT, GL_FALSE, kVertexBytes, (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(VertexLayout::TexCoord);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    ++m_Stats.resident;
+    m_Stats.residentBytes += bytes;
+}
+
+void ChunkedMesh::evict(Node& node) {
+    m_Stats.residentBytes -= node.disk.vertexCount * kVertexBytes;
+    --m_Stats.resident;
+    node.vao.reset();
+    node.vbo.reset();
+}
+
+void ChunkedMesh::draw(const Shader& shader) const {
+    const glm::vec3 white(1.0f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    shader.setInt("hasDiffuseMap", 0);
+    shader.setVec3("diffuseColor", &white.x);
+    drawGeometry();
+}
+
+void ChunkedMesh::drawGeometry() const {
+    for (uint32_t index : m_Draw) {
+        glBindVertexArray(m_Nodes[index].vao);
+        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(m_Nodes[index].disk.vertexCount));
+    }
+    glBindVertexArray(0);
+}
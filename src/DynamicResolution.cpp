@@ -0,0 +1,157 @@
+#include "DynamicResolution.h"
+#include "ShaderWatcher.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+DynamicResolution::DynamicResolution(ShaderWatcher* watcher) :
+m_Watcher(watcher),
+m_Upscale(std::make_unique<Shader>("shaders/upscale.vert", "shaders/upscale.frag"))
+{
+    m_EmptyVAO.create("DynamicResolution fullscreen", GL_HERE);
+    if (m_Watcher)
+        m_Watcher->watch(*m_Upscale);
+}
+
+DynamicResolution::~DynamicResolution() {
+    if (m_Watcher)
+        m_Watcher->unwatch(*m_Upscale);
+}
+
+void DynamicResolution::release() {
+    m_Framebuffer.reset();
+    m_Color.reset();
+    m_Depth.reset();
+}
+
+void DynamicResolution::setScaleRange(float minScale, float maxScale) {
+    m_MinScale = std::clamp(minScale, 0.05f, 1.0f);
+    m_MaxScale = std::clamp(maxScale, m_MinScale, 1.0f);
+    m_Scale = std::clamp(m_Scale, m_MinScale, m_MaxScale);
+}
+
+void DynamicResolution::setEnabled(bool enabled) {
+    m_Enabled = enabled;
+    if (!enabled)
+        release(); // reallocated on the next beginScene()
+}
+
+void DynamicResolution::resize(int width, int height) {
+    if (width == m_Width && height == m_Height)
+        return;
+    m_Width = width;
+    m_Height = height;
+    release();
+}
+
+int DynamicResolution::renderWidth() const {
+    return std::max(1, static_cast<int>(std::lround(m_Width * scale())));
+}
+
+int DynamicResolution::renderHeight() const {
+    return std::max(1, static_cast<int>(std::lround(m_Height * scale())));
+}
+
+void DynamicResolution::allocate() {
+    // Allocated once at full size; lower scales render into the bottom-left
+    // corner, so scale changes never reallocate
+    const size_t pixels = static_cast<size_t>(m_Width) * m_Height;
+    m_Color.create("DynamicResolution color", GL_HERE);
+    glBindTexture(GL_TEXTURE_2D, m_Color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    m_Color.setBytes(pixels * 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    m_Depth.create("DynamicResolution depth", GL_HERE);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_Depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_Width, m_Height);
+    m_Depth.setBytes(pixels * 4); // 24-bit depth is stored in 32 bits
+
+    m_Framebuffer.create("DynamicResolution", GL_HERE);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_Depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Dynamic resolution framebuffer incomplete; rendering at full size" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        release();
+        m_Enabled = false;
+    }
+}
+
+void DynamicResolution::beginScene() {
+    if (m_Enabled && !m_Framebuffer && m_Width > 0 && m_Height > 0)
+        allocate();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_Enabled ? m_Framebuffer : 0);
+    glViewport(0, 0, renderWidth(), renderHeight());
+    m_Timer.begin();
+}
+
+void DynamicResolution::endScene() {
+    m_Timer.end();
+
+    double milliseconds = 0.0;
+    if (m_Timer.poll(milliseconds))
+        adapt(milliseconds);
+
+    if (!m_Enabled || !m_Framebuffer) // disabled, or minimized
+        return;
+
+    const int width = renderWidth(), height = renderHeight();
+    if (m_Filter == Filter::Sharpen && m_Upscale->isReady()) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_Width, m_Height);
+        glDisable(GL_DEPTH_TEST);
+        m_Upscale->use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_Color);
+        m_Upscale->setInt("source", 0);
+        const float uvScale[2] = {width / float(m_Width), height / float(m_Height)};
+        const float texelSize[2] = {1.0f / m_Width, 1.0f / m_Height};
+        m_Upscale->setVec2("uvScale", uvScale);
+        m_Upscale->setVec2("texelSize", texelSize);
+        // Sharpen less when close to native resolution
+        m_Upscale->setFloat("sharpness", 0.3f * (1.0f - scale()) / (1.0f - m_MinScale + 1e-3f));
+        glBindVertexArray(m_EmptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_Framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, m_Width, m_Height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_Width, m_Height);
+    }
+}
+
+void DynamicResolution::adapt(double milliseconds) {
+    m_GpuTime = m_GpuTime == 0.0 ? milliseconds : m_GpuTime + 0.2 * (milliseconds - m_GpuTime);
+    if (!m_Enabled || m_Cooldown-- > 0)
+        return;
+
+    // Fragment cost is roughly proportional to pixel count, i.e. scale^2.
+    // Drop quickly when over budget, grow in small steps, and hold inside a
+    // band of headroom so the scale does not oscillate.
+    const double ratio = m_TargetTime / m_GpuTime;
+    float next = m_Scale * static_cast<float>(std::sqrt(ratio));
+    if (ratio < 1.0)
+        next = std::max(next, m_Scale * 0.75f);
+    else if (ratio > 1.2)
+        next = std::min(next, m_Scale * 1.05f);
+    else
+        return;
+
+    next = std::clamp(next, m_MinScale, m_MaxScale);
+    if (std::abs(next - m_Scale) < 0.01f)
+        return;
+    m_Scale = next;
+    // Results arrive a few frames late; skip the ones rendered at the old
+    // scale and restart the average from the first new one
+    m_Cooldown = 6;
+    m_GpuTime = 0.0;
+}
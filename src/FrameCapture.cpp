@@ -0,0 +1,354 @@
+#include "FrameCapture.h"
+#include "Image.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Encoded video frames allowed to pile up before captureFrame() waits for
+// the encoders; bounds memory when encoding is slower than rendering
+static constexpr size_t kMaxQueuedFrames = 16;
+
+static void createParentDirectory(const std::string& path) {
+    const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    std::error_code ignored;
+    if (!parent.empty())
+        std::filesystem::create_directories(parent, ignored);
+}
+
+static std::vector<unsigned char> topDownRGBA(const Image& image) {
+    const size_t rowBytes = static_cast<size_t>(image.width) * 4;
+    std::vector<unsigned char> out(image.pixels.size());
+    for (int y = 0; y < image.height; ++y)
+        std::memcpy(&out[y * rowBytes], &image.pixels[(image.height - 1 - y) * rowBytes], rowBytes);
+    return out;
+}
+
+// One Y4M frame, BT.601 full range ("C420jpeg"), chroma averaged over 2x2
+static std::vector<unsigned char> encodeY4MFrame(const Image& image) {
+    const int width = image.width, height = image.height;
+    const int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    static const char tag[] = "FRAME\n";
+    std::vector<unsigned char> out(sizeof(tag) - 1 + static_cast<size_t>(width) * height +
+                                   2 * static_cast<size_t>(chromaWidth) * chromaHeight);
+    std::memcpy(out.data(), tag, sizeof(tag) - 1);
+    unsigned char* luma = &out[sizeof(tag) - 1];
+    unsigned char* cb = luma + static_cast<size_t>(width) * height;
+    unsigned char* cr = cb + static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    auto pixel = [&](int x, int y) { // top-down coordinates
+        return &image.pixels[(static_cast<size_t>(height - 1 - y) * width + x) * 4];
+    };
+    auto clampByte = [](float v) { return static_cast<unsigned char>(std::clamp(v + 0.5f, 0.0f, 255.0f)); };
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const unsigned char* p = pixel(x, y);
+            luma[static_cast<size_t>(y) * width + x] = clampByte(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2]);
+        }
+    }
+    for (int y = 0; y < chromaHeight; ++y) {
+        for (int x = 0; x < chromaWidth; ++x) {
+            float r = 0, g = 0, b = 0;
+            int count = 0;
+            for (int dy = 0; dy < 2 && 2 * y + dy < height; ++dy) {
+                for (int dx = 0; dx < 2 && 2 * x + dx < width; ++dx) {
+                    const unsigned char* p = pixel(2 * x + dx, 2 * y + dy);
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    ++count;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            const size_t i = static_cast<size_t>(y) * chromaWidth + x;
+            cb[i] = clampByte(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+            cr[i] = clampByte(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+        }
+    }
+    return out;
+}
+
+// The path becomes a printf format, so allow exactly one %d (with an
+// optional width, e.g. %05d) and nothing but %% besides
+static bool isFramePattern(const std::string& path) {
+    int conversions = 0;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] != '%')
+            continue;
+        if (++i < path.size() && path[i] == '%')
+            continue;
+        while (i < path.size() && std::isdigit(static_cast<unsigned char>(path[i])))
+            ++i;
+        if (i == path.size() || path[i] != 'd')
+            return false;
+        ++conversions;
+    }
+    return conversions == 1;
+}
+
+static bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes) {
+    createParentDirectory(path);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    return file && file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+FrameCapture::VideoFormat FrameCapture::formatForPath(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == ".png")
+        return VideoFormat::PngSequence;
+    if (extension == ".y4m")
+        return VideoFormat::Y4M;
+    if (extension == ".rgba" || extension == ".raw")
+        return VideoFormat::RawRGBA;
+    return VideoFormat::FFmpeg;
+}
+
+FrameCapture::FrameCapture(ThreadPool& pool, size_t ringSize) :
+m_Pool(pool),
+m_Slots(std::max<size_t>(ringSize, 1))
+{
+}
+
+FrameCapture::~FrameCapture() {
+    if (m_Recording)
+        stopRecording();
+    collect(true);
+    for (auto& still : m_Stills)
+        still.wait();
+}
+
+void FrameCapture::screenshot(const std::string& path) {
+    m_PendingScreenshot = path;
+}
+
+bool FrameCapture::startRecording(const std::string& path, int fps, int width, int height) {
+    if (m_Recording)
+        stopRecording();
+    if (width <= 0 || height <= 0 || fps <= 0)
+        return false;
+
+    m_Format = formatForPath(path);
+    m_Path = path;
+    m_Fps = fps;
+    m_Width = width;
+    m_Height = height;
+    m_FrameIndex = 0;
+    createParentDirectory(path);
+
+    if (m_Format == VideoFormat::PngSequence && !isFramePattern(path)) {
+        std::cerr << "PNG sequence path needs one frame number pattern, e.g. frames/%05d.png" << std::endl;
+        return false;
+    }
+    if (m_Format == VideoFormat::FFmpeg) {
+        // Frames arrive as top-down RGBA; x264 needs even dimensions
+        const std::string command = "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgba -s " +
+                                    std::to_string(width) + "x" + std::to_string(height) + " -framerate " +
+                                    std::to_string(fps) +
+                                    " -i - -vf \"pad=ceil(iw/2)*2:ceil(ih/2)*2\" -pix_fmt yuv420p \"" + path + "\"";
+#ifdef _WIN32
+        m_Output = popen(command.c_str(), "wb");
+#else
+        m_Output = popen(command.c_str(), "w");
+#endif
+        m_OutputIsPipe = true;
+    } else if (m_Format != VideoFormat::PngSequence) {
+        m_Output = std::fopen(path.c_str(), "wb");
+        m_OutputIsPipe = false;
+    }
+    if (m_Format != VideoFormat::PngSequence && !m_Output) {
+        std::cerr << "Failed to open " << path << " for recording" << std::endl;
+        return false;
+    }
+    if (m_Format == VideoFormat::Y4M)
+        std::fprintf(m_Output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+
+    m_WriterStopping = false;
+    m_Writer = std::thread(&FrameCapture::writerLoop, this);
+    m_Recording = true;
+    std::cout << "Recording " << width << "x" << height << " at " << fps << " fps to " << path << std::endl;
+    return true;
+}
+
+void FrameCapture::stopRecording() {
+    if (!m_Recording)
+        return;
+    m_Recording = false;
+
+    // Frames still in the readback ring belong to the recording
+    collect(true);
+    {
+        std::lock_guard<std::mutex> lock(m_WriteMutex);
+        m_WriterStopping = true;
+    }
+    m_WriteReady.notify_one();
+    m_Writer.join();
+
+    if (m_Output) {
+        if (m_OutputIsPipe)
+            pclose(m_Output);
+        else
+            std::fclose(m_Output);
+        m_Output = nullptr;
+    }
+    std::cout << "Recorded " << m_FrameIndex << " frames to " << m_Path << std::endl;
+}
+
+void FrameCapture::captureFrame(int width, int height) {
+    if (m_Recording && (width != m_Width || height != m_Height)) {
+        std::cerr << "Framebuffer resized; recording stopped" << std::endl;
+        stopRecording();
+    }
+    collect(false);
+
+    const bool video = m_Recording;
+    if ((!video && m_PendingScreenshot.empty()) || width <= 0 || height <= 0)
+        return;
+
+    // The ring is full only if readbacks fall several frames behind; the
+    // oldest then has to complete before its buffer can be reused
+    Slot& slot = m_Slots[m_Next];
+    if (slot.fence) {
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        finish(slot);
+    }
+    m_Next = (m_Next + 1) % m_Slots.size();
+
+    const size_t size = static_cast<size_t>(width) * height * 4;
+    if (!slot.buffer)
+        slot.buffer.create("FrameCapture readback", GL_HERE);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+        slot.buffer.setBytes(size);
+    }
+    glReadBuffer(GL_BACK);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.width = width;
+    slot.height = height;
+    slot.screenshotPath = std::move(m_PendingScreenshot);
+    m_PendingScreenshot.clear();
+    slot.video = video;
+    slot.frameIndex = video ? m_FrameIndex++ : 0;
+}
+
+void FrameCapture::collect(bool wait) {
+    // Oldest first, so video frames reach the writer in order
+    for (size_t n = 0; n < m_Slots.size(); ++n) {
+        Slot& slot = m_Slots[(m_Next + n) % m_Slots.size()];
+        if (!slot.fence)
+            continue;
+        const GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+            break;
+        finish(slot);
+    }
+
+    m_Stills.erase(std::remove_if(m_Stills.begin(), m_Stills.end(),
+                                  [](std::future<void>& still) {
+                                      return still.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                                  }),
+                   m_Stills.end());
+}
+
+void FrameCapture::finish(Slot& slot) {
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    Image image;
+    image.width = slot.width;
+    image.height = slot.height;
+    const size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT)) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        image.pixels.assign(bytes, bytes + size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (image.pixels.empty()) {
+        std::cerr << "Failed to map capture buffer" << std::endl;
+        return;
+    }
+
+    if (!slot.screenshotPath.empty()) {
+        m_Stills.push_back(m_Pool.submit([image, path = std::move(slot.screenshotPath)]() {
+            std::vector<unsigned char> png;
+            encodePNG(image, png);
+            if (writeFile(path, png))
+                std::cout << "Saved screenshot " << path << std::endl;
+            else
+                std::cerr << "Failed to write screenshot " << path << std::endl;
+        }));
+        slot.screenshotPath.clear();
+    }
+    if (!slot.video)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(m_WriteMutex);
+        m_WriteDrained.wait(lock, [&] { return m_WriteQueue.size() < kMaxQueuedFrames; });
+    }
+    auto encoded = m_Pool.submit([image = std::move(image), format = m_Format, path = m_Path,
+                                  frame = slot.frameIndex]() -> std::vector<unsigned char> {
+        switch (format) {
+        case VideoFormat::PngSequence: {
+            // Frames are independent files; write them from the pool directly
+            char name[1024];
+            std::snprintf(name, sizeof(name), path.c_str(), static_cast<int>(frame));
+            std::vector<unsigned char> png;
+            encodePNG(image, png);
+            if (!writeFile(name, png))
+                std::cerr << "Failed to write " << name << std::endl;
+            return {};
+        }
+        case VideoFormat::Y4M:
+            return encodeY4MFrame(image);
+        case VideoFormat::RawRGBA:
+        case VideoFormat::FFmpeg:
+            return topDownRGBA(image);
+        }
+        return {};
+    });
+    {
+        std::lock_guard<std::mutex> lock(m_WriteMutex);
+        m_WriteQueue.push_back(std::move(encoded));
+    }
+    m_WriteReady.notify_one();
+}
+
+void FrameCapture::writerLoop() {
+    for (;;) {
+        std::future<std::vector<unsigned char>> next;
+        {
+            std::unique_lock<std::mutex> lock(m_WriteMutex);
+            m_WriteReady.wait(lock, [&] { return m_WriterStopping || !m_WriteQueue.empty(); });
+            if (m_WriteQueue.empty())
+                return; // stopping, and everything is written
+            next = std::move(m_WriteQueue.front());
+            m_WriteQueue.pop_front();
+        }
+        m_WriteDrained.notify_all();
+
+        // Frames are encoded in parallel but written strictly in order
+        const std::vector<unsigned char> bytes = next.get();
+        if (!bytes.empty() && m_Output && std::fwrite(bytes.data(), 1, bytes.size(), m_Output) != bytes.size())
+            std::cerr << "Failed to write video frame to " << m_Path << std::endl;
+    }
+}
@@ -0,0 +1,66 @@
+#include "FrameScheduler.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <thread>
+
+FrameScheduler::FrameScheduler(double maxFps) {
+    setMaxFps(maxFps);
+}
+
+void FrameScheduler::setMaxFps(double fps) {
+    // Restarting the deadline on every call would never let frameDone() wait
+    if (std::max(fps, 0.0) == m_MaxFps)
+        return;
+    m_MaxFps = std::max(fps, 0.0);
+    m_NextFrame = Clock::now();
+}
+
+void FrameScheduler::waitForEvents() {
+    // Frames counted per second would otherwise go stale while idle
+    if (Clock::now() - m_CountStart > std::chrono::seconds(2)) {
+        m_DrawnFps = 0.0;
+        m_FrameCount = 0;
+        m_CountStart = Clock::now();
+    }
+    glfwWaitEventsTimeout(m_Busy ? m_BusyTimeout : m_IdleTimeout);
+}
+
+void FrameScheduler::paceUntil(Clock::time_point deadline) {
+    // Sleep short of the deadline by the worst oversleep seen recently,
+    // then spin; the slack decays so one bad wakeup does not stick
+    const auto sleepUntil = deadline - m_SleepSlack;
+    auto now = Clock::now();
+    if (sleepUntil > now) {
+        std::this_thread::sleep_until(sleepUntil);
+        now = Clock::now();
+        const auto overshoot = now - sleepUntil;
+        m_SleepSlack = std::max<Clock::duration>(overshoot, m_SleepSlack * 15 / 16);
+        m_SleepSlack = std::clamp<Clock::duration>(m_SleepSlack, std::chrono::microseconds(200),
+                                                   std::chrono::milliseconds(4));
+    }
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+void FrameScheduler::frameDone() {
+    m_Dirty = false;
+
+    if (m_MaxFps > 0.0) {
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_MaxFps));
+        paceUntil(m_NextFrame);
+        // Advance from the deadline rather than from now so frame spacing
+        // stays even; after a long stall (or idling) start over from now
+        const auto now = Clock::now();
+        m_NextFrame = now - m_NextFrame > period ? now + period : m_NextFrame + period;
+    }
+
+    ++m_FrameCount;
+    const auto now = Clock::now();
+    const double elapsed = std::chrono::duration<double>(now - m_CountStart).count();
+    if (elapsed >= 1.0) {
+        m_DrawnFps = m_FrameCount / elapsed;
+        m_FrameCount = 0;
+        m_CountStart = now;
+    }
+}
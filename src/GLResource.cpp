@@ -0,0 +1,219 @@
+#include "GLResource.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// glObjectLabel identifiers (GL 4.3); the 3.3 headers lack most of them
+static constexpr GLenum kLabelBuffer = 0x82E0;
+static constexpr GLenum kLabelShader = 0x82E1;
+static constexpr GLenum kLabelProgram = 0x82E2;
+static constexpr GLenum kLabelQuery = 0x82E3;
+static constexpr GLenum kLabelVertexArray = 0x8074;
+static constexpr GLenum kLabelTexture = 0x1702;
+static constexpr GLenum kLabelRenderbuffer = 0x8D41;
+static constexpr GLenum kLabelFramebuffer = 0x8D40;
+
+static double mebibytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+const char* resourceTypeName(GLResourceType type) {
+    switch (type) {
+    case GLResourceType::Buffer: return "buffer";
+    case GLResourceType::Texture: return "texture";
+    case GLResourceType::Renderbuffer: return "renderbuffer";
+    case GLResourceType::Framebuffer: return "framebuffer";
+    case GLResourceType::VertexArray: return "vertex array";
+    case GLResourceType::Query: return "query";
+    case GLResourceType::Shader: return "shader";
+    case GLResourceType::Program: return "program";
+    }
+    return "?";
+}
+
+static GLenum labelIdentifier(GLResourceType type) {
+    switch (type) {
+    case GLResourceType::Buffer: return kLabelBuffer;
+    case GLResourceType::Texture: return kLabelTexture;
+    case GLResourceType::Renderbuffer: return kLabelRenderbuffer;
+    case GLResourceType::Framebuffer: return kLabelFramebuffer;
+    case GLResourceType::VertexArray: return kLabelVertexArray;
+    case GLResourceType::Query: return kLabelQuery;
+    case GLResourceType::Shader: return kLabelShader;
+    case GLResourceType::Program: return kLabelProgram;
+    }
+    return 0;
+}
+
+// Whether the name refers to an object yet (glGen* names do not until bound)
+static bool objectExists(GLResourceType type, GLuint id) {
+    switch (type) {
+    case GLResourceType::Buffer: return glIsBuffer(id);
+    case GLResourceType::Texture: return glIsTexture(id);
+    case GLResourceType::Renderbuffer: return glIsRenderbuffer(id);
+    case GLResourceType::Framebuffer: return glIsFramebuffer(id);
+    case GLResourceType::VertexArray: return glIsVertexArray(id);
+    case GLResourceType::Query: return glIsQuery(id);
+    case GLResourceType::Shader: return glIsShader(id);
+    case GLResourceType::Program: return glIsProgram(id);
+    }
+    return false;
+}
+
+GLRegistry& GLRegistry::shared() {
+    static GLRegistry instance;
+    return instance;
+}
+
+void GLRegistry::enableLabels(GLADloadfunc load) {
+    GLint major = 0, minor = 0, extensions = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool supported = major > 4 || (major == 4 && minor >= 3);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (GLint i = 0; i < extensions && !supported; ++i) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        supported = name && std::strcmp(name, "GL_KHR_debug") == 0;
+    }
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_ObjectLabel = supported ? reinterpret_cast<ObjectLabelProc>(load("glObjectLabel")) : nullptr;
+}
+
+GLuint GLRegistry::create(GLResourceType type, const std::string& label, GLSite site, GLenum shaderType) {
+    GLuint id = 0;
+    switch (type) {
+    case GLResourceType::Buffer: glGenBuffers(1, &id); break;
+    case GLResourceType::Texture: glGenTextures(1, &id); break;
+    case GLResourceType::Renderbuffer: glGenRenderbuffers(1, &id); break;
+    case GLResourceType::Framebuffer: glGenFramebuffers(1, &id); break;
+    case GLResourceType::VertexArray: glGenVertexArrays(1, &id); break;
+    case GLResourceType::Query: glGenQueries(1, &id); break;
+    case GLResourceType::Shader: id = glCreateShader(shaderType); break;
+    case GLResourceType::Program: id = glCreateProgram(); break;
+    }
+    if (!id)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    Entry& entry = m_Entries[key(type, id)];
+    entry.type = type;
+    entry.id = id;
+    entry.label = label;
+    entry.bytes = 0;
+    entry.site = site;
+    ++m_Count[size_t(type)];
+    if (!label.empty())
+        m_Unlabelled.push_back(key(type, id));
+    return id;
+}
+
+void GLRegistry::destroy(GLResourceType type, GLuint id) {
+    switch (type) {
+    case GLResourceType::Buffer: glDeleteBuffers(1, &id); break;
+    case GLResourceType::Texture: glDeleteTextures(1, &id); break;
+    case GLResourceType::Renderbuffer: glDeleteRenderbuffers(1, &id); break;
+    case GLResourceType::Framebuffer: glDeleteFramebuffers(1, &id); break;
+    case GLResourceType::VertexArray: glDeleteVertexArrays(1, &id); break;
+    case GLResourceType::Query: glDeleteQueries(1, &id); break;
+    case GLResourceType::Shader: glDeleteShader(id); break;
+    case GLResourceType::Program: glDeleteProgram(id); break;
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto found = m_Entries.find(key(type, id));
+    if (found == m_Entries.end())
+        return;
+    m_Bytes[size_t(type)] -= found->second.bytes;
+    m_Total -= found->second.bytes;
+    --m_Count[size_t(type)];
+    m_Entries.erase(found);
+    m_Unlabelled.erase(std::remove(m_Unlabelled.begin(), m_Unlabelled.end(), key(type, id)), m_Unlabelled.end());
+}
+
+void GLRegistry::setBytes(GLResourceType type, GLuint id, size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto found = m_Entries.find(key(type, id));
+    if (found == m_Entries.end())
+        return;
+    m_Bytes[size_t(type)] += bytes - found->second.bytes;
+    m_Total += bytes - found->second.bytes;
+    found->second.bytes = bytes;
+    m_Peak = std::max(m_Peak, m_Total);
+}
+
+size_t GLRegistry::bytes(GLResourceType type, GLuint id) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto found = m_Entries.find(key(type, id));
+    return found == m_Entries.end() ? 0 : found->second.bytes;
+}
+
+void GLRegistry::update() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_ObjectLabel)
+        return;
+    auto labelled = std::remove_if(m_Unlabelled.begin(), m_Unlabelled.end(), [&](uint64_t entryKey) {
+        const Entry& entry = m_Entries.at(entryKey);
+        if (!objectExists(entry.type, entry.id))
+            return false;
+        m_ObjectLabel(labelIdentifier(entry.type), entry.id, static_cast<GLsizei>(entry.label.size()),
+                      entry.label.c_str());
+        return true;
+    });
+    m_Unlabelled.erase(labelled, m_Unlabelled.end());
+}
+
+size_t GLRegistry::liveCount(GLResourceType type) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Count[size_t(type)];
+}
+
+size_t GLRegistry::liveBytes(GLResourceType type) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Bytes[size_t(type)];
+}
+
+size_t GLRegistry::totalBytes() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Total;
+}
+
+size_t GLRegistry::peakBytes() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Peak;
+}
+
+std::string GLRegistry::summary() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    char text[64];
+    std::snprintf(text, sizeof(text), "%.1f MiB (peak %.1f)", mebibytes(m_Total), mebibytes(m_Peak));
+    std::string line = text;
+    size_t objects = 0;
+    for (size_t type = 0; type < GLResourceTypeCount; ++type) {
+        objects += m_Count[type];
+        if (m_Bytes[type] == 0)
+            continue;
+        std::snprintf(text, sizeof(text), ", %ss %.1f", resourceTypeName(GLResourceType(type)),
+                      mebibytes(m_Bytes[type]));
+        line += text;
+    }
+    return line + ", " + std::to_string(objects) + " objects";
+}
+
+size_t GLRegistry::reportLeaks(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::vector<const Entry*> live;
+    for (const auto& [entryKey, entry] : m_Entries)
+        live.push_back(&entry);
+    std::sort(live.begin(), live.end(), [](const Entry* a, const Entry* b) {
+        return a->type != b->type ? a->type < b->type : a->id < b->id;
+    });
+    for (const Entry* entry : live) {
+        out << "Leaked GL " << resourceTypeName(entry->type) << " " << entry->id;
+        if (!entry->label.empty())
+            out << " '" << entry->label << "'";
+        if (entry->bytes)
+            out << ", " << entry->bytes << " bytes";
+        out << ", created at " << entry->site.file << ":" << entry->site.line << "\n";
+    }
+    return live.size();
+}
@@ -0,0 +1,280 @@
+#include "GLTrace.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace GLTraceFormat;
+
+namespace {
+
+uint64_t nanoseconds(std::chrono::steady_clock::duration duration) {
+    return static_cast<uint64_t>(std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0));
+}
+
+void putU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void putBytes(std::vector<uint8_t>& out, size_t index, const void* data, size_t size) {
+    putVarint(out, index);
+    putVarint(out, size);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+} // namespace
+
+GLTracer& GLTracer::shared() {
+    static GLTracer tracer;
+    return tracer;
+}
+
+bool GLTracer::start(const std::string& path, int width, int height) {
+    stop();
+    m_Output = std::fopen(path.c_str(), "wb");
+    if (!m_Output) {
+        std::cerr << "Failed to open " << path << " for the GL trace" << std::endl;
+        return false;
+    }
+
+    m_Pending.clear();
+    m_Written = 0;
+    m_Ids.clear();
+    m_Functions.clear();
+    m_State = ClientState();
+    m_Bindings.clear();
+    m_ElementBuffers.clear();
+    m_VertexArray = 0;
+    m_BufferSizes.clear();
+    m_Mappings.clear();
+    m_Unmapped.clear();
+    m_HasUnmapped = false;
+    m_Calls = m_Frames = m_Unsized = 0;
+    m_PreviousFrame = m_CallStart = std::chrono::steady_clock::now();
+
+    m_Pending.insert(m_Pending.end(), Magic, Magic + sizeof(Magic));
+    putU32(m_Pending, Version);
+    putU32(m_Pending, static_cast<uint32_t>(std::max(width, 0)));
+    putU32(m_Pending, static_cast<uint32_t>(std::max(height, 0)));
+
+    if (!m_Installed) {
+        gladSetGLPreCallback(&GLTracer::preCall);
+        gladSetGLPostCallback(&GLTracer::postCall);
+        m_Installed = true;
+    }
+    std::cout << "Tracing GL calls to " << path << std::endl;
+    return true;
+}
+
+void GLTracer::stop() {
+    if (!m_Output)
+        return;
+    m_Pending.push_back(End);
+    flush(true);
+    std::fclose(m_Output);
+    m_Output = nullptr;
+    std::cout << "GL trace: " << m_Calls << " calls in " << m_Frames << " frames, " << m_Written << " bytes";
+    if (m_Unsized)
+        std::cout << ", " << m_Unsized << " calls with client memory of unknown size";
+    std::cout << std::endl;
+}
+
+void GLTracer::frameDone() {
+    if (!m_Output)
+        return;
+    const auto now = std::chrono::steady_clock::now();
+    m_Pending.push_back(Frame);
+    putVarint(m_Pending, nanoseconds(now - m_PreviousFrame));
+    m_PreviousFrame = now;
+    ++m_Frames;
+    flush(false);
+}
+
+// Same checks as glad's default callbacks, plus the recording
+void GLTracer::preCall(const char* name, GLADapiproc function, int count, ...) {
+    if (!function) {
+        std::fprintf(stderr, "GLAD: ERROR %s is NULL!\n", name);
+        return;
+    }
+    (void)glad_glGetError();
+
+    GLTracer& tracer = shared();
+    if (!tracer.m_Output)
+        return;
+    // The mapping is gone once the call returns
+    if (std::strcmp(name, "glUnmapBuffer") == 0) {
+        va_list arguments;
+        va_start(arguments, count);
+        const GLenum target = va_arg(arguments, GLenum);
+        va_end(arguments);
+        auto mapping = tracer.m_Mappings.find(tracer.boundBuffer(target));
+        if (mapping != tracer.m_Mappings.end() && mapping->second.write && mapping->second.data) {
+            tracer.m_Unmapped.assign(mapping->second.data, mapping->second.data + mapping->second.length);
+            tracer.m_HasUnmapped = true;
+        }
+    }
+    tracer.m_CallStart = std::chrono::steady_clock::now();
+}
+
+void GLTracer::postCall(void* result, const char* name, GLADapiproc function, int count, ...) {
+    (void)function;
+    GLTracer& tracer = shared();
+    if (tracer.m_Output) {
+        va_list arguments;
+        va_start(arguments, count);
+        tracer.record(name, result, &arguments);
+        va_end(arguments);
+    }
+
+    const GLenum error = glad_glGetError();
+    if (error != GL_NO_ERROR)
+        std::fprintf(stderr, "GLAD: ERROR %d in %s!\n", error, name);
+}
+
+void GLTracer::record(const char* name, void* result, va_list* arguments) {
+    const auto end = std::chrono::steady_clock::now();
+    const uint32_t id = functionId(name);
+    if (id == UINT32_MAX)
+        return;
+    const FunctionInfo& function = *m_Functions[id];
+
+    Value values[MaxParams];
+    function.read(arguments, values);
+    const Value returned = function.readResult(result);
+
+    m_Pending.push_back(Call);
+    putVarint(m_Pending, id);
+    putVarint(m_Pending, nanoseconds(end - m_CallStart));
+    for (size_t i = 0; i < function.params.size(); ++i)
+        putValue(m_Pending, function.params[i].kind, values[i]);
+    putValue(m_Pending, function.result, returned);
+
+    // Client memory, sized with the pixel-store state before this call
+    std::vector<uint8_t> payloads;
+    size_t payloadCount = 0;
+    bool unsized = false;
+    for (size_t i = 0; i < function.params.size(); ++i) {
+        const Param& param = function.params[i];
+        const void* pointer = reinterpret_cast<const void*>(static_cast<uintptr_t>(values[i].u));
+        if (param.kind != Kind::Pointer || !pointer)
+            continue;
+        if (param.role == Role::CString) {
+            putBytes(payloads, i, pointer, std::strlen(static_cast<const char*>(pointer)) + 1);
+            ++payloadCount;
+        } else if (param.role == Role::StringList) {
+            // Each string as its own terminated copy, cut to `length` if given
+            int countIndex = function.find("count");
+            if (countIndex < 0)
+                countIndex = function.find("uniformCount");
+            const int lengthIndex = function.find("length");
+            const auto* strings = static_cast<const GLchar* const*>(pointer);
+            const auto* lengths = lengthIndex < 0 ? nullptr
+                                                  : reinterpret_cast<const GLint*>(
+                                                        static_cast<uintptr_t>(values[lengthIndex].u));
+            std::vector<uint8_t> joined;
+            for (int64_t s = 0; countIndex >= 0 && s < values[countIndex].i; ++s) {
+                const size_t length = lengths && lengths[s] >= 0 ? static_cast<size_t>(lengths[s])
+                                                                 : std::strlen(strings[s]);
+                joined.insert(joined.end(), strings[s], strings[s] + length);
+                joined.push_back(0);
+            }
+            putBytes(payloads, i, joined.data(), joined.size());
+            ++payloadCount;
+        } else {
+            const size_t bytes = clientBytes(function, i, values, m_State);
+            if (bytes == SIZE_MAX) {
+                unsized = true;
+            } else if (bytes > 0 && param.role != Role::Output) {
+                putBytes(payloads, i, pointer, bytes);
+                ++payloadCount;
+            }
+        }
+    }
+    if (m_HasUnmapped) {
+        putBytes(payloads, function.params.size(), m_Unmapped.data(), m_Unmapped.size());
+        ++payloadCount;
+        m_HasUnmapped = false;
+        m_Unmapped.clear();
+    }
+    putVarint(m_Pending, payloadCount);
+    m_Pending.insert(m_Pending.end(), payloads.begin(), payloads.end());
+
+    m_State.observe(function, values);
+    trackBuffers(function.name, values, returned);
+    m_Unsized += unsized;
+    ++m_Calls;
+    flush(false);
+}
+
+uint32_t GLTracer::functionId(const char* name) {
+    auto found = m_Ids.find(name);
+    if (found != m_Ids.end())
+        return found->second;
+
+    const FunctionInfo* function = findFunction(name);
+    uint32_t id = UINT32_MAX;
+    if (function) {
+        id = static_cast<uint32_t>(m_Functions.size());
+        m_Functions.push_back(function);
+        const size_t length = std::strlen(name);
+        m_Pending.push_back(Function);
+        putVarint(m_Pending, id);
+        putVarint(m_Pending, length);
+        m_Pending.insert(m_Pending.end(), name, name + length);
+    } else {
+        std::cerr << "GL trace: no signature for " << name << "; regenerate GLTraceFunctions.inc" << std::endl;
+    }
+    m_Ids.emplace(name, id);
+    return id;
+}
+
+GLuint GLTracer::boundBuffer(GLenum target) const {
+    auto found = m_Bindings.find(target);
+    return found == m_Bindings.end() ? 0 : found->second;
+}
+
+void GLTracer::trackBuffers(const std::string& name, const Value* values, Value result) {
+    if (name == "glBindBuffer" || name == "glBindBufferBase" || name == "glBindBufferRange") {
+        const GLenum target = static_cast<GLenum>(values[0].u);
+        const GLuint buffer = static_cast<GLuint>(values[name == "glBindBuffer" ? 1 : 2].u);
+        m_Bindings[target] = buffer;
+        // The element array binding belongs to the vertex array
+        if (target == GL_ELEMENT_ARRAY_BUFFER)
+            m_ElementBuffers[m_VertexArray] = buffer;
+    } else if (name == "glBindVertexArray") {
+        m_VertexArray = static_cast<GLuint>(values[0].u);
+        m_Bindings[GL_ELEMENT_ARRAY_BUFFER] = m_ElementBuffers[m_VertexArray];
+    } else if (name == "glBufferData") {
+        m_BufferSizes[boundBuffer(static_cast<GLenum>(values[0].u))] = static_cast<size_t>(values[1].i);
+    } else if (name == "glDeleteBuffers") {
+        const auto* buffers = reinterpret_cast<const GLuint*>(static_cast<uintptr_t>(values[1].u));
+        for (int64_t i = 0; buffers && i < values[0].i; ++i) {
+            m_BufferSizes.erase(buffers[i]);
+            m_Mappings.erase(buffers[i]);
+        }
+    } else if (name == "glMapBufferRange") {
+        Mapping& mapping = m_Mappings[boundBuffer(static_cast<GLenum>(values[0].u))];
+        mapping.data = reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(result.u));
+        mapping.length = static_cast<size_t>(values[2].i);
+        mapping.write = (values[3].u & GL_MAP_WRITE_BIT) != 0;
+    } else if (name == "glMapBuffer") {
+        const GLuint buffer = boundBuffer(static_cast<GLenum>(values[0].u));
+        Mapping& mapping = m_Mappings[buffer];
+        mapping.data = reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(result.u));
+        mapping.length = m_BufferSizes[buffer];
+        mapping.write = values[1].u != GL_READ_ONLY;
+    } else if (name == "glUnmapBuffer") {
+        m_Mappings.erase(boundBuffer(static_cast<GLenum>(values[0].u)));
+    }
+}
+
+void GLTracer::flush(bool force) {
+    if (!m_Output || (!force && m_Pending.size() < (1u << 20)))
+        return;
+    if (std::fwrite(m_Pending.data(), 1, m_Pending.size(), m_Output) != m_Pending.size())
+        std::cerr << "Failed to write the GL trace" << std::endl;
+    m_Written += m_Pending.size();
+    m_Pending.clear();
+}
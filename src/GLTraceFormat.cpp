@@ -0,0 +1,399 @@
+#include "GLTraceFormat.h"
+#include <cstring>
+#include <regex>
+#include <unordered_map>
+
+namespace GLTraceFormat {
+
+namespace {
+
+struct Declaration {
+    const char* name;
+    const char* params;
+    std::vector<Kind> kinds;
+    Kind result;
+    void (*read)(va_list*, Value*);
+    Value (*readResult)(const void*);
+    Value (*call)(const Value*);
+};
+
+std::vector<Declaration> declarations() {
+    return {
+#define GL_TRACE_FUNCTION(function, params)                                                                    \
+    {#function,                                                                                                \
+     params,                                                                                                   \
+     FunctionTraits<decltype(glad_##function)>::kinds(),                                                       \
+     FunctionTraits<decltype(glad_##function)>::result(),                                                      \
+     &FunctionTraits<decltype(glad_##function)>::read,                                                         \
+     &FunctionTraits<decltype(glad_##function)>::readResult,                                                   \
+     [](const Value* values) { return FunctionTraits<decltype(glad_##function)>::call(glad_##function, values); }},
+#include "GLTraceFunctions.inc"
+#undef GL_TRACE_FUNCTION
+    };
+}
+
+Space spaceOf(const std::string& name) {
+    static const std::unordered_map<std::string, Space> spaces = {
+        {"buffer", Space::Buffer},        {"buffers", Space::Buffer},
+        {"texture", Space::Texture},      {"textures", Space::Texture},
+        {"program", Space::Program},      {"shader", Space::Shader},
+        {"framebuffer", Space::Framebuffer}, {"framebuffers", Space::Framebuffer},
+        {"renderbuffer", Space::Renderbuffer}, {"renderbuffers", Space::Renderbuffer},
+        {"array", Space::VertexArray},    {"arrays", Space::VertexArray},
+        {"id", Space::Query},             {"ids", Space::Query},
+        {"sampler", Space::Sampler},      {"samplers", Space::Sampler},
+    };
+    auto found = spaces.find(name);
+    return found == spaces.end() ? Space::None : found->second;
+}
+
+void classify(const std::string& function, Param& param) {
+    const bool pointer = param.type.find('*') != std::string::npos;
+    const bool constant = param.type.compare(0, 6, "const ") == 0;
+    if (param.type == "GLsync") {
+        param.role = Role::Sync;
+    } else if (param.type == "GLuint" && (param.space = spaceOf(param.name)) != Space::None) {
+        param.role = Role::Object;
+    } else if (param.type == "GLint" && param.name == "location") {
+        param.role = Role::Location;
+    } else if (pointer && param.type == "const GLchar * const *") {
+        param.role = Role::StringList;
+    } else if (pointer && param.type == "const GLchar *") {
+        param.role = Role::CString;
+    } else if (pointer && (param.space = spaceOf(param.name)) != Space::None &&
+               (function.compare(0, 5, "glGen") == 0 || function.compare(0, 8, "glDelete") == 0)) {
+        param.role = constant ? Role::Objects : Role::NewObjects;
+    } else if (pointer) {
+        param.space = Space::None;
+        param.role = constant ? Role::Input : Role::Output;
+    }
+}
+
+std::vector<FunctionInfo> build() {
+    std::vector<FunctionInfo> result;
+    for (auto& declaration : declarations()) {
+        FunctionInfo info;
+        info.name = declaration.name;
+        info.result = declaration.result;
+        info.resultSpace = std::strcmp(declaration.name, "glCreateShader") == 0    ? Space::Shader
+                           : std::strcmp(declaration.name, "glCreateProgram") == 0 ? Space::Program
+                                                                                   : Space::None;
+        info.read = declaration.read;
+        info.readResult = declaration.readResult;
+        info.call = declaration.call;
+
+        // "GLenum target, const GLfloat * value": the last word is the name
+        const std::string params = declaration.params;
+        size_t start = 0;
+        while (start < params.size()) {
+            size_t end = params.find(',', start);
+            if (end == std::string::npos)
+                end = params.size();
+            const std::string text = params.substr(start, end - start);
+            const size_t first = text.find_first_not_of(' ');
+            const size_t last = text.find_last_not_of(' ');
+            const size_t split = text.find_last_of(' ', last);
+            Param param;
+            param.type = text.substr(first, split - first);
+            param.name = text.substr(split + 1, last - split);
+            info.params.push_back(param);
+            start = end + 1;
+        }
+        for (size_t i = 0; i < info.params.size(); ++i) {
+            info.params[i].kind = i < declaration.kinds.size() ? declaration.kinds[i] : Kind::Unsigned;
+            classify(info.name, info.params[i]);
+        }
+        result.push_back(std::move(info));
+    }
+    return result;
+}
+
+size_t componentsOf(GLenum format) {
+    switch (format) {
+    case GL_RG:
+    case GL_RG_INTEGER:
+    case GL_DEPTH_STENCIL:
+        return 2;
+    case GL_RGB:
+    case GL_BGR:
+    case GL_RGB_INTEGER:
+    case GL_BGR_INTEGER:
+        return 3;
+    case GL_RGBA:
+    case GL_BGRA:
+    case GL_RGBA_INTEGER:
+    case GL_BGRA_INTEGER:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+size_t pixelBytes(GLenum format, GLenum type) {
+    switch (type) {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+        return componentsOf(format);
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT:
+        return 2 * componentsOf(format);
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT:
+        return 4 * componentsOf(format);
+    case GL_UNSIGNED_BYTE_3_3_2:
+    case GL_UNSIGNED_BYTE_2_3_3_REV:
+        return 1;
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_5_6_5_REV:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+    case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+        return 2;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    default: // the remaining packed types are 32 bits
+        return 4;
+    }
+}
+
+size_t imageBytes(int64_t width, int64_t height, int64_t depth, GLenum format, GLenum type, GLint alignment,
+                  GLint rowLength, GLint imageHeight) {
+    if (width <= 0 || height <= 0 || depth <= 0)
+        return 0;
+    const size_t row = static_cast<size_t>(rowLength > 0 ? rowLength : width) * pixelBytes(format, type);
+    const size_t stride = (row + alignment - 1) / alignment * alignment;
+    const size_t rows = static_cast<size_t>(imageHeight > 0 ? imageHeight : height) * (depth - 1) + height;
+    return stride * (rows - 1) + row;
+}
+
+// Components in "glUniform3fv", "glUniformMatrix3x4fv", "glVertexAttrib4Nubv"
+size_t vectorBytes(const std::string& name, int64_t count) {
+    static const std::regex matrix("glUniformMatrix([234])(?:x([234]))?[a-z]*v");
+    static const std::regex vector("gl(?:Uniform|VertexAttribI?L?)([1234])N?(ub|us|ui|b|s|i|f|d)v");
+    std::smatch match;
+    if (std::regex_match(name, match, matrix)) {
+        const size_t rows = std::stoul(match[1]);
+        const size_t columns = match[2].matched ? std::stoul(match[2]) : rows;
+        return static_cast<size_t>(count) * rows * columns * (name.find("dv") != std::string::npos ? 8 : 4);
+    }
+    if (std::regex_match(name, match, vector)) {
+        const std::string suffix = match[2];
+        const size_t scalar = suffix == "d" ? 8 : suffix == "s" || suffix == "us" ? 2 : suffix == "b" || suffix == "ub" ? 1 : 4;
+        return static_cast<size_t>(count) * std::stoul(match[1]) * scalar;
+    }
+    return SIZE_MAX;
+}
+
+bool startsWith(const std::string& text, const char* prefix) {
+    return text.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+} // namespace
+
+int FunctionInfo::find(const char* param) const {
+    for (size_t i = 0; i < params.size(); ++i) {
+        if (params[i].name == param)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+const std::vector<FunctionInfo>& functions() {
+    static const std::vector<FunctionInfo> table = build();
+    return table;
+}
+
+const FunctionInfo* findFunction(const std::string& name) {
+    static const std::unordered_map<std::string, const FunctionInfo*> byName = [] {
+        std::unordered_map<std::string, const FunctionInfo*> map;
+        for (const auto& function : functions())
+            map[function.name] = &function;
+        return map;
+    }();
+    auto found = byName.find(name);
+    return found == byName.end() ? nullptr : found->second;
+}
+
+void ClientState::observe(const FunctionInfo& function, const Value* values) {
+    const std::string name = function.name;
+    if (name == "glBindBuffer") {
+        if (values[0].u == GL_PIXEL_UNPACK_BUFFER)
+            unpackBuffer = static_cast<GLuint>(values[1].u);
+        else if (values[0].u == GL_PIXEL_PACK_BUFFER)
+            packBuffer = static_cast<GLuint>(values[1].u);
+    } else if (name == "glPixelStorei") {
+        const GLint value = static_cast<GLint>(values[1].i);
+        switch (values[0].u) {
+        case GL_UNPACK_ALIGNMENT: unpackAlignment = value; break;
+        case GL_UNPACK_ROW_LENGTH: unpackRowLength = value; break;
+        case GL_UNPACK_IMAGE_HEIGHT: unpackImageHeight = value; break;
+        case GL_PACK_ALIGNMENT: packAlignment = value; break;
+        case GL_PACK_ROW_LENGTH: packRowLength = value; break;
+        }
+    }
+}
+
+size_t clientBytes(const FunctionInfo& function, size_t index, const Value* values, const ClientState& state) {
+    if (values[index].u == 0)
+        return 0;
+    const std::string name = function.name;
+    const Param& param = function.params[index];
+    auto arg = [&](const char* paramName, int64_t fallback) {
+        const int i = function.find(paramName);
+        return i < 0 ? fallback : values[i].i;
+    };
+    auto argU = [&](const char* paramName) {
+        const int i = function.find(paramName);
+        return i < 0 ? 0 : static_cast<GLenum>(values[i].u);
+    };
+
+    switch (param.role) {
+    case Role::Objects:
+    case Role::NewObjects:
+        return static_cast<size_t>(arg("n", 0)) * sizeof(GLuint);
+    case Role::CString:
+        return SIZE_MAX; // measured by the writer
+    case Role::Input:
+    case Role::Output:
+        break;
+    default:
+        return 0;
+    }
+
+    // Client arrays of per-draw counts, firsts and element offsets; the
+    // offsets themselves are into the bound element buffer
+    if (startsWith(name, "glMultiDraw")) {
+        const size_t draws = static_cast<size_t>(arg("drawcount", 0));
+        return param.name == "indices" ? draws * sizeof(void*) : draws * sizeof(GLint);
+    }
+    // Buffer offsets in every other core-profile use
+    if (param.name == "pointer" || param.name == "indices")
+        return 0;
+
+    if (startsWith(name, "glTexImage") || startsWith(name, "glTexSubImage")) {
+        if (state.unpackBuffer)
+            return 0;
+        return imageBytes(arg("width", 1), arg("height", 1), arg("depth", 1), argU("format"), argU("type"),
+                          state.unpackAlignment, state.unpackRowLength, state.unpackImageHeight);
+    }
+    if (startsWith(name, "glCompressedTex"))
+        return state.unpackBuffer ? 0 : static_cast<size_t>(arg("imageSize", 0));
+    if (name == "glReadPixels") {
+        if (state.packBuffer)
+            return 0;
+        return imageBytes(arg("width", 1), arg("height", 1), 1, argU("format"), argU("type"), state.packAlignment,
+                          state.packRowLength, 0);
+    }
+    if (name == "glGetTexImage" || name == "glGetCompressedTexImage")
+        return state.packBuffer ? 0 : SIZE_MAX;
+    if (name == "glBufferData" || name == "glBufferSubData" || name == "glGetBufferSubData")
+        return static_cast<size_t>(arg("size", 0));
+    if (startsWith(name, "glUniform") || startsWith(name, "glVertexAttrib")) {
+        if (name.find("P") != std::string::npos && name.find("uiv") != std::string::npos)
+            return sizeof(GLuint); // packed 2_10_10_10 formats
+        return vectorBytes(name, arg("count", 1));
+    }
+    if (startsWith(name, "glTexParameter") || startsWith(name, "glSamplerParameter") ||
+        startsWith(name, "glPointParameter"))
+        return argU("pname") == GL_TEXTURE_BORDER_COLOR ? 16 : 4;
+    if (startsWith(name, "glClearBuffer"))
+        return argU("buffer") == GL_COLOR ? 16 : 4;
+    if (name == "glShaderSource" && param.name == "length")
+        return static_cast<size_t>(arg("count", 0)) * sizeof(GLint);
+    if (name == "glDrawBuffers")
+        return static_cast<size_t>(arg("n", 0)) * sizeof(GLenum);
+    if (name == "glGetActiveUniformsiv" && param.name == "uniformIndices")
+        return static_cast<size_t>(arg("uniformCount", 0)) * sizeof(GLuint);
+    // Packed legacy attribute entry points (glColorP4uiv, ...)
+    if (name.size() > 4 && name.compare(name.size() - 3, 3, "uiv") == 0 && name.find('P') != std::string::npos)
+        return sizeof(GLuint);
+
+    if (param.role == Role::Output) {
+        // Queries with a caller-given size; the rest return a few values
+        const int bufSize = function.find("bufSize");
+        if (bufSize >= 0)
+            return static_cast<size_t>(values[bufSize].i) + sizeof(GLint64);
+        return 4096;
+    }
+    return SIZE_MAX;
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        const uint8_t byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void putValue(std::vector<uint8_t>& out, Kind kind, Value value) {
+    switch (kind) {
+    case Kind::Void:
+        break;
+    case Kind::Signed: // zigzag, so small negative numbers stay short
+        putVarint(out, (static_cast<uint64_t>(value.i) << 1) ^ static_cast<uint64_t>(value.i >> 63));
+        break;
+    case Kind::Float: {
+        const float single = static_cast<float>(value.f);
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&single);
+        out.insert(out.end(), bytes, bytes + sizeof(single));
+        break;
+    }
+    case Kind::Double: {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value.f);
+        out.insert(out.end(), bytes, bytes + sizeof(value.f));
+        break;
+    }
+    default:
+        putVarint(out, value.u);
+        break;
+    }
+}
+
+bool getValue(const uint8_t*& in, const uint8_t* end, Kind kind, Value& value) {
+    value.u = 0;
+    switch (kind) {
+    case Kind::Void:
+        return true;
+    case Kind::Signed: {
+        uint64_t encoded;
+        if (!getVarint(in, end, encoded))
+            return false;
+        value.i = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+        return true;
+    }
+    case Kind::Float: {
+        float single;
+        if (end - in < static_cast<ptrdiff_t>(sizeof(single)))
+            return false;
+        std::memcpy(&single, in, sizeof(single));
+        in += sizeof(single);
+        value.f = single;
+        return true;
+    }
+    case Kind::Double:
+        if (end - in < static_cast<ptrdiff_t>(sizeof(value.f)))
+            return false;
+        std::memcpy(&value.f, in, sizeof(value.f));
+        in += sizeof(value.f);
+        return true;
+    default:
+        return getVarint(in, end, value.u);
+    }
+}
+
+} // namespace GLTraceFormat
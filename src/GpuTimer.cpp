@@ -0,0 +1,40 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer(size_t depth) : m_Queries(depth) {
+    for (auto& query : m_Queries)
+        query.create("GpuTimer", GL_HERE);
+}
+
+GpuTimer::~GpuTimer() = default;
+
+void GpuTimer::begin() {
+    m_Running = m_Pending < m_Queries.size();
+    if (m_Running)
+        glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Next]);
+}
+
+void GpuTimer::end() {
+    if (!m_Running)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_Next = (m_Next + 1) % m_Queries.size();
+    ++m_Pending;
+    m_Running = false;
+}
+
+bool GpuTimer::poll(double& milliseconds) {
+    bool found = false;
+    while (m_Pending > 0) {
+        const GLuint query = m_Queries[(m_Next + m_Queries.size() - m_Pending) % m_Queries.size()];
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        milliseconds = nanoseconds / 1.0e6;
+        found = true;
+        --m_Pending;
+    }
+    return found;
+}
@@ -0,0 +1,466 @@
+#include "Image.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#if __has_include(<stb/stb_image.h>)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#define SHADERVIEWER_HAS_STB_IMAGE 1
+#endif
+
+bool readFileBytes(const std::string& path, std::vector<unsigned char>& bytes) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    bytes.resize(static_cast<size_t>(size));
+    return size == 0 || file.read(reinterpret_cast<char*>(bytes.data()), size).good();
+}
+
+static void flipRows(Image& image) {
+    const size_t rowBytes = static_cast<size_t>(image.width) * 4;
+    std::vector<unsigned char> row(rowBytes);
+    for (int y = 0; y < image.height / 2; ++y) {
+        unsigned char* a = &image.pixels[y * rowBytes];
+        unsigned char* b = &image.pixels[(image.height - 1 - y) * rowBytes];
+        std::memcpy(row.data(), a, rowBytes);
+        std::memcpy(a, b, rowBytes);
+        std::memcpy(b, row.data(), rowBytes);
+    }
+}
+
+static bool decodeTGA(const std::vector<unsigned char>& bytes, Image& out, std::string& error) {
+    if (bytes.size() < 18) {
+        error = "truncated TGA header";
+        return false;
+    }
+    const unsigned char idLength = bytes[0];
+    const unsigned char colorMapType = bytes[1];
+    const unsigned char imageType = bytes[2];
+    const int width = bytes[12] | (bytes[13] << 8);
+    const int height = bytes[14] | (bytes[15] << 8);
+    const int bpp = bytes[16];
+    const bool topDown = (bytes[17] & 0x20) != 0;
+
+    const bool rle = imageType == 10 || imageType == 11;
+    const bool gray = imageType == 3 || imageType == 11;
+    if (colorMapType != 0 || !(imageType == 2 || imageType == 3 || rle)) {
+        error = "unsupported TGA type " + std::to_string(imageType);
+        return false;
+    }
+    if (width <= 0 || height <= 0) {
+        error = "empty TGA image";
+        return false;
+    }
+    if ((gray && bpp != 8) || (!gray && bpp != 24 && bpp != 32)) {
+        error = "unsupported TGA depth " + std::to_string(bpp);
+        return false;
+    }
+
+    const int channels = bpp / 8;
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    out.width = width;
+    out.height = height;
+    out.pixels.assign(pixelCount * 4, 255);
+
+    size_t src = 18 + idLength;
+    auto readPixel = [&](size_t dst) {
+        if (src + channels > bytes.size())
+            return false;
+        unsigned char* p = &out.pixels[dst * 4];
+        if (gray) {
+            p[0] = p[1] = p[2] = bytes[src];
+        } else {
+            p[0] = bytes[src + 2];
+            p[1] = bytes[src + 1];
+            p[2] = bytes[src + 0];
+            if (channels == 4)
+                p[3] = bytes[src + 3];
+        }
+        return true;
+    };
+
+    size_t dst = 0;
+    while (dst < pixelCount) {
+        size_t run = 1;
+        bool repeat = false;
+        if (rle) {
+            if (src >= bytes.size())
+                break;
+            const unsigned char header = bytes[src++];
+            run = (header & 0x7f) + 1u;
+            repeat = (header & 0x80) != 0;
+        }
+        run = std::min(run, pixelCount - dst);
+        if (repeat) {
+            if (!readPixel(dst))
+                break;
+            src += channels;
+            for (size_t i = 1; i < run; ++i)
+                std::memcpy(&out.pixels[(dst + i) * 4], &out.pixels[dst * 4], 4);
+            dst += run;
+        } else {
+            size_t i = 0;
+            for (; i < run && readPixel(dst + i); ++i)
+                src += channels;
+            dst += i;
+            if (i < run)
+                break;
+        }
+    }
+    if (dst < pixelCount) {
+        error = "truncated TGA pixel data";
+        return false;
+    }
+    if (topDown)
+        flipRows(out);
+    return true;
+}
+
+static bool decodePNM(const std::vector<unsigned char>& bytes, Image& out, std::string& error) {
+    const bool color = bytes[1] == '6';
+    size_t pos = 2;
+    int fields[3] = {};
+    for (int& field : fields) {
+        // Skip whitespace and '#' comments between header fields
+        while (pos < bytes.size()) {
+            if (bytes[pos] == '#') {
+                while (pos < bytes.size() && bytes[pos] != '\n')
+                    ++pos;
+            } else if (std::isspace(bytes[pos])) {
+                ++pos;
+            } else {
+                break;
+            }
+        }
+        while (pos < bytes.size() && std::isdigit(bytes[pos]))
+            field = field * 10 + (bytes[pos++] - '0');
+    }
+    ++pos; // single whitespace byte before the raster
+
+    const int width = fields[0], height = fields[1], maxValue = fields[2];
+    const int channels = color ? 3 : 1;
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 255) {
+        error = "unsupported PNM header";
+        return false;
+    }
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    if (pos + pixelCount * channels > bytes.size()) {
+        error = "truncated PNM pixel data";
+        return false;
+    }
+
+    out.width = width;
+    out.height = height;
+    out.pixels.assign(pixelCount * 4, 255);
+    for (size_t i = 0; i < pixelCount; ++i) {
+        const unsigned char* p = &bytes[pos + i * channels];
+        for (int c = 0; c < 3; ++c)
+            out.pixels[i * 4 + c] = static_cast<unsigned char>(p[color ? c : 0] * 255 / maxValue);
+    }
+    flipRows(out); // PNM rows are stored top-down
+    return true;
+}
+
+bool decodeImage(const std::vector<unsigned char>& bytes, Image& out, std::string& error) {
+    if (bytes.size() >= 2 && bytes[0] == 'P' && (bytes[1] == '5' || bytes[1] == '6'))
+        return decodePNM(bytes, out, error);
+
+#ifdef SHADERVIEWER_HAS_STB_IMAGE
+    int width = 0, height = 0, channels = 0;
+    stbi_set_flip_vertically_on_load_thread(1);
+    unsigned char* data = stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()),
+                                                &width, &height, &channels, 4);
+    if (data) {
+        out.width = width;
+        out.height = height;
+        out.pixels.assign(data, data + static_cast<size_t>(width) * height * 4);
+        stbi_image_free(data);
+        return true;
+    }
+#endif
+
+    // TGA has no magic number, so it is the last resort
+    return decodeTGA(bytes, out, error);
+}
+
+std::vector<Image> buildMipChain(Image base) {
+    std::vector<Image> levels;
+    levels.push_back(std::move(base));
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Image& src = levels.back();
+        Image dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+        for (int y = 0; y < dst.height; ++y) {
+            const int y0 = std::min(y * 2, src.height - 1);
+            const int y1 = std::min(y * 2 + 1, src.height - 1);
+            for (int x = 0; x < dst.width; ++x) {
+                const int x0 = std::min(x * 2, src.width - 1);
+                const int x1 = std::min(x * 2 + 1, src.width - 1);
+                for (int c = 0; c < 4; ++c) {
+                    const int sum = src.pixels[(y0 * src.width + x0) * 4 + c] +
+                                    src.pixels[(y0 * src.width + x1) * 4 + c] +
+                                    src.pixels[(y1 * src.width + x0) * 4 + c] +
+                                    src.pixels[(y1 * src.width + x1) * 4 + c];
+                    dst.pixels[(y * dst.width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        levels.push_back(std::move(dst));
+    }
+    return levels;
+}
+
+namespace {
+
+uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t adler32(const unsigned char* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        const size_t chunk = std::min<size_t>(size, 5552); // no overflow before the modulo
+        for (size_t i = 0; i < chunk; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += chunk;
+        size -= chunk;
+    }
+    return (b << 16) | a;
+}
+
+// LSB-first bit packing as deflate expects
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : m_Out(out) {}
+
+    void bits(uint32_t value, int count) {
+        m_Buffer |= static_cast<uint64_t>(value) << m_Count;
+        m_Count += count;
+        while (m_Count >= 8) {
+            m_Out.push_back(static_cast<unsigned char>(m_Buffer));
+            m_Buffer >>= 8;
+            m_Count -= 8;
+        }
+    }
+
+    // Huffman codes are defined MSB-first
+    void code(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i)
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        bits(reversed, length);
+    }
+
+    void flush() {
+        if (m_Count > 0)
+            bits(0, 8 - m_Count);
+    }
+
+private:
+    std::vector<unsigned char>& m_Out;
+    uint64_t m_Buffer = 0;
+    int m_Count = 0;
+};
+
+void writeLiteralLength(BitWriter& writer, int symbol) {
+    if (symbol < 144)
+        writer.code(0x30 + symbol, 8);
+    else if (symbol < 256)
+        writer.code(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        writer.code(symbol - 256, 7);
+    else
+        writer.code(0xC0 + symbol - 280, 8);
+}
+
+void writeMatch(BitWriter& writer, int length, int distance) {
+    static const int lengthBase[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                     31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const int lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const int distanceBase[] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                       193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static const int distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    int l = 28;
+    while (lengthBase[l] > length)
+        --l;
+    writeLiteralLength(writer, 257 + l);
+    writer.bits(length - lengthBase[l], lengthExtra[l]);
+
+    int d = 29;
+    while (distanceBase[d] > distance)
+        --d;
+    writer.code(d, 5);
+    writer.bits(distance - distanceBase[d], distanceExtra[d]);
+}
+
+// zlib stream with one fixed-Huffman block; greedy LZ77 over hash chains
+void deflateFixed(const std::vector<unsigned char>& data, std::vector<unsigned char>& out) {
+    constexpr int kWindow = 32768, kMaxMatch = 258, kMaxChain = 32;
+    constexpr int kHashBits = 15;
+
+    out.push_back(0x78); // 32K window, deflate
+    out.push_back(0x01);
+    BitWriter writer(out);
+    writer.bits(1, 1); // final block
+    writer.bits(1, 2); // fixed Huffman
+
+    const int size = static_cast<int>(data.size());
+    std::vector<int> head(1 << kHashBits, -1), previous(kWindow, -1);
+    auto hashAt = [&](int i) {
+        const uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+        return (v * 2654435761u) >> (32 - kHashBits);
+    };
+    auto insert = [&](int i) {
+        if (i + 2 >= size)
+            return;
+        const uint32_t h = hashAt(i);
+        previous[i & (kWindow - 1)] = head[h];
+        head[h] = i;
+    };
+
+    for (int i = 0; i < size;) {
+        int bestLength = 0, bestDistance = 0;
+        if (i + 2 < size) {
+            const int limit = std::min(kMaxMatch, size - i);
+            int candidate = head[hashAt(i)];
+            for (int chain = 0; candidate >= 0 && i - candidate <= kWindow - 1 && chain < kMaxChain; ++chain) {
+                int length = 0;
+                while (length < limit && data[candidate + length] == data[i + length])
+                    ++length;
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = i - candidate;
+                    if (length == limit)
+                        break;
+                }
+                candidate = previous[candidate & (kWindow - 1)];
+            }
+        }
+        if (bestLength >= 3) {
+            writeMatch(writer, bestLength, bestDistance);
+            for (int k = 0; k < bestLength; ++k)
+                insert(i + k);
+            i += bestLength;
+        } else {
+            writeLiteralLength(writer, data[i]);
+            insert(i);
+            ++i;
+        }
+    }
+    writeLiteralLength(writer, 256); // end of block
+    writer.flush();
+
+    const uint32_t adler = adler32(data.data(), data.size());
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back(static_cast<unsigned char>(adler >> shift));
+}
+
+void appendChunk(std::vector<unsigned char>& png, const char type[4], const std::vector<unsigned char>& data) {
+    const uint32_t length = static_cast<uint32_t>(data.size());
+    for (int shift = 24; shift >= 0; shift -= 8)
+        png.push_back(static_cast<unsigned char>(length >> shift));
+    const size_t typeStart = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    const uint32_t crc = crc32(&png[typeStart], png.size() - typeStart);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        png.push_back(static_cast<unsigned char>(crc >> shift));
+}
+
+int paeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+} // namespace
+
+void encodePNG(const Image& image, std::vector<unsigned char>& out) {
+    const int width = image.width, height = image.height;
+    const size_t rowBytes = static_cast<size_t>(width) * 3;
+
+    // Each row gets the filter with the smallest sum of absolute residuals,
+    // the usual heuristic from libpng
+    std::vector<unsigned char> filtered;
+    filtered.reserve((rowBytes + 1) * height);
+    std::vector<unsigned char> previous(rowBytes, 0), current(rowBytes), candidate(rowBytes), best(rowBytes);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* src = &image.pixels[static_cast<size_t>(height - 1 - y) * width * 4];
+        for (int x = 0; x < width; ++x)
+            std::memcpy(&current[x * 3], &src[x * 4], 3);
+
+        int bestFilter = 0;
+        long bestCost = -1;
+        for (int filter = 0; filter < 5; ++filter) {
+            long cost = 0;
+            for (size_t i = 0; i < rowBytes; ++i) {
+                const int a = i >= 3 ? current[i - 3] : 0, b = previous[i], c = i >= 3 ? previous[i - 3] : 0;
+                int predicted = 0;
+                switch (filter) {
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) / 2; break;
+                case 4: predicted = paeth(a, b, c); break;
+                }
+                candidate[i] = static_cast<unsigned char>(current[i] - predicted);
+                cost += std::abs(static_cast<signed char>(candidate[i]));
+            }
+            if (bestCost < 0 || cost < bestCost) {
+                bestCost = cost;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        filtered.push_back(static_cast<unsigned char>(bestFilter));
+        filtered.insert(filtered.end(), best.begin(), best.end());
+        previous.swap(current);
+    }
+
+    std::vector<unsigned char> header(13, 0);
+    for (int i = 0; i < 4; ++i) {
+        header[i] = static_cast<unsigned char>(width >> (24 - 8 * i));
+        header[4 + i] = static_cast<unsigned char>(height >> (24 - 8 * i));
+    }
+    header[8] = 8; // bit depth
+    header[9] = 2; // RGB
+
+    std::vector<unsigned char> compressed;
+    deflateFixed(filtered, compressed);
+
+    static const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.assign(std::begin(signature), std::end(signature));
+    appendChunk(out, "IHDR", header);
+    appendChunk(out, "IDAT", compressed);
+    appendChunk(out, "IEND", {});
+}
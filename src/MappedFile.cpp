@@ -0,0 +1,106 @@
+#include "MappedFile.h"
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    const void* data = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        std::cerr << "Failed to map " << path << std::endl;
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_File = file;
+    m_Mapping = mapping;
+    m_Data = static_cast<const unsigned char*>(data);
+    m_Size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping)
+        CloseHandle(m_Mapping);
+    if (m_File)
+        CloseHandle(m_File);
+    m_Data = nullptr;
+    m_Mapping = m_File = nullptr;
+    m_Size = 0;
+}
+
+void MappedFile::willNeed(size_t, size_t) const {}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); // the mapping keeps its own reference
+    if (data == MAP_FAILED) {
+        std::cerr << "Failed to map " << path << std::endl;
+        return false;
+    }
+    // Chunks are read in view order, not file order; read-ahead would only
+    // pull in pages nobody asked for
+    madvise(data, static_cast<size_t>(info.st_size), MADV_RANDOM);
+    m_Data = static_cast<const unsigned char*>(data);
+    m_Size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (m_Data)
+        munmap(const_cast<unsigned char*>(m_Data), m_Size);
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+void MappedFile::willNeed(size_t offset, size_t length) const {
+    if (!m_Data || offset >= m_Size)
+        return;
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t begin = offset / page * page;
+    const size_t end = std::min(offset + length, m_Size);
+    madvise(const_cast<unsigned char*>(m_Data) + begin, end - begin, MADV_WILLNEED);
+}
+
+#endif
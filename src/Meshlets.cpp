@@ -0,0 +1,319 @@
+#include "Meshlets.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace {
+
+const char kMagic[8] = {'S', 'V', 'M', 'S', 'H', 'L', 'T', '1'};
+
+struct CacheHeader {
+    char magic[8];
+    uint64_t sourceHash;
+    uint64_t floatCount;
+    uint64_t meshletCount;
+};
+
+// Fixed on-disk layout, independent of Meshlet's padding
+struct CachedMeshlet {
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+    int32_t first;
+    int32_t count;
+    uint32_t material;
+};
+
+glm::vec3 positionOf(const std::vector<float>& vertices, size_t stride, size_t vertex) {
+    const float* p = &vertices[vertex * stride];
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+void computeBounds(Meshlet& meshlet, const std::vector<float>& vertices, size_t stride) {
+    const size_t begin = meshlet.first, end = begin + meshlet.count;
+
+    // Sphere around the box center: cheap and tight enough for clusters
+    glm::vec3 lo(1e30f), hi(-1e30f);
+    for (size_t v = begin; v < end; ++v) {
+        const glm::vec3 p = positionOf(vertices, stride, v);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    meshlet.center = (lo + hi) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (size_t v = begin; v < end; ++v)
+        meshlet.radius = std::max(meshlet.radius, glm::length(positionOf(vertices, stride, v) - meshlet.center));
+
+    // Normal cone from the face normals (not the shading normals, which
+    // say nothing about winding)
+    std::vector<glm::vec3> normals;
+    glm::vec3 sum(0.0f);
+    for (size_t v = begin; v + 2 < end; v += 3) {
+        const glm::vec3 p0 = positionOf(vertices, stride, v);
+        const glm::vec3 n = glm::cross(positionOf(vertices, stride, v + 1) - p0, positionOf(vertices, stride, v + 2) - p0);
+        const float area = glm::length(n);
+        if (area <= 1e-12f)
+            continue;
+        normals.push_back(n / area);
+        sum += n; // area weighted
+    }
+    const float length = glm::length(sum);
+    meshlet.coneCutoff = 1.0f;
+    if (normals.empty() || length <= 1e-12f)
+        return;
+    meshlet.coneAxis = sum / length;
+    float minDot = 1.0f;
+    for (const auto& n : normals)
+        minDot = std::min(minDot, glm::dot(n, meshlet.coneAxis));
+    // A cone of 90 degrees or wider can always be seen from the front
+    if (minDot > 0.0f)
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+} // namespace
+
+namespace Meshlets {
+
+std::vector<Meshlet> build(std::vector<float>& vertices, size_t stride, GLint first, GLsizei count,
+                           uint32_t material) {
+    std::vector<Meshlet> meshlets;
+    const size_t triangleCount = static_cast<size_t>(count) / 3;
+    if (triangleCount == 0)
+        return meshlets;
+
+    // Index the vertices: identical attribute tuples share an index, which
+    // is what the vertex limit counts and what adjacency is built from
+    std::vector<uint32_t> indices(triangleCount * 3);
+    uint32_t uniqueCount = 0;
+    {
+        std::unordered_map<uint64_t, uint32_t> seen;
+        std::vector<size_t> firstUse;
+        for (size_t i = 0; i < indices.size(); ++i) {
+            const float* vertex = &vertices[(first + i) * stride];
+            const uint64_t key = hashBytes(vertex, stride * sizeof(float));
+            auto found = seen.find(key);
+            if (found != seen.end() &&
+                std::memcmp(vertex, &vertices[firstUse[found->second] * stride], stride * sizeof(float)) == 0) {
+                indices[i] = found->second;
+                continue;
+            }
+            // A hash collision with different data just stays unshared
+            if (found == seen.end())
+                seen.emplace(key, uniqueCount);
+            firstUse.push_back(first + i);
+            indices[i] = uniqueCount++;
+        }
+    }
+
+    // Vertex -> triangles adjacency, CSR style
+    std::vector<uint32_t> adjacencyStart(uniqueCount + 1, 0), adjacency(indices.size());
+    for (uint32_t index : indices)
+        ++adjacencyStart[index + 1];
+    for (uint32_t v = 0; v < uniqueCount; ++v)
+        adjacencyStart[v + 1] += adjacencyStart[v];
+    {
+        std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        centroids[t] = (positionOf(vertices, stride, first + 3 * t) + positionOf(vertices, stride, first + 3 * t + 1) +
+                        positionOf(vertices, stride, first + 3 * t + 2)) / 3.0f;
+    }
+
+    std::vector<char> used(triangleCount, 0);
+    std::vector<uint32_t> vertexStamp(uniqueCount, UINT32_MAX); // meshlet that holds the vertex
+    std::vector<uint32_t> order;                                 // triangles, meshlet by meshlet
+    order.reserve(triangleCount);
+    std::vector<uint32_t> candidates;
+    size_t seedCursor = 0;
+
+    for (uint32_t meshletIndex = 0; order.size() < triangleCount; ++meshletIndex) {
+        // Continue next to the previous cluster when possible, for locality
+        uint32_t seed = UINT32_MAX;
+        for (uint32_t candidate : candidates) {
+            if (!used[candidate]) {
+                seed = candidate;
+                break;
+            }
+        }
+        if (seed == UINT32_MAX) {
+            while (used[seedCursor])
+                ++seedCursor;
+            seed = static_cast<uint32_t>(seedCursor);
+        }
+        candidates.clear();
+
+        const size_t start = order.size();
+        size_t vertexCount = 0;
+        glm::vec3 centroidSum(0.0f);
+        auto add = [&](uint32_t triangle) {
+            used[triangle] = 1;
+            order.push_back(triangle);
+            centroidSum += centroids[triangle];
+            for (int corner = 0; corner < 3; ++corner) {
+                const uint32_t v = indices[3 * triangle + corner];
+                if (vertexStamp[v] == meshletIndex)
+                    continue;
+                vertexStamp[v] = meshletIndex;
+                ++vertexCount;
+                for (uint32_t a = adjacencyStart[v]; a < adjacencyStart[v + 1]; ++a) {
+                    if (!used[adjacency[a]])
+                        candidates.push_back(adjacency[a]);
+                }
+            }
+        };
+        add(seed);
+
+        while (order.size() - start < MaxTriangles) {
+            const glm::vec3 center = centroidSum / static_cast<float>(order.size() - start);
+            size_t best = SIZE_MAX;
+            int bestNew = 4;
+            float bestDistance = 0.0f;
+            for (size_t c = 0; c < candidates.size();) {
+                const uint32_t triangle = candidates[c];
+                if (used[triangle]) {
+                    candidates[c] = candidates.back(); // drop stale entries as we go
+                    candidates.pop_back();
+                    continue;
+                }
+                int added = 0;
+                for (int corner = 0; corner < 3; ++corner)
+                    added += vertexStamp[indices[3 * triangle + corner]] != meshletIndex;
+                if (vertexCount + added <= MaxVertices) {
+                    const glm::vec3 offset = centroids[triangle] - center;
+                    const float distance = glm::dot(offset, offset);
+                    if (added < bestNew || (added == bestNew && distance < bestDistance)) {
+                        best = c;
+                        bestNew = added;
+                        bestDistance = distance;
+                    }
+                }
+                ++c;
+            }
+            if (best == SIZE_MAX)
+                break;
+            add(candidates[best]);
+        }
+
+        Meshlet meshlet;
+        meshlet.first = first + static_cast<GLint>(start * 3);
+        meshlet.count = static_cast<GLsizei>((order.size() - start) * 3);
+        meshlet.material = material;
+        meshlets.push_back(meshlet);
+    }
+
+    // Rewrite the range in cluster order
+    std::vector<float> reordered(static_cast<size_t>(count) * stride);
+    for (size_t i = 0; i < order.size(); ++i) {
+        std::memcpy(&reordered[i * 3 * stride], &vertices[(first + order[i] * 3) * stride], 3 * stride * sizeof(float));
+    }
+    std::copy(reordered.begin(), reordered.end(), vertices.begin() + static_cast<size_t>(first) * stride);
+
+    for (auto& meshlet : meshlets)
+        computeBounds(meshlet, vertices, stride);
+    return meshlets;
+}
+
+bool writeCache(const std::string& path, uint64_t sourceHash, const std::vector<float>& vertices,
+                const std::vector<Meshlet>& meshlets) {
+    CacheHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.sourceHash = sourceHash;
+    header.floatCount = vertices.size();
+    header.meshletCount = meshlets.size();
+
+    std::vector<CachedMeshlet> cached(meshlets.size());
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        const Meshlet& m = meshlets[i];
+        cached[i] = {{m.center.x, m.center.y, m.center.z}, m.radius,
+                     {m.coneAxis.x, m.coneAxis.y, m.coneAxis.z}, m.coneCutoff,
+                     m.first, m.count, m.material};
+    }
+
+    // Write to a temporary name so concurrent viewers never see partial files
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(float));
+        file.write(reinterpret_cast<const char*>(cached.data()), cached.size() * sizeof(CachedMeshlet));
+        if (!file)
+            return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool readCache(const std::string& path, uint64_t sourceHash, std::vector<float>& vertices,
+               std::vector<Meshlet>& meshlets) {
+    std::ifstream file(path, std::ios::binary);
+    CacheHeader header;
+    if (!file || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.sourceHash != sourceHash)
+        return false;
+
+    std::vector<float> cachedVertices(header.floatCount);
+    std::vector<CachedMeshlet> cached(header.meshletCount);
+    if (!file.read(reinterpret_cast<char*>(cachedVertices.data()), cachedVertices.size() * sizeof(float)) ||
+        !file.read(reinterpret_cast<char*>(cached.data()), cached.size() * sizeof(CachedMeshlet)))
+        return false;
+
+    meshlets.resize(cached.size());
+    for (size_t i = 0; i < cached.size(); ++i) {
+        const CachedMeshlet& c = cached[i];
+        Meshlet& m = meshlets[i];
+        m.center = glm::vec3(c.center[0], c.center[1], c.center[2]);
+        m.radius = c.radius;
+        m.coneAxis = glm::vec3(c.coneAxis[0], c.coneAxis[1], c.coneAxis[2]);
+        m.coneCutoff = c.coneCutoff;
+        m.first = c.first;
+        m.count = c.count;
+        m.material = c.material;
+    }
+    vertices = std::move(cachedVertices);
+    return true;
+}
+
+void extractFrustum(const glm::mat4& m, glm::vec4 planes[6]) {
+    // Gribb/Hartmann: planes are sums/differences of the matrix rows
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+    for (int i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+bool isOutside(const Meshlet& meshlet, const glm::vec4 planes[6]) {
+    for (int i = 0; i < 6; ++i) {
+        if (glm::dot(glm::vec3(planes[i]), meshlet.center) + planes[i].w < -meshlet.radius)
+            return true;
+    }
+    return false;
+}
+
+bool isBackFacing(const Meshlet& meshlet, const glm::vec3& cameraPosition) {
+    // Every face normal is within the cone; if the whole bounding sphere is
+    // seen from behind all of them, so is every triangle
+    const glm::vec3 toCenter = meshlet.center - cameraPosition;
+    return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
+
+} // namespace Meshlets
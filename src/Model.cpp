@@ -7,11 +7,12 @@ Model::Model() {
         -0.5f, -0.5f, 0.0f,  0.0f, 1.0f, 0.0f, // left (green)
          0.5f, -0.5f, 0.0f,  0.0f, 0.0f, 1.0f  // right (blue)
     };
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    VAO.create("Model", GL_HERE);
+    VBO.create("Model vertices", GL_HERE);
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    VBO.setBytes(sizeof(vertices));
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
@@ -20,10 +21,7 @@ Model::Model() {
     glBindVertexArray(0);
 }
 
-Model::~Model() {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-}
+Model::~Model() = default;
 
 void Model::draw() const {
     glBindVertexArray(VAO);
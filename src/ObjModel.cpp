@@ -1,18 +1,32 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 #include "ObjModel.h"
+#include "Hash.h"
+#include "PointCloud.h"
+#include "Shader.h"
+#include "SoftwareRasterizer.h"
+#include "Texture.h"
+#include "VertexLayout.h"
 #include <vector>
+#include <unordered_map>
 #include <iostream>
+#include <filesystem>
 #include <cfloat> // for FLT_MAX
 #include <algorithm> // for std::min/std::max
+#include <cstdio>
 
-ObjModel::ObjModel(const std::string& path) {
+ObjModel::ObjModel(const std::string& path, TextureCache* textures, const std::string& meshCacheDir,
+                   Storage storage) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
+    std::vector<tinyobj::material_t> objMaterials;
     std::string warn, err;
 
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str());
+    // MTL files and the textures they name are relative to the OBJ
+    const std::string baseDir = std::filesystem::path(path).parent_path().string();
+    // No default vertex colors: attrib.colors stays empty unless the file has them
+    bool ret = tinyobj::LoadObj(&attrib, &shapes, &objMaterials, &warn, &err, path.c_str(), baseDir.c_str(),
+                                /*triangulate=*/true, /*default_vcols_fallback=*/false);
     if (!warn.empty()) std::cout << "TinyObjLoader warning: " << warn << std::endl;
     if (!err.empty()) std::cerr << "TinyObjLoader error: " << err << std::endl;
     if (!ret) {
@@ -47,9 +61,58 @@ ObjModel::ObjModel(const std::string& path) {
     float midZ = (minZ + maxZ) * 0.5f;
 
     const float scale = 0.5f;
+    if (!attrib.vertices.empty()) {
+        boundsMin = glm::vec3(minX - midX, minY - midY, minZ - midZ) * scale;
+        boundsMax = glm::vec3(maxX - midX, maxY - midY, maxZ - midZ) * scale;
+    }
+
+    // No faces at all (a scan): draw the vertices themselves as points
+    size_t indexCount = 0;
+    for (const auto& shape : shapes)
+        indexCount += shape.mesh.indices.size();
+    if (indexCount == 0 && !attrib.vertices.empty()) {
+        if (storage == Storage::CPU) {
+            std::cerr << "Point clouds need GPU storage: " << path << std::endl;
+            return;
+        }
+        const float mid[3] = {midX, midY, midZ};
+        std::vector<float> positions(attrib.vertices.size());
+        for (size_t i = 0; i < positions.size(); ++i)
+            positions[i] = (attrib.vertices[i] - mid[i % 3]) * scale;
+        points = std::make_unique<PointCloud>(positions, attrib.colors, path);
+        return;
+    }
+
+    // One material per MTL entry plus a trailing default for faces without one
+    std::unordered_map<std::string, std::shared_ptr<SoftwareTexture>> softwareMaps;
+    for (const auto& objMaterial : objMaterials) {
+        Material material;
+        material.diffuseColor = glm::vec3(objMaterial.diffuse[0], objMaterial.diffuse[1], objMaterial.diffuse[2]);
+        if (!objMaterial.diffuse_texname.empty()) {
+            const std::string texturePath = (std::filesystem::path(baseDir) / objMaterial.diffuse_texname).string();
+            if (storage == Storage::CPU) {
+                auto found = softwareMaps.find(texturePath);
+                if (found == softwareMaps.end())
+                    found = softwareMaps.emplace(texturePath, SoftwareTexture::load(texturePath)).first;
+                material.softwareMap = found->second;
+            } else if (textures) {
+                material.diffuseMap = textures->acquire(texturePath);
+            }
+        }
+        materials.push_back(material);
+    }
+    materials.push_back(Material());
+
+    // Bucket vertices by material so each material is a single draw range
+    std::vector<std::vector<float>> buckets(materials.size());
 
     for (const auto& shape : shapes) {
-        for (const auto& idx : shape.mesh.indices) {
+        for (size_t i = 0; i < shape.mesh.indices.size(); ++i) {
+            const auto& idx = shape.mesh.indices[i];
+            int materialId = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[i / 3];
+            if (materialId < 0 || materialId >= static_cast<int>(objMaterials.size()))
+                materialId = static_cast<int>(objMaterials.size());
+
             float x = attrib.vertices[3 * idx.vertex_index + 0];
             float y = attrib.vertices[3 * idx.vertex_index + 1];
             float z = attrib.vertices[3 * idx.vertex_index + 2];
@@ -61,44 +124,233 @@ ObjModel::ObjModel(const std::string& path) {
                 nz = attrib.normals[3 * idx.normal_index + 2];
             }
 
-            // Interleaved: [position | normal]
-            vertices.push_back((x - midX) * scale);
-            vertices.push_back((y - midY) * scale);
-            vertices.push_back((z - midZ) * scale);
-            vertices.push_back(nx);
-            vertices.push_back(ny);
-            vertices.push_back(nz);
+            float u = 0, v = 0;
+            if (idx.texcoord_index >= 0) {
+                u = attrib.texcoords[2 * idx.texcoord_index + 0];
+                v = attrib.texcoords[2 * idx.texcoord_index + 1];
+            }
+
+            // Interleaved: [position | normal | texcoord]
+            auto& bucket = buckets[materialId];
+            bucket.push_back((x - midX) * scale);
+            bucket.push_back((y - midY) * scale);
+            bucket.push_back((z - midZ) * scale);
+            bucket.push_back(nx);
+            bucket.push_back(ny);
+            bucket.push_back(nz);
+            bucket.push_back(u);
+            bucket.push_back(v);
         }
     }
 
-    vertexCount = static_cast<GLsizei>(vertices.size() / 6);
+    for (size_t m = 0; m < buckets.size(); ++m) {
+        if (buckets[m].empty())
+            continue;
+        ranges.push_back({static_cast<GLint>(vertices.size() / 8), static_cast<GLsizei>(buckets[m].size() / 8), m});
+        vertices.insert(vertices.end(), buckets[m].begin(), buckets[m].end());
+    }
+
+    vertexCount = static_cast<GLsizei>(vertices.size() / 8);
     std::cout << "Loaded OBJ vertex count: " << vertexCount << std::endl;
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    buildMeshlets(vertices, meshCacheDir);
+
+    if (storage == Storage::CPU) {
+        cpuVertices = std::move(vertices);
+        return;
+    }
+
+    VAO.create(path, GL_HERE);
+    VBO.create(path + " vertices", GL_HERE);
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    VBO.setBytes(vertices.size() * sizeof(float));
 
     // layout(location = 0) -> position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(VertexLayout::Position, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(VertexLayout::Position);
 
     // layout(location = 1) -> normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(VertexLayout::Normal, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(VertexLayout::Normal);
+
+    // layout(location = 2) -> texcoord
+    glVertexAttribPointer(VertexLayout::TexCoord, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    glEnableVertexAttribArray(VertexLayout::TexCoord);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+ObjModel::~ObjModel() = default;
+
+bool ObjModel::hasTextures() const {
+    for (const auto& material : materials) {
+        if (material.diffuseMap || material.softwareMap)
+            return true;
+    }
+    return false;
+}
+
+void ObjModel::buildMeshlets(std::vector<float>& vertices, const std::string& cacheDir) {
+    // Keyed by the unclustered vertex data and how it is split by material
+    uint64_t key = hashBytes(vertices.data(), vertices.size() * sizeof(float));
+    for (const auto& range : ranges)
+        key = hashBytes(&range.count, sizeof(range.count), hashBytes(&range.first, sizeof(range.first), key));
+    const size_t limits[] = {Meshlets::MaxVertices, Meshlets::MaxTriangles};
+    key = hashBytes(limits, sizeof(limits), key);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.meshlets", static_cast<unsigned long long>(key));
+    const std::string cachePath = cacheDir.empty() ? "" : (std::filesystem::path(cacheDir) / name).string();
+
+    std::vector<float> clustered;
+    if (!cachePath.empty() && Meshlets::readCache(cachePath, key, clustered, meshlets) &&
+        clustered.size() == vertices.size()) {
+        vertices = std::move(clustered);
+        std::cout << "Loaded " << meshlets.size() << " meshlets from " << cachePath << std::endl;
+        return;
+    }
+
+    meshlets.clear();
+    for (const auto& range : ranges) {
+        auto built = Meshlets::build(vertices, 8, range.first, range.count, static_cast<uint32_t>(range.material));
+        meshlets.insert(meshlets.end(), built.begin(), built.end());
+    }
+    std::cout << "Built " << meshlets.size() << " meshlets" << std::endl;
+
+    if (!cachePath.empty()) {
+        std::error_code ignored;
+        std::filesystem::create_directories(cacheDir, ignored);
+        if (!Meshlets::writeCache(cachePath, key, vertices, meshlets))
+            std::cerr << "Failed to write meshlet cache " << cachePath << std::endl;
+    }
+}
+
+void ObjModel::bindMaterial(const Shader& shader, const Material& material) const {
+    GLuint texture = material.diffuseMap ? material.diffuseMap->id() : 0;
+
+    // Until its first mip level is uploaded a texture draws untextured
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    shader.setInt("hasDiffuseMap", texture != 0);
+    shader.setVec3("diffuseColor", &material.diffuseColor.x);
+}
+
+void ObjModel::draw(const Shader& shader) const {
+    if (points) {
+        points->draw(shader);
+        return;
+    }
+    glBindVertexArray(VAO);
+    shader.setInt("diffuseMap", 0);
+    for (const auto& range : ranges) {
+        bindMaterial(shader, materials[range.material]);
+        glDrawArrays(GL_TRIANGLES, range.first, range.count);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+}
+
+void ObjModel::draw(SoftwareRasterizer& target) const {
+    for (const auto& range : ranges) {
+        const Material& material = materials[range.material];
+        if (static_cast<size_t>(range.first + range.count) * 8 > cpuVertices.size())
+            continue; // GPU storage
+        target.drawTriangles(cpuVertices.data() + static_cast<size_t>(range.first) * 8, range.count,
+                             {material.diffuseColor, material.softwareMap.get()});
+    }
+}
+
+void ObjModel::drawInstanced(const Shader& shader, GLuint buffer, GLintptr offset, GLsizei instances) const {
+    if (points || instances <= 0)
+        return;
+    glBindVertexArray(VAO);
 
+    // The offset moves every frame with the ring buffer, so the instance
+    // attributes are pointed at it per draw rather than once at load
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (GLuint column = 0; column < 4; ++column) {
+        const GLuint location = VertexLayout::InstanceModel + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader.setInt("diffuseMap", 0);
+    for (const auto& range : ranges) {
+        bindMaterial(shader, materials[range.material]);
+        glDrawArraysInstanced(GL_TRIANGLES, range.first, range.count, instances);
+    }
+
+    for (GLuint column = 0; column < 4; ++column)
+        glDisableVertexAttribArray(VertexLayout::InstanceModel + column);
+    glBindTexture(GL_TEXTURE_2D, 0);
     glBindVertexArray(0);
 }
 
-ObjModel::~ObjModel() {
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+void ObjModel::drawCulled(const Shader& shader, const glm::mat4& model, const glm::mat4& viewProjection,
+                          const glm::vec3& cameraPosition, Meshlets::Stats& stats) const {
+    if (points) {
+        points->draw(shader);
+        return;
+    }
+
+    // Both tests run in model space: the frustum planes come from the full
+    // MVP and the camera is brought into the model's frame
+    glm::vec4 planes[6];
+    Meshlets::extractFrustum(viewProjection * model, planes);
+    const glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+    // Whole back-facing meshlets are dropped, so the back-facing triangles
+    // of partly visible ones have to go too, or open meshes would show
+    // their inside in patches
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glBindVertexArray(VAO);
+    shader.setInt("diffuseMap", 0);
+    for (size_t i = 0; i < meshlets.size();) {
+        const uint32_t material = meshlets[i].material;
+        drawFirsts.clear();
+        drawCounts.clear();
+        for (; i < meshlets.size() && meshlets[i].material == material; ++i) {
+            const Meshlet& meshlet = meshlets[i];
+            ++stats.total;
+            if (Meshlets::isOutside(meshlet, planes)) {
+                ++stats.outside;
+                continue;
+            }
+            if (Meshlets::isBackFacing(meshlet, camera)) {
+                ++stats.backFacing;
+                continue;
+            }
+            // Neighbouring survivors are contiguous in the buffer; merge them
+            if (!drawCounts.empty() && drawFirsts.back() + drawCounts.back() == meshlet.first) {
+                drawCounts.back() += meshlet.count;
+            } else {
+                drawFirsts.push_back(meshlet.first);
+                drawCounts.push_back(meshlet.count);
+            }
+        }
+        if (drawFirsts.empty())
+            continue;
+        bindMaterial(shader, materials[material]);
+        glMultiDrawArrays(GL_TRIANGLES, drawFirsts.data(), drawCounts.data(), static_cast<GLsizei>(drawFirsts.size()));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glDisable(GL_CULL_FACE);
 }
 
-void ObjModel::draw() const {
+void ObjModel::drawGeometry() const {
+    if (points) {
+        points->drawGeometry();
+        return;
+    }
     glBindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, vertexCount);
     glBindVertexArray(0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,366 @@
+#include "OcclusionCuller.h"
+#include "ShaderWatcher.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// The GPU reduces down to about this width; the rest happens on the CPU
+static constexpr int kReadbackWidth = 128;
+
+static int mipSize(int size, int level) {
+    return std::max(1, size >> level);
+}
+
+OcclusionCuller::OcclusionCuller(int width, ShaderWatcher* watcher) :
+m_Watcher(watcher),
+m_DepthShader(std::make_unique<Shader>("shaders/depth.vert", "shaders/depth.frag")),
+m_ReduceShader(std::make_unique<Shader>("shaders/hiz.vert", "shaders/hiz.frag")),
+m_MaxWidth(std::max(width, 1))
+{
+    m_EmptyVAO.create("OcclusionCuller fullscreen", GL_HERE);
+    for (auto& readback : m_Readbacks)
+        readback.buffer.create("OcclusionCuller readback", GL_HERE);
+    if (m_Watcher) {
+        m_Watcher->watch(*m_DepthShader);
+        m_Watcher->watch(*m_ReduceShader);
+    }
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    if (m_Watcher) {
+        m_Watcher->unwatch(*m_DepthShader);
+        m_Watcher->unwatch(*m_ReduceShader);
+    }
+    discardReadbacks();
+    release();
+}
+
+void OcclusionCuller::release() {
+    m_Framebuffer.reset();
+    m_DepthTexture.reset();
+    m_Width = m_Height = 0;
+    m_HasPyramid = false;
+}
+
+void OcclusionCuller::discardReadbacks() {
+    for (auto& readback : m_Readbacks) {
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+    }
+}
+
+void OcclusionCuller::allocate(int width, int height) {
+    m_Width = width;
+    m_Height = height;
+
+    // GPU levels stop at the one that is read back
+    m_ReadbackLevel = 0;
+    while (mipSize(width, m_ReadbackLevel) > kReadbackWidth)
+        ++m_ReadbackLevel;
+    m_LevelCount = m_ReadbackLevel + 1;
+
+    m_DepthTexture.create("OcclusionCuller Hi-Z", GL_HERE);
+    glBindTexture(GL_TEXTURE_2D, m_DepthTexture);
+    size_t bytes = 0;
+    for (int level = 0; level < m_LevelCount; ++level) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_DEPTH_COMPONENT32F, mipSize(width, level), mipSize(height, level), 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        bytes += static_cast<size_t>(mipSize(width, level)) * mipSize(height, level) * 4;
+    }
+    m_DepthTexture.setBytes(bytes);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_LevelCount - 1);
+
+    m_Framebuffer.create("OcclusionCuller", GL_HERE);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_DepthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Occlusion depth framebuffer incomplete; occlusion culling disabled" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        release();
+        m_OcclusionEnabled = false;
+        return;
+    }
+
+    // CPU levels from the read-back one down to 1x1
+    m_Levels.clear();
+    int levelWidth = mipSize(width, m_ReadbackLevel), levelHeight = mipSize(height, m_ReadbackLevel);
+    for (;;) {
+        Level level;
+        level.width = levelWidth;
+        level.height = levelHeight;
+        level.depth.resize(static_cast<size_t>(levelWidth) * levelHeight);
+        m_Levels.push_back(std::move(level));
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+}
+
+void OcclusionCuller::buildPyramid() {
+    // Each pass samples level-1 (the only level the texture exposes while
+    // rendering into `level`, so there is no feedback loop) and writes the
+    // farthest depth of each 2x2 block through gl_FragDepth
+    glDepthFunc(GL_ALWAYS);
+    m_ReduceShader->use();
+    m_ReduceShader->setInt("depth", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_DepthTexture);
+    glBindVertexArray(m_EmptyVAO);
+    for (int level = 1; level < m_LevelCount; ++level) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_DepthTexture, level);
+        glViewport(0, 0, mipSize(m_Width, level), mipSize(m_Height, level));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBindVertexArray(0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_LevelCount - 1);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_DepthTexture, 0);
+    glDepthFunc(GL_LESS);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void OcclusionCuller::readBack(const glm::mat4& viewProjection) {
+    // Skipped while the slot's previous readback is still in flight
+    Readback& readback = m_Readbacks[m_NextReadback];
+    if (readback.fence)
+        return;
+    m_NextReadback = (m_NextReadback + 1) % m_Readbacks.size();
+
+    const Level& level = m_Levels[0];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (readback.width != level.width || readback.height != level.height) {
+        const size_t size = level.depth.size() * sizeof(float);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        readback.buffer.setBytes(size);
+        readback.width = level.width;
+        readback.height = level.height;
+    }
+    glBindTexture(GL_TEXTURE_2D, m_DepthTexture);
+    glGetTexImage(GL_TEXTURE_2D, m_ReadbackLevel, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.viewProjection = viewProjection;
+}
+
+void OcclusionCuller::collect() {
+    // Oldest first; fences signal in order, so the last one finished is the
+    // newest pyramid and the only one worth mapping
+    Readback* newest = nullptr;
+    for (size_t n = 0; n < m_Readbacks.size(); ++n) {
+        Readback& readback = m_Readbacks[(m_NextReadback + n) % m_Readbacks.size()];
+        if (!readback.fence || glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            continue;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        newest = &readback;
+    }
+    // Sizes differ only for readbacks issued before a resize
+    Level& level = m_Levels[0];
+    if (!newest || newest->width != level.width || newest->height != level.height)
+        return;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, newest->buffer);
+    const size_t size = level.depth.size() * sizeof(float);
+    if (const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT)) {
+        std::memcpy(level.depth.data(), data, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        reducePyramid();
+        m_PyramidViewProjection = newest->viewProjection;
+        m_HasPyramid = true;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void OcclusionCuller::reducePyramid() {
+    // Same reduction as hiz.frag: odd sizes fold the leftover row/column
+    // into the last texel
+    for (size_t i = 1; i < m_Levels.size(); ++i) {
+        const Level& src = m_Levels[i - 1];
+        Level& dst = m_Levels[i];
+        for (int y = 0; y < dst.height; ++y) {
+            const int y0 = std::min(2 * y, src.height - 1);
+            const int y1 = y == dst.height - 1 ? src.height - 1 : std::min(2 * y + 1, src.height - 1);
+            for (int x = 0; x < dst.width; ++x) {
+                const int x0 = std::min(2 * x, src.width - 1);
+                const int x1 = x == dst.width - 1 ? src.width - 1 : std::min(2 * x + 1, src.width - 1);
+                float farthest = 0.0f;
+                for (int sy = y0; sy <= y1; ++sy) {
+                    for (int sx = x0; sx <= x1; ++sx)
+                        farthest = std::max(farthest, src.depth[static_cast<size_t>(sy) * src.width + sx]);
+                }
+                dst.depth[static_cast<size_t>(y) * dst.width + x] = farthest;
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isOccluded(const glm::vec2& ndcMin, const glm::vec2& ndcMax, float nearestDepth) const {
+    // Texel rectangle at the full-resolution level
+    auto toTexel = [](float ndc, int size) {
+        return std::clamp(static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * size)), 0, size - 1);
+    };
+    int x0 = toTexel(ndcMin.x, m_Width), x1 = toTexel(ndcMax.x, m_Width);
+    int y0 = toTexel(ndcMin.y, m_Height), y1 = toTexel(ndcMax.y, m_Height);
+
+    // Halving indices (clamped to the last texel, which absorbs odd
+    // leftovers) follows the reduction exactly, so no texel is missed
+    auto halve = [](int& index, int size) { index = std::min(index / 2, size - 1); };
+    for (int level = 1; level <= m_ReadbackLevel; ++level) {
+        const int width = mipSize(m_Width, level), height = mipSize(m_Height, level);
+        halve(x0, width);
+        halve(x1, width);
+        halve(y0, height);
+        halve(y1, height);
+    }
+
+    // Coarsest level at which the rectangle still spans at most 2x2 texels
+    size_t index = 0;
+    while ((x1 - x0 > 1 || y1 - y0 > 1) && index + 1 < m_Levels.size()) {
+        ++index;
+        halve(x0, m_Levels[index].width);
+        halve(x1, m_Levels[index].width);
+        halve(y0, m_Levels[index].height);
+        halve(y1, m_Levels[index].height);
+    }
+
+    const Level& level = m_Levels[index];
+    float farthest = 0.0f;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x)
+            farthest = std::max(farthest, level.depth[static_cast<size_t>(y) * level.width + x]);
+    }
+    return nearestDepth > farthest;
+}
+
+void OcclusionCuller::cull(const std::vector<Object>& objects, const glm::mat4& view, const glm::mat4& projection,
+                           float aspect, const std::function<void(size_t)>& drawDepth, std::vector<char>& visible) {
+    const auto start = std::chrono::steady_clock::now();
+    m_Stats = Stats();
+    m_Stats.objects = objects.size();
+    visible.assign(objects.size(), 0);
+    if (m_Occluders.size() != objects.size())
+        m_Occluders.assign(objects.size(), 0); // first frame: nothing occludes
+
+    // A lone object has nothing to be hidden behind
+    bool occlusion = m_OcclusionEnabled && objects.size() > 1 && m_DepthShader->isReady() &&
+                     m_ReduceShader->isReady();
+    if (occlusion) {
+        const int width = m_MaxWidth;
+        const int height = std::max(1, static_cast<int>(std::lround(width / std::max(aspect, 1e-3f))));
+        if (width != m_Width || height != m_Height) {
+            release();
+            allocate(width, height);
+        }
+        occlusion = m_Framebuffer != 0;
+    }
+
+    if (occlusion) {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+        glViewport(0, 0, m_Width, m_Height);
+        glDepthMask(GL_TRUE);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        m_DepthShader->use();
+        m_DepthShader->setMat4("view", glm::value_ptr(view));
+        m_DepthShader->setMat4("projection", glm::value_ptr(projection));
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (!m_Occluders[i])
+                continue;
+            m_DepthShader->setMat4("model", glm::value_ptr(objects[i].model));
+            drawDepth(i);
+            ++m_Stats.occluders;
+        }
+        buildPyramid();
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        readBack(projection * view);
+        collect();
+    } else {
+        // Whatever is in flight would be stale once occlusion resumes
+        discardReadbacks();
+        m_HasPyramid = false;
+    }
+    occlusion = occlusion && m_HasPyramid;
+
+    const glm::mat4 viewProjection = projection * view;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const Object& object = objects[i];
+        const glm::mat4 mvp = viewProjection * object.model;
+
+        glm::vec4 clip[8];
+        bool behindNear = false;
+        for (int c = 0; c < 8; ++c) {
+            const glm::vec3 corner((c & 1) ? object.boundsMax.x : object.boundsMin.x,
+                                   (c & 2) ? object.boundsMax.y : object.boundsMin.y,
+                                   (c & 4) ? object.boundsMax.z : object.boundsMin.z);
+            clip[c] = mvp * glm::vec4(corner, 1.0f);
+            behindNear = behindNear || clip[c].w <= 1e-5f;
+        }
+
+        // Outside the frustum if every corner is beyond the same plane
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; ++axis) {
+            bool allBelow = true, allAbove = true;
+            for (const auto& corner : clip) {
+                allBelow = allBelow && corner[axis] < -corner.w;
+                allAbove = allAbove && corner[axis] > corner.w;
+            }
+            outside = allBelow || allAbove;
+        }
+        if (outside) {
+            ++m_Stats.frustumCulled;
+            continue;
+        }
+
+        if (!occlusion) {
+            visible[i] = 1;
+            continue;
+        }
+
+        // The pyramid is a frame or two old: project with the view it was
+        // rendered from, so boxes and depths agree
+        const glm::mat4 pyramidMvp = m_PyramidViewProjection * object.model;
+        for (int c = 0; c < 8; ++c) {
+            const glm::vec3 corner((c & 1) ? object.boundsMax.x : object.boundsMin.x,
+                                   (c & 2) ? object.boundsMax.y : object.boundsMin.y,
+                                   (c & 4) ? object.boundsMax.z : object.boundsMin.z);
+            clip[c] = pyramidMvp * glm::vec4(corner, 1.0f);
+            behindNear = behindNear || clip[c].w <= 1e-5f;
+        }
+        // Bounds crossing the near plane do not project to a rectangle
+        if (behindNear) {
+            visible[i] = 1;
+            continue;
+        }
+
+        glm::vec2 ndcMin(1e30f), ndcMax(-1e30f);
+        float nearestDepth = 1.0f;
+        for (const auto& corner : clip) {
+            const glm::vec3 ndc = glm::vec3(corner) / corner.w;
+            ndcMin = glm::min(ndcMin, glm::vec2(ndc));
+            ndcMax = glm::max(ndcMax, glm::vec2(ndc));
+            nearestDepth = std::min(nearestDepth, ndc.z * 0.5f + 0.5f);
+        }
+        if (isOccluded(ndcMin, ndcMax, nearestDepth))
+            ++m_Stats.occluded;
+        else
+            visible[i] = 1;
+    }
+
+    // This frame's visible set occludes next frame
+    m_Occluders = visible;
+    m_Stats.cpuTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
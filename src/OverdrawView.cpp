@@ -0,0 +1,276 @@
+#include "OverdrawView.h"
+#include "ShaderWatcher.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// Overdraw values are whole layers; the top bin collects 16 and more
+static constexpr float kOverdrawRange = static_cast<float>(OverdrawView::HistogramBins);
+
+OverdrawView::OverdrawView(ShaderWatcher* watcher) :
+m_Watcher(watcher),
+m_CountShader(std::make_unique<Shader>("shaders/depth.vert", "shaders/overdraw.frag")),
+m_DisplayShader(std::make_unique<Shader>("shaders/upscale.vert", "shaders/heatmap.frag"))
+{
+    m_EmptyVAO.create("OverdrawView fullscreen", GL_HERE);
+    for (auto& readback : m_Readbacks)
+        readback.buffer.create("OverdrawView readback", GL_HERE);
+    if (m_Watcher) {
+        m_Watcher->watch(*m_CountShader);
+        m_Watcher->watch(*m_DisplayShader);
+    }
+}
+
+OverdrawView::~OverdrawView() {
+    if (m_Watcher) {
+        m_Watcher->unwatch(*m_CountShader);
+        m_Watcher->unwatch(*m_DisplayShader);
+    }
+    for (auto& readback : m_Readbacks)
+        glDeleteSync(readback.fence);
+}
+
+void OverdrawView::release() {
+    m_Framebuffer.reset();
+    m_Counts.reset();
+    m_Depth.reset();
+}
+
+void OverdrawView::resize(int width, int height) {
+    if (width == m_Width && height == m_Height)
+        return;
+    m_Width = width;
+    m_Height = height;
+    release();
+}
+
+float OverdrawView::range() const {
+    return m_Mode == Mode::Overdraw ? kOverdrawRange : m_CostRange;
+}
+
+void OverdrawView::allocate() {
+    // Float blending is core in GL 3; R32F keeps counts exact far beyond
+    // any realistic overdraw, and costs need fractions anyway
+    const size_t pixels = static_cast<size_t>(m_Width) * m_Height;
+    m_Counts.create("OverdrawView counts", GL_HERE);
+    glBindTexture(GL_TEXTURE_2D, m_Counts);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_Width, m_Height, 0, GL_RED, GL_FLOAT, nullptr);
+    m_Counts.setBytes(pixels * 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    m_Depth.create("OverdrawView depth", GL_HERE);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_Depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_Width, m_Height);
+    m_Depth.setBytes(pixels * 4);
+
+    m_Framebuffer.create("OverdrawView", GL_HERE);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Counts, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_Depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Overdraw framebuffer incomplete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        release();
+    }
+}
+
+void OverdrawView::pollCosts() {
+    for (auto& cost : m_Costs) {
+        if (!cost.timer)
+            continue;
+        double milliseconds = 0.0;
+        if (cost.timer->poll(milliseconds))
+            cost.time = cost.time == 0.0 ? milliseconds : cost.time + 0.1 * (milliseconds - cost.time);
+
+        while (cost.pending > 0) {
+            const GLuint query = cost.samples[(cost.next + cost.samples.size() - cost.pending) % cost.samples.size()];
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint samples = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+            cost.fragments = cost.fragments == 0.0 ? samples : cost.fragments + 0.1 * (samples - cost.fragments);
+            --cost.pending;
+        }
+    }
+}
+
+void OverdrawView::drawScene(const std::vector<size_t>& draws, Shader& shader, bool timed, bool counted,
+                             const std::function<void(size_t, Shader&)>& draw) {
+    for (size_t id : draws) {
+        if (id >= m_Costs.size())
+            m_Costs.resize(id + 1);
+        DrawCost& cost = m_Costs[id];
+        if ((timed || counted) && !cost.timer) {
+            cost.timer = std::make_unique<GpuTimer>();
+            for (auto& query : cost.samples)
+                query.create("OverdrawView samples", GL_HERE);
+        }
+
+        if (counted) {
+            // Each fragment adds the cost per fragment of its draw
+            float weight = 1.0f;
+            if (m_Mode == Mode::FragmentCost)
+                weight = cost.fragments > 0.0 ? static_cast<float>(cost.time * 1.0e6 / cost.fragments) : 0.0f;
+            shader.setFloat("weight", weight);
+        }
+
+        const bool sampled = counted && cost.pending < cost.samples.size();
+        if (timed)
+            cost.timer->begin();
+        if (sampled)
+            glBeginQuery(GL_SAMPLES_PASSED, cost.samples[cost.next]);
+        draw(id, shader);
+        if (sampled) {
+            glEndQuery(GL_SAMPLES_PASSED);
+            cost.next = (cost.next + 1) % cost.samples.size();
+            ++cost.pending;
+        }
+        if (timed)
+            cost.timer->end();
+    }
+}
+
+void OverdrawView::render(const std::vector<size_t>& draws, Shader& sceneShader, const glm::mat4& view,
+                          const glm::mat4& projection, const std::function<void(size_t, Shader&)>& draw) {
+    if (!m_Framebuffer && m_Width > 0 && m_Height > 0)
+        allocate();
+    if (!m_Framebuffer || !m_CountShader->isReady() || !m_DisplayShader->isReady())
+        return;
+
+    collect();
+    pollCosts();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
+    glViewport(0, 0, m_Width, m_Height);
+    glEnable(GL_DEPTH_TEST);
+
+    auto depthPrepass = [&]() {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthFunc(GL_LESS);
+        m_CountShader->use();
+        drawScene(draws, *m_CountShader, false, false, draw);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_LEQUAL);
+    };
+    m_CountShader->use();
+    m_CountShader->setMat4("view", glm::value_ptr(view));
+    m_CountShader->setMat4("projection", glm::value_ptr(projection));
+
+    // Fragment cost: time every draw with the real shader, under the same
+    // depth setup as the counting pass below
+    if (m_Mode == Mode::FragmentCost) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (m_DepthPrepass)
+            depthPrepass();
+        sceneShader.use();
+        drawScene(draws, sceneShader, true, false, draw);
+        glDepthFunc(GL_LESS);
+    }
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (m_DepthPrepass)
+        depthPrepass();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    m_CountShader->use();
+    drawScene(draws, *m_CountShader, false, true, draw);
+    glDisable(GL_BLEND);
+    glDepthFunc(GL_LESS);
+
+    readBack();
+
+    // Colormap and histogram over the whole window
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_Width, m_Height);
+    glDisable(GL_DEPTH_TEST);
+    m_DisplayShader->use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_Counts);
+    m_DisplayShader->setInt("counts", 0);
+    m_DisplayShader->setFloat("range", range());
+    const float peak = *std::max_element(m_Stats.histogram.begin(), m_Stats.histogram.end());
+    for (size_t bin = 0; bin < HistogramBins; ++bin)
+        m_DisplayShader->setFloat("histogram[" + std::to_string(bin) + "]",
+                                  peak > 0.0f ? m_Stats.histogram[bin] / peak : 0.0f);
+    glBindVertexArray(m_EmptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void OverdrawView::readBack() {
+    // Skipped while the slot's previous readback is still in flight
+    Readback& readback = m_Readbacks[m_NextReadback];
+    if (readback.fence)
+        return;
+    m_NextReadback = (m_NextReadback + 1) % m_Readbacks.size();
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    if (readback.width != m_Width || readback.height != m_Height) {
+        const size_t size = static_cast<size_t>(m_Width) * m_Height * sizeof(float);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        readback.buffer.setBytes(size);
+        readback.width = m_Width;
+        readback.height = m_Height;
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, m_Width, m_Height, GL_RED, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.range = range();
+}
+
+void OverdrawView::collect() {
+    for (auto& readback : m_Readbacks) {
+        if (!readback.fence || glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            continue;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        const size_t count = static_cast<size_t>(readback.width) * readback.height;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const auto* values = static_cast<const float*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT));
+        if (values) {
+            Stats stats;
+            std::array<size_t, HistogramBins> bins{};
+            double sum = 0.0;
+            size_t covered = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const float value = values[i];
+                if (value <= 0.0f)
+                    continue;
+                ++covered;
+                sum += value;
+                stats.maxValue = std::max(stats.maxValue, value);
+                const int bin = static_cast<int>(std::ceil(value / readback.range * HistogramBins)) - 1;
+                ++bins[std::clamp(bin, 0, static_cast<int>(HistogramBins) - 1)];
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+            if (count > 0) {
+                stats.average = covered > 0 ? sum / covered : 0.0;
+                stats.screenAverage = sum / count;
+                stats.coverage = covered / double(count);
+            }
+            for (size_t bin = 0; bin < HistogramBins; ++bin)
+                stats.histogram[bin] = covered > 0 ? bins[bin] / float(covered) : 0.0f;
+            m_Stats = stats;
+
+            // Costs have no natural scale; follow the maximum, quickly up
+            // and slowly down so the colors stay readable
+            if (m_Mode == Mode::FragmentCost && stats.maxValue > 0.0f)
+                m_CostRange = stats.maxValue > m_CostRange ? stats.maxValue
+                                                           : m_CostRange + 0.05f * (stats.maxValue - m_CostRange);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
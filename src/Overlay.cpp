@@ -0,0 +1,74 @@
+#include "Overlay.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <algorithm>
+
+#ifdef SHADERVIEWER_IMGUI
+#include <imgui.h>
+#include <imgui_impl_glfw.h>
+#include <imgui_impl_opengl3.h>
+#endif
+
+Overlay::Overlay(GLFWwindow* window) :
+m_Window(window)
+{
+#ifdef SHADERVIEWER_IMGUI
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = nullptr;
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 330 core");
+#else
+    // GLFW has no title getter before 3.4; this matches glfwCreateWindow in main
+    m_Title = "ShaderViewer Test";
+#endif
+}
+
+Overlay::~Overlay() {
+#ifdef SHADERVIEWER_IMGUI
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+#endif
+}
+
+void Overlay::set(const std::string& label, const std::string& value) {
+    auto found = std::find_if(m_Lines.begin(), m_Lines.end(), [&](const auto& line) { return line.first == label; });
+    if (found != m_Lines.end())
+        found->second = value;
+    else
+        m_Lines.emplace_back(label, value);
+}
+
+void Overlay::remove(const std::string& label) {
+    m_Lines.erase(std::remove_if(m_Lines.begin(), m_Lines.end(), [&](const auto& line) { return line.first == label; }),
+                  m_Lines.end());
+}
+
+void Overlay::render() {
+#ifdef SHADERVIEWER_IMGUI
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_Always);
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("Stats", nullptr,
+                 ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoInputs |
+                     ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing);
+    for (const auto& [label, value] : m_Lines)
+        ImGui::Text("%s: %s", label.c_str(), value.c_str());
+    ImGui::End();
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+#else
+    // Retitling is a window manager round trip; don't do it every frame
+    const double now = glfwGetTime();
+    if (now - m_LastTitleUpdate < 0.5)
+        return;
+    m_LastTitleUpdate = now;
+    std::string title = m_Title;
+    for (const auto& [label, value] : m_Lines)
+        title += " | " + label + ": " + value;
+    glfwSetWindowTitle(m_Window, title.c_str());
+#endif
+}
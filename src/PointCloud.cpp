@@ -0,0 +1,191 @@
+#include "PointCloud.h"
+#include "Shader.h"
+#include "VertexLayout.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <utility>
+
+// Points in the coarsest level of the buffer, and the fewest drawn
+static constexpr size_t kMinPoints = 128;
+
+namespace {
+
+struct PointVertex {
+    float position[3];
+    uint8_t color[4];
+};
+static_assert(sizeof(PointVertex) == 16, "PointVertex must stay tightly packed");
+
+// Spreads the low 21 bits of v so two zero bits follow each one
+uint64_t spreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+uint8_t toUnorm8(float value) {
+    return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+} // namespace
+
+PointCloud::PointCloud(const std::vector<float>& positions, const std::vector<float>& colors,
+                       const std::string& label) :
+m_Count(positions.size() / 3)
+{
+    if (m_Count == 0)
+        return;
+
+    m_BoundsMin = m_BoundsMax = glm::vec3(positions[0], positions[1], positions[2]);
+    for (size_t i = 0; i < m_Count; ++i) {
+        const glm::vec3 p(positions[3 * i + 0], positions[3 * i + 1], positions[3 * i + 2]);
+        m_BoundsMin = glm::min(m_BoundsMin, p);
+        m_BoundsMax = glm::max(m_BoundsMax, p);
+    }
+
+    // Scans sample surfaces, so spread the points over (roughly) the area
+    // of the bounding box rather than its volume
+    const glm::vec3 extent = m_BoundsMax - m_BoundsMin;
+    const float area = extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    m_Spacing = area > 0.0f ? std::sqrt(area / m_Count) : glm::length(extent) / m_Count;
+
+    // Morton order over a 2^21 lattice per axis
+    std::vector<std::pair<uint64_t, uint32_t>> keys(m_Count);
+    const glm::vec3 toLattice = 2097151.0f / glm::max(extent, glm::vec3(1e-20f));
+    for (size_t i = 0; i < m_Count; ++i) {
+        const glm::vec3 p(positions[3 * i + 0], positions[3 * i + 1], positions[3 * i + 2]);
+        const glm::vec3 cell = glm::clamp((p - m_BoundsMin) * toLattice, glm::vec3(0.0f), glm::vec3(2097151.0f));
+        const uint64_t code = spreadBits(static_cast<uint64_t>(cell.x)) |
+                              spreadBits(static_cast<uint64_t>(cell.y)) << 1 |
+                              spreadBits(static_cast<uint64_t>(cell.z)) << 2;
+        keys[i] = {code, static_cast<uint32_t>(i)};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    // Levels taken by stride from the Morton order: every 2^L-th point
+    // first, then the points halfway between those, and so on down to the
+    // odd ones. Each level is an even sample of the whole cloud and stays
+    // in Morton order, so a prefix is all the coarser levels plus the start
+    // of the next, which at most doubles the density along part of the curve
+    int levels = 0;
+    while ((m_Count >> (levels + 1)) >= kMinPoints)
+        ++levels;
+    std::vector<size_t> order;
+    order.reserve(m_Count);
+    for (size_t k = 0; k < m_Count; k += size_t(1) << levels)
+        order.push_back(k);
+    for (int level = levels - 1; level >= 0; --level) {
+        const size_t stride = size_t(1) << level;
+        for (size_t k = stride; k < m_Count; k += 2 * stride)
+            order.push_back(k);
+    }
+
+    const bool colored = colors.size() >= 3 * m_Count;
+    std::vector<PointVertex> vertices;
+    vertices.reserve(m_Count);
+    for (size_t k : order) {
+        const size_t i = keys[k].second;
+        PointVertex vertex;
+        vertex.position[0] = positions[3 * i + 0];
+        vertex.position[1] = positions[3 * i + 1];
+        vertex.position[2] = positions[3 * i + 2];
+        for (int c = 0; c < 3; ++c)
+            vertex.color[c] = colored ? toUnorm8(colors[3 * i + c]) : 255;
+        vertex.color[3] = 255;
+        vertices.push_back(vertex);
+    }
+    order = {};
+    keys = {};
+
+    m_VAO.create(label, GL_HERE);
+    m_VBO.create(label + " vertices", GL_HERE);
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PointVertex), vertices.data(), GL_STATIC_DRAW);
+    m_VBO.setBytes(vertices.size() * sizeof(PointVertex));
+
+    glVertexAttribPointer(VertexLayout::Position, 3, GL_FLOAT, GL_FALSE, sizeof(PointVertex), (void*)0);
+    glEnableVertexAttribArray(VertexLayout::Position);
+    glVertexAttribPointer(VertexLayout::Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PointVertex),
+                          (void*)offsetof(PointVertex, color));
+    glEnableVertexAttribArray(VertexLayout::Color);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    std::cout << "Loaded " << m_Count << " points" << (colored ? " with colors" : "") << ", spacing ~"
+              << m_Spacing << std::endl;
+}
+
+void PointCloud::update(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection,
+                        int viewportWidth, int viewportHeight) {
+    const glm::mat4 modelView = view * model;
+    const bool changed = modelView != m_LastModelView || projection != m_LastProjection ||
+                         viewportWidth != m_LastWidth || viewportHeight != m_LastHeight;
+    m_LastModelView = modelView;
+    m_LastProjection = projection;
+    m_LastWidth = viewportWidth;
+    m_LastHeight = viewportHeight;
+    m_FocalScale = projection[1][1];
+
+    // Screen rectangle of the bounds; a corner behind the camera means the
+    // cloud may cover the whole screen
+    const glm::mat4 modelViewProjection = projection * modelView;
+    glm::vec2 low(1.0f), high(-1.0f);
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 p(corner & 1 ? m_BoundsMax.x : m_BoundsMin.x, corner & 2 ? m_BoundsMax.y : m_BoundsMin.y,
+                          corner & 4 ? m_BoundsMax.z : m_BoundsMin.z);
+        const glm::vec4 clip = modelViewProjection * glm::vec4(p, 1.0f);
+        if (clip.w <= 1e-6f) {
+            low = glm::vec2(-1.0f);
+            high = glm::vec2(1.0f);
+            break;
+        }
+        low = glm::min(low, glm::vec2(clip) / clip.w);
+        high = glm::max(high, glm::vec2(clip) / clip.w);
+    }
+    const glm::vec2 covered = glm::max(glm::clamp(high, -1.0f, 1.0f) - glm::clamp(low, -1.0f, 1.0f), 0.0f) * 0.5f;
+    const double pixels = double(covered.x) * covered.y * viewportWidth * viewportHeight;
+
+    // Always the coarsest level, so tiny or distant clouds still show
+    const size_t densityCap = static_cast<size_t>(pixels * m_MaxPointsPerPixel);
+    m_Target = std::min(m_Count, std::max(densityCap, kMinPoints));
+
+    // Interactive while moving; refine towards the target once still
+    const size_t moving = std::min(m_Target, m_PointBudget);
+    m_Drawn = changed ? moving : std::min(m_Target, std::max(m_Drawn * 2, moving));
+}
+
+void PointCloud::draw(const Shader& shader) const {
+    // Depth-only and heatmap shaders don't size points; they get 1 pixel
+    const bool sized = shader.hasUniform("pointScale");
+    if (sized) {
+        // A prefix holding fraction f of a surface's points spaces them
+        // 1/sqrt(f) further apart
+        const float spacing = m_Spacing * std::sqrt(static_cast<float>(m_Count) / m_Drawn);
+        // The bound target, which dynamic resolution may have scaled down
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        const float pixelsPerUnit = m_FocalScale * viewport[3] * 0.5f;
+        shader.setFloat("pointScale", spacing * m_PointScale * pixelsPerUnit);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+    }
+    drawGeometry();
+    if (sized)
+        glDisable(GL_PROGRAM_POINT_SIZE);
+}
+
+void PointCloud::drawGeometry() const {
+    if (m_Drawn == 0)
+        return;
+    glBindVertexArray(m_VAO);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_Drawn));
+    glBindVertexArray(0);
+}
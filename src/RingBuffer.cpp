@@ -0,0 +1,120 @@
+#include "RingBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+RingBuffer::RingBuffer(size_t regionSize, size_t regions, const std::string& label) :
+m_RegionSize(regionSize),
+m_Fences(std::max<size_t>(regions, 1), nullptr)
+{
+    // Bound to GL_COPY_WRITE_BUFFER for setup and mapping, so the array and
+    // uniform buffer bindings of whoever draws stay untouched
+    m_Buffer.create(label, GL_HERE);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, m_RegionSize * m_Fences.size(), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_Buffer.setBytes(m_RegionSize * m_Fences.size());
+}
+
+RingBuffer::~RingBuffer() {
+    commit();
+    for (GLsync fence : m_Fences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+}
+
+void RingBuffer::beginFrame() {
+    commit();
+    if (m_InFrame) // endFrame() was skipped; keep the region fenced anyway
+        endFrame();
+    m_Region = (m_Region + 1) % m_Fences.size();
+    m_Head = 0;
+    m_InFrame = true;
+    m_Stats.waitTime = 0.0;
+
+    // Normally signalled frames ago; otherwise the GPU is that far behind
+    // and writing into the region now would corrupt data it still reads
+    GLsync& fence = m_Fences[m_Region];
+    if (!fence)
+        return;
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        const auto start = std::chrono::steady_clock::now();
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        m_Stats.waitTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_Stats.maxWaitTime = std::max(m_Stats.maxWaitTime, m_Stats.waitTime);
+        ++m_Stats.waits;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void RingBuffer::endFrame() {
+    commit();
+    if (!m_InFrame)
+        return;
+    m_InFrame = false;
+    m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++m_Stats.frames;
+    m_Stats.usedBytes = m_Head;
+    m_Stats.peakBytes = std::max(m_Stats.peakBytes, m_Head);
+}
+
+RingBuffer::Allocation RingBuffer::allocate(size_t size, size_t alignment) {
+    commit();
+    Allocation allocation;
+    if (!m_InFrame || size == 0)
+        return allocation;
+
+    alignment = std::max<size_t>(alignment, 1);
+    const size_t offset = (m_Head + alignment - 1) / alignment * alignment;
+    if (offset + size > m_RegionSize) {
+        if (m_Stats.overflows++ == 0)
+            std::cerr << "RingBuffer: " << size << " bytes do not fit a " << m_RegionSize << "-byte region"
+                      << std::endl;
+        return allocation;
+    }
+
+    // The region's fence has signalled, so nothing the GPU reads overlaps
+    const size_t start = m_Region * m_RegionSize + offset;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, start, size,
+                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!data)
+        return allocation;
+
+    m_Head = offset + size;
+    m_Mapped = true;
+    allocation.buffer = m_Buffer;
+    allocation.offset = static_cast<GLintptr>(start);
+    allocation.size = static_cast<GLsizeiptr>(size);
+    allocation.data = data;
+    return allocation;
+}
+
+void RingBuffer::commit() {
+    if (!m_Mapped)
+        return;
+    m_Mapped = false;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+RingBuffer::Allocation RingBuffer::upload(const void* data, size_t size, size_t alignment) {
+    Allocation allocation = allocate(size, alignment);
+    if (allocation) {
+        std::memcpy(allocation.data, data, size);
+        commit();
+        allocation.data = nullptr;
+    }
+    return allocation;
+}
+
+size_t RingBuffer::uniformAlignment() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return static_cast<size_t>(std::max(alignment, 1));
+}
@@ -1,69 +1,132 @@
 #include "Shader.h"
-#include <fstream>
-#include <sstream>
+#include "Hash.h"
+#include "ShaderPreprocessor.h"
+#include <algorithm>
 #include <iostream>
 
-Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath) :
+Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string> defines,
+               bool buildNow) :
 m_VertexPath(vertexPath),
-m_FragmentPath(fragmentPath)
+m_FragmentPath(fragmentPath),
+m_Defines(std::move(defines))
 {
-    compileAndLink();
+    if (buildNow)
+        compileAndLink();
 }
 
-bool Shader::compileAndLink(){
-    std::ifstream vFile(m_VertexPath), fFile(m_FragmentPath);
-    std::stringstream vStream, fStream;
-    vStream << vFile.rdbuf();
-    fStream << fFile.rdbuf();
-    std::string vCode = vStream.str();
-    std::string fCode = fStream.str();
-    const char* vShaderCode = vCode.c_str();
-    const char* fShaderCode = fCode.c_str();
-
-    GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
+static void submitStage(GLShader& shader, GLenum type, const std::string& source, const std::string& path) {
+    const char* code = source.c_str();
+    shader.create(path, GL_HERE, type);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+}
+
+// Prints the stage's log if it failed to compile; returns whether it compiled
+static bool reportStage(GLuint shader, const std::vector<std::string>& files, const char* label) {
     GLint success;
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cerr << "Vertex shader compilation failed:\n" << infoLog << std::endl;
-        return false;
+        ShaderPreprocessor::Result mapping;
+        mapping.files = files;
+        std::cerr << label << " shader compilation failed:\n"
+                  << ShaderPreprocessor::mapLog(Shader::shaderLog(shader), mapping) << std::endl;
     }
+    return success;
+}
 
-    GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cerr << "Fragment shader compilation failed:\n" << infoLog << std::endl;
-        return false;
+std::string Shader::shaderLog(GLuint shader) {
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::string log(length > 0 ? length : 0, '\0');
+    if (length > 0)
+        glGetShaderInfoLog(shader, length, NULL, &log[0]);
+    while (!log.empty() && log.back() == '\0')
+        log.pop_back();
+    return log;
+}
+
+std::string Shader::programLog(GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::string log(length > 0 ? length : 0, '\0');
+    if (length > 0)
+        glGetProgramInfoLog(program, length, NULL, &log[0]);
+    while (!log.empty() && log.back() == '\0')
+        log.pop_back();
+    return log;
+}
+
+bool Shader::compileAndLink(){
+    return beginBuild() && finishBuild();
+}
+
+bool Shader::beginBuild(){
+    ShaderPreprocessor& preprocessor = ShaderPreprocessor::shared();
+    ShaderPreprocessor::Result vSource = preprocessor.preprocess(m_VertexPath, m_Defines);
+    ShaderPreprocessor::Result fSource = preprocessor.preprocess(m_FragmentPath, m_Defines);
+
+    // Track dependencies even on failure so fixing any of the files triggers a rebuild
+    m_Dependencies = vSource.files;
+    for (const auto& file : fSource.files) {
+        if (std::find(m_Dependencies.begin(), m_Dependencies.end(), file) == m_Dependencies.end())
+            m_Dependencies.push_back(file);
     }
 
-    m_Program = glCreateProgram();
-    glAttachShader(m_Program, vertex);
-    glAttachShader(m_Program, fragment);
-    glLinkProgram(m_Program);
-    glGetProgramiv(m_Program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(m_Program, 512, NULL, infoLog);
-        std::cerr << "Shader program linking failed:\n" << infoLog << std::endl;
+    if (!vSource.ok || !fSource.ok) {
+        std::cerr << "Shader preprocessing failed:\n" << (vSource.ok ? fSource.error : vSource.error) << std::endl;
         return false;
     }
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-    
+
+    // Saving a file without changing what the driver would see is free
+    const uint64_t sourceHash = hashBytes(&fSource.hash, sizeof(fSource.hash), vSource.hash);
+    if (m_Program && sourceHash == m_SourceHash)
+        return true;
+    if (isBuildPending() && sourceHash == m_Pending.sourceHash)
+        return true;
+
+    // A newer edit supersedes a build that is still in flight; create()
+    // deletes its objects
+    submitStage(m_Pending.vertex, GL_VERTEX_SHADER, vSource.source, m_VertexPath);
+    submitStage(m_Pending.fragment, GL_FRAGMENT_SHADER, fSource.source, m_FragmentPath);
+    m_Pending.program.create(m_VertexPath + " + " + m_FragmentPath, GL_HERE);
+    glAttachShader(m_Pending.program, m_Pending.vertex);
+    glAttachShader(m_Pending.program, m_Pending.fragment);
+    glLinkProgram(m_Pending.program);
+    m_Pending.sourceHash = sourceHash;
+    m_Pending.vertexFiles = std::move(vSource.files);
+    m_Pending.fragmentFiles = std::move(fSource.files);
     return true;
 }
 
-Shader::~Shader() {
-    glDeleteProgram(m_Program);
+bool Shader::finishBuild(){
+    if (!isBuildPending())
+        return m_Program != 0;
+
+    PendingBuild pending = std::move(m_Pending);
+    m_Pending = PendingBuild();
+
+    GLint success;
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // A failed compile also fails the link; report the root cause
+        if (reportStage(pending.vertex, pending.vertexFiles, "Vertex") &&
+            reportStage(pending.fragment, pending.fragmentFiles, "Fragment")) {
+            std::cerr << "Shader program linking failed:\n" << programLog(pending.program) << std::endl;
+        }
+    }
+    if (!success)
+        return false; // `pending` deletes the objects
+
+    // Only replace the running program once the new one is known to work;
+    // the program keeps its attached stages alive as long as it needs them
+    m_Program = std::move(pending.program);
+    ID = m_Program;
+    m_SourceHash = pending.sourceHash;
+    return true;
 }
 
+Shader::~Shader() = default;
+
 void Shader::use() const {
     glUseProgram(m_Program);
 }
@@ -76,7 +139,22 @@ void Shader::setFloat(const std::string& name, float value) const {
     glUniform1f(glGetUniformLocation(m_Program, name.c_str()), value);
 }
 
+void Shader::setInt(const std::string& name, int value) const {
+    glUniform1i(glGetUniformLocation(m_Program, name.c_str()), value);
+}
+
+bool Shader::hasUniform(const std::string& name) const {
+    return m_Program != 0 && glGetUniformLocation(m_Program, name.c_str()) != -1;
+}
+
+void Shader::setVec2(const std::string& name, const float* value) const {
+    glUniform2fv(glGetUniformLocation(m_Program, name.c_str()), 1, value);
+}
+
+void Shader::setVec3(const std::string& name, const float* value) const {
+    glUniform3fv(glGetUniformLocation(m_Program, name.c_str()), 1, value);
+}
+
 void Shader::reload(){
-    glDeleteProgram(m_Program);  // Delete old shader program
-    compileAndLink();            // Recompile and relink
+    compileAndLink(); // Keeps the current program if the new sources fail
 }
\ No newline at end of file
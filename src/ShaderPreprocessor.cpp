@@ -0,0 +1,242 @@
+#include "ShaderPreprocessor.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+static std::string normalizePath(const fs::path& path) {
+    return path.lexically_normal().generic_string();
+}
+
+static std::string lineDirective(size_t line, size_t fileIndex) {
+    return "#line " + std::to_string(line) + " " + std::to_string(fileIndex) + "\n";
+}
+
+// Returns the directive name ("include", "version", ...) of a preprocessor line
+static std::string directiveOf(const std::string& line, size_t& argumentStart) {
+    size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string::npos || line[pos] != '#')
+        return "";
+    pos = line.find_first_not_of(" \t", pos + 1);
+    if (pos == std::string::npos)
+        return "";
+    size_t end = pos;
+    while (end < line.size() && (std::isalnum(static_cast<unsigned char>(line[end])) || line[end] == '_'))
+        ++end;
+    argumentStart = end;
+    return line.substr(pos, end - pos);
+}
+
+ShaderPreprocessor::ShaderPreprocessor(std::vector<std::string> includeDirs) :
+m_IncludeDirs(std::move(includeDirs))
+{
+}
+
+ShaderPreprocessor& ShaderPreprocessor::shared() {
+    static ShaderPreprocessor instance;
+    return instance;
+}
+
+const std::string* ShaderPreprocessor::readSource(const std::string& path, Stamp& stamp) {
+    std::error_code ec;
+    stamp = fs::last_write_time(path, ec);
+    if (ec)
+        return nullptr;
+
+    auto found = m_Sources.find(path);
+    if (found != m_Sources.end() && found->second.first == stamp)
+        return &found->second.second;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return nullptr;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    auto& entry = m_Sources[path];
+    entry = {stamp, stream.str()};
+    return &entry.second;
+}
+
+std::string ShaderPreprocessor::resolve(const std::string& name, const std::string& includer) const {
+    std::error_code ec;
+    fs::path local = fs::path(includer).parent_path() / name;
+    if (fs::is_regular_file(local, ec))
+        return normalizePath(local);
+    for (const auto& dir : m_IncludeDirs) {
+        fs::path candidate = fs::path(dir) / name;
+        if (fs::is_regular_file(candidate, ec))
+            return normalizePath(candidate);
+    }
+    return "";
+}
+
+bool ShaderPreprocessor::expand(const std::string& path, const std::vector<std::string>& defines,
+                                Result& result, std::vector<std::string>& stack,
+                                std::unordered_set<std::string>& once, std::string& out) {
+    Stamp stamp;
+    const std::string* text = readSource(path, stamp);
+    if (!text) {
+        result.error = "cannot read " + path;
+        return false;
+    }
+
+    size_t fileIndex = std::find(result.files.begin(), result.files.end(), path) - result.files.begin();
+    if (fileIndex == result.files.size())
+        result.files.push_back(path);
+    const bool isRoot = stack.empty();
+    stack.push_back(path);
+
+    // Defines go right after #version; a root file without one gets them on top
+    bool hasVersion = false;
+    if (isRoot) {
+        std::istringstream scan(*text);
+        std::string line;
+        size_t argument = 0;
+        while (!hasVersion && std::getline(scan, line))
+            hasVersion = directiveOf(line, argument) == "version";
+    }
+    bool definesEmitted = !isRoot;
+    auto emitDefines = [&](size_t nextLine) {
+        for (const auto& define : defines) {
+            size_t equals = define.find('=');
+            if (equals == std::string::npos)
+                out += "#define " + define + " 1\n";
+            else
+                out += "#define " + define.substr(0, equals) + " " + define.substr(equals + 1) + "\n";
+        }
+        out += lineDirective(nextLine, fileIndex);
+        definesEmitted = true;
+    };
+    if (!isRoot)
+        out += lineDirective(1, fileIndex);
+
+    std::istringstream lines(*text);
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        size_t argument = 0;
+        const std::string directive = directiveOf(line, argument);
+
+        if (directive == "version") {
+            if (isRoot) {
+                out += line + "\n";
+                if (!definesEmitted)
+                    emitDefines(lineNumber + 1);
+            } else {
+                out += "\n"; // only the root's #version counts
+            }
+            continue;
+        }
+        if (!definesEmitted && !hasVersion)
+            emitDefines(lineNumber);
+
+        if (directive == "pragma" && line.find("once", argument) != std::string::npos) {
+            once.insert(path);
+            out += "\n";
+            continue;
+        }
+        if (directive != "include") {
+            out += line + "\n";
+            continue;
+        }
+
+        const size_t open = line.find_first_of("\"<", argument);
+        const size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+        if (close == std::string::npos) {
+            result.error = path + ":" + std::to_string(lineNumber) + ": malformed #include";
+            return false;
+        }
+        const std::string name = line.substr(open + 1, close - open - 1);
+        const std::string included = resolve(name, path);
+        if (included.empty()) {
+            result.error = path + ":" + std::to_string(lineNumber) + ": cannot find include '" + name + "'";
+            return false;
+        }
+        if (std::find(stack.begin(), stack.end(), included) != stack.end()) {
+            result.error = path + ":" + std::to_string(lineNumber) + ": include cycle through " + included;
+            return false;
+        }
+        if (once.count(included)) {
+            out += "\n";
+            continue;
+        }
+        if (!expand(included, defines, result, stack, once, out))
+            return false;
+        out += lineDirective(lineNumber + 1, fileIndex);
+    }
+    if (!definesEmitted) // empty root file
+        emitDefines(1);
+
+    stack.pop_back();
+    return true;
+}
+
+ShaderPreprocessor::Result ShaderPreprocessor::preprocess(const std::string& path,
+                                                         const std::vector<std::string>& defines) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    const std::string root = normalizePath(path);
+
+    uint64_t key = hashString(root);
+    for (const auto& define : defines)
+        key = hashString(define, hashString("\n", key));
+
+    auto found = m_Results.find(key);
+    if (found != m_Results.end()) {
+        bool fresh = true;
+        for (const auto& [file, stamp] : found->second.stamps) {
+            std::error_code ec;
+            if (fs::last_write_time(file, ec) != stamp || ec) {
+                fresh = false;
+                break;
+            }
+        }
+        if (fresh)
+            return found->second.result;
+    }
+
+    Result result;
+    std::vector<std::string> stack;
+    std::unordered_set<std::string> once;
+    result.ok = expand(root, defines, result, stack, once, result.source);
+    result.hash = hashString(result.source);
+    if (!result.ok) {
+        result.source.clear();
+        return result; // errors are not cached so fixing the file is picked up
+    }
+
+    Cached cached;
+    cached.result = result;
+    for (const auto& file : result.files)
+        cached.stamps.emplace_back(file, m_Sources[file].first);
+    m_Results[key] = std::move(cached);
+    return result;
+}
+
+std::string ShaderPreprocessor::mapLog(const std::string& log, const Result& result) {
+    // Covers the common driver formats: "0:12(3): error" (Mesa),
+    // "0(12) : error" (NVIDIA) and "ERROR: 0:12:" (AMD/Intel)
+    static const std::regex location(R"((^|[^\w.])(\d+)(?::|\()(\d+)\)?)");
+
+    std::istringstream lines(log);
+    std::string line, mapped;
+    while (std::getline(lines, line)) {
+        std::smatch match;
+        if (std::regex_search(line, match, location)) {
+            const size_t fileIndex = std::stoul(match[2].str());
+            if (fileIndex < result.files.size()) {
+                line = match.prefix().str() + match[1].str() + result.files[fileIndex] + ":" + match[3].str() +
+                       match.suffix().str();
+            }
+        }
+        mapped += line + "\n";
+    }
+    return mapped;
+}
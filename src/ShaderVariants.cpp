@@ -0,0 +1,188 @@
+#include "ShaderVariants.h"
+#include "ShaderWatcher.h"
+#include <algorithm>
+#include <bitset>
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath,
+                               std::vector<std::string> features, ShaderWatcher* watcher) :
+m_VertexPath(vertexPath),
+m_FragmentPath(fragmentPath),
+m_Features(std::move(features)),
+m_Watcher(watcher),
+m_Slots(16)
+{
+    Slot& base = findOrCreate(0);
+    if (base.shader->beginBuild() && base.shader->finishBuild())
+        m_Ready.push_back(0);
+    else
+        base.failed = true;
+    if (m_Watcher) // findOrCreate() watched it before its includes were known
+        m_Watcher->watch(*base.shader, [this](Shader&) { rebuild(0); });
+}
+
+ShaderVariants::~ShaderVariants() {
+    if (!m_Watcher)
+        return;
+    for (auto& slot : m_Slots) {
+        if (slot.occupied)
+            m_Watcher->unwatch(*slot.shader);
+    }
+}
+
+ShaderVariants::Mask ShaderVariants::feature(const std::string& name) const {
+    auto found = std::find(m_Features.begin(), m_Features.end(), name);
+    return found == m_Features.end() ? 0 : Mask(1) << (found - m_Features.begin());
+}
+
+size_t ShaderVariants::slotIndex(Mask mask) const {
+    // Multiplicative hash spreads the dense low bits of feature masks
+    const uint32_t hash = mask * 2654435769u;
+    return static_cast<size_t>(hash ^ (hash >> 16)) & (m_Slots.size() - 1);
+}
+
+ShaderVariants::Slot* ShaderVariants::find(Mask mask) {
+    for (size_t i = slotIndex(mask);; i = (i + 1) & (m_Slots.size() - 1)) {
+        if (!m_Slots[i].occupied)
+            return nullptr;
+        if (m_Slots[i].mask == mask)
+            return &m_Slots[i];
+    }
+}
+
+const ShaderVariants::Slot* ShaderVariants::find(Mask mask) const {
+    return const_cast<ShaderVariants*>(this)->find(mask);
+}
+
+ShaderVariants::Slot& ShaderVariants::findOrCreate(Mask mask) {
+    if (Slot* slot = find(mask))
+        return *slot;
+
+    // Keep the load factor under 1/2 so probe chains stay short
+    if ((m_Count + 1) * 2 > m_Slots.size()) {
+        std::vector<Slot> old(m_Slots.size() * 2);
+        old.swap(m_Slots);
+        for (auto& slot : old) {
+            if (!slot.occupied)
+                continue;
+            size_t i = slotIndex(slot.mask);
+            while (m_Slots[i].occupied)
+                i = (i + 1) & (m_Slots.size() - 1);
+            m_Slots[i] = std::move(slot);
+        }
+    }
+
+    size_t i = slotIndex(mask);
+    while (m_Slots[i].occupied)
+        i = (i + 1) & (m_Slots.size() - 1);
+
+    std::vector<std::string> defines;
+    for (size_t bit = 0; bit < m_Features.size(); ++bit) {
+        if (mask & (Mask(1) << bit))
+            defines.push_back(m_Features[bit]);
+    }
+
+    Slot& slot = m_Slots[i];
+    slot.mask = mask;
+    slot.occupied = true;
+    slot.shader = std::make_unique<Shader>(m_VertexPath, m_FragmentPath, std::move(defines), false);
+    ++m_Count;
+    if (m_Watcher)
+        m_Watcher->watch(*slot.shader, [this, mask](Shader&) { rebuild(mask); });
+    return slot;
+}
+
+bool ShaderVariants::isReady(Mask mask) const {
+    const Slot* slot = find(mask);
+    return slot && slot->shader->isReady();
+}
+
+Shader& ShaderVariants::get(Mask mask) {
+    Slot& slot = findOrCreate(mask);
+    if (slot.shader->isReady())
+        return *slot.shader;
+
+    if (!slot.failed)
+        enqueue(mask, true);
+
+    // Fall back to the ready variant agreeing on the most feature bits
+    Mask best = 0;
+    size_t bestScore = 0;
+    for (Mask ready : m_Ready) {
+        const size_t score = std::bitset<32>(~(ready ^ mask)).count();
+        if (score > bestScore) {
+            best = ready;
+            bestScore = score;
+        }
+    }
+    return *find(best)->shader;
+}
+
+void ShaderVariants::enqueue(Mask mask, bool urgent) {
+    if (std::find(m_InFlight.begin(), m_InFlight.end(), mask) != m_InFlight.end())
+        return;
+    auto queued = std::find(m_Queue.begin(), m_Queue.end(), mask);
+    if (queued != m_Queue.end()) {
+        if (!urgent)
+            return;
+        m_Queue.erase(queued);
+    }
+    if (urgent)
+        m_Queue.push_front(mask);
+    else
+        m_Queue.push_back(mask);
+}
+
+void ShaderVariants::rebuild(Mask mask) {
+    if (Slot* slot = find(mask)) {
+        slot->failed = false;
+        enqueue(mask, true);
+    }
+}
+
+void ShaderVariants::warmUp(Mask mask) {
+    if (!isReady(mask))
+        enqueue(mask, false);
+}
+
+void ShaderVariants::warmUpAll(Mask featureSubset) {
+    // Every subset of the given feature bits
+    for (Mask mask = featureSubset;; mask = (mask - 1) & featureSubset) {
+        warmUp(mask);
+        if (mask == 0)
+            break;
+    }
+}
+
+void ShaderVariants::reloadAll() {
+    for (auto& slot : m_Slots) {
+        if (slot.occupied) {
+            slot.failed = false;
+            enqueue(slot.mask, false);
+        }
+    }
+}
+
+void ShaderVariants::update(std::chrono::microseconds budget) {
+    // Builds submitted last frame have had a whole frame to complete in the
+    // driver, so checking their status now rarely blocks
+    for (Mask mask : m_InFlight) {
+        Slot* slot = find(mask);
+        slot->failed = !slot->shader->finishBuild();
+        if (slot->shader->isReady() && std::find(m_Ready.begin(), m_Ready.end(), mask) == m_Ready.end())
+            m_Ready.push_back(mask);
+        if (m_Watcher) // includes may have changed
+            m_Watcher->watch(*slot->shader, [this, mask](Shader&) { rebuild(mask); });
+    }
+    m_InFlight.clear();
+
+    const auto start = std::chrono::steady_clock::now();
+    while (!m_Queue.empty() && std::chrono::steady_clock::now() - start < budget) {
+        const Mask mask = m_Queue.front();
+        m_Queue.pop_front();
+        Slot& slot = findOrCreate(mask);
+        if (!slot.shader->beginBuild())
+            slot.failed = true;
+        else if (slot.shader->isBuildPending())
+            m_InFlight.push_back(mask);
+    }
+}
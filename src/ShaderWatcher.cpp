@@ -0,0 +1,70 @@
+#include "ShaderWatcher.h"
+#include "Shader.h"
+#include <algorithm>
+#include <iostream>
+
+ShaderWatcher::ShaderWatcher(std::chrono::milliseconds interval) : m_Interval(interval) {}
+
+void ShaderWatcher::watch(Shader& shader, std::function<void(Shader&)> onChange) {
+    if (std::find(m_Shaders.begin(), m_Shaders.end(), &shader) == m_Shaders.end())
+        m_Shaders.push_back(&shader);
+    if (onChange)
+        m_Handlers[&shader] = std::move(onChange);
+    else
+        m_Handlers.erase(&shader);
+    rebuildGraph();
+}
+
+void ShaderWatcher::unwatch(Shader& shader) {
+    m_Shaders.erase(std::remove(m_Shaders.begin(), m_Shaders.end(), &shader), m_Shaders.end());
+    m_Handlers.erase(&shader);
+    rebuildGraph();
+}
+
+void ShaderWatcher::rebuildGraph() {
+    m_Dependents.clear();
+    std::unordered_map<std::string, std::filesystem::file_time_type> stamps;
+    for (Shader* shader : m_Shaders) {
+        for (const auto& file : shader->dependencies()) {
+            m_Dependents[file].push_back(shader);
+            // Keep the old stamp for known files so a change made while a
+            // rebuild was running is still seen on the next poll
+            auto known = m_Stamps.find(file);
+            std::error_code ec;
+            stamps[file] = known != m_Stamps.end() ? known->second : std::filesystem::last_write_time(file, ec);
+        }
+    }
+    m_Stamps = std::move(stamps);
+}
+
+size_t ShaderWatcher::poll() {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_LastPoll < m_Interval)
+        return 0;
+    m_LastPoll = now;
+
+    std::vector<Shader*> stale;
+    for (auto& [file, stamp] : m_Stamps) {
+        std::error_code ec;
+        auto current = std::filesystem::last_write_time(file, ec);
+        if (ec || current == stamp)
+            continue; // missing files (mid-save) are retried next poll
+        stamp = current;
+        std::cout << "Changed: " << file << std::endl;
+        for (Shader* shader : m_Dependents[file]) {
+            if (std::find(stale.begin(), stale.end(), shader) == stale.end())
+                stale.push_back(shader);
+        }
+    }
+
+    for (Shader* shader : stale) {
+        auto handler = m_Handlers.find(shader);
+        if (handler != m_Handlers.end())
+            handler->second(*shader);
+        else
+            shader->reload();
+    }
+    if (!stale.empty())
+        rebuildGraph(); // includes may have been added or removed
+    return stale.size();
+}
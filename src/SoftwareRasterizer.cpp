@@ -0,0 +1,654 @@
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// The AVX2 block loop is compiled for the function alone and picked at run
+// time, so the rest of the build keeps its baseline instruction set
+#if defined(__x86_64__) || defined(_M_X64)
+#define SOFTWARE_RASTERIZER_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+constexpr int SubpixelBits = 4;
+constexpr int Subpixels = 1 << SubpixelBits;
+constexpr int TileSize = SoftwareRasterizer::TileSize;
+constexpr int BlockSize = SoftwareRasterizer::BlockSize;
+constexpr int BlocksPerTile = TileSize / BlockSize;
+constexpr size_t ChunkTriangles = 4096;
+// Triangle ids are (chunk << IndexBits) | index; clipping turns one
+// triangle into at most seven
+constexpr int IndexBits = 15;
+constexpr uint32_t NoTriangle = UINT32_MAX;
+
+struct ClipVertex {
+    glm::vec4 clip;
+    glm::vec3 world;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+ClipVertex mix(const ClipVertex& a, const ClipVertex& b, float t) {
+    return {a.clip + (b.clip - a.clip) * t, a.world + (b.world - a.world) * t, a.normal + (b.normal - a.normal) * t,
+            a.uv + (b.uv - a.uv) * t};
+}
+
+// Distance to frustum plane `plane` (w+x, w-x, w+y, w-y, w+z, w-z); inside when >= 0
+float planeDistance(const glm::vec4& clip, int plane) {
+    const float value = clip[plane / 2];
+    return plane % 2 ? clip.w - value : clip.w + value;
+}
+
+int outcode(const glm::vec4& clip) {
+    int code = 0;
+    for (int plane = 0; plane < 6; ++plane) {
+        if (planeDistance(clip, plane) < 0.0f)
+            code |= 1 << plane;
+    }
+    return code;
+}
+
+// Sutherland-Hodgman against the planes in `planes`; `polygon` holds room
+// for 9 vertices. Returns the vertex count.
+int clipPolygon(ClipVertex* polygon, int count, int planes) {
+    ClipVertex scratch[9];
+    for (int plane = 0; plane < 6 && count >= 3; ++plane) {
+        if (!(planes & (1 << plane)))
+            continue;
+        int out = 0;
+        for (int i = 0; i < count; ++i) {
+            const ClipVertex& a = polygon[i];
+            const ClipVertex& b = polygon[(i + 1) % count];
+            const float da = planeDistance(a.clip, plane), db = planeDistance(b.clip, plane);
+            if (da >= 0.0f)
+                scratch[out++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                scratch[out++] = mix(a, b, da / (da - db));
+        }
+        std::copy(scratch, scratch + out, polygon);
+        count = out;
+    }
+    return count;
+}
+
+// One 8x8 block of a tile. Edge values are at the block's first pixel
+// center; an edge the whole block is inside of has all zeros.
+struct BlockSetup {
+    int32_t e[3];
+    int32_t dx[3], dy[3]; // per pixel right and up
+    bool testEdges;       // false when the block is inside all three
+    float z, zdx, zdy;
+    uint32_t id;
+};
+
+// Depth-tests the block and stores the nearer triangle's id; `farthest`
+// is updated to the block's new farthest depth when anything was written
+bool rasterizeBlock(const BlockSetup& s, float* depth, uint32_t* ids, float& farthest) {
+    bool written = false;
+    float blockFar = 0.0f;
+    for (int y = 0; y < BlockSize; ++y) {
+        float* depthRow = depth + y * TileSize;
+        uint32_t* idRow = ids + y * TileSize;
+        const float zRow = s.z + static_cast<float>(y) * s.zdy;
+        for (int x = 0; x < BlockSize; ++x) {
+            bool inside = true;
+            for (int i = 0; s.testEdges && i < 3; ++i)
+                inside = inside && s.e[i] + y * s.dy[i] + x * s.dx[i] >= 0;
+            const float z = zRow + static_cast<float>(x) * s.zdx;
+            if (inside && z < depthRow[x]) {
+                depthRow[x] = z;
+                idRow[x] = s.id;
+                written = true;
+            }
+            blockFar = std::max(blockFar, depthRow[x]);
+        }
+    }
+    if (written)
+        farthest = blockFar;
+    return written;
+}
+
+#ifdef SOFTWARE_RASTERIZER_AVX2
+// rasterizeBlock() a row of eight pixels at a time, with the same arithmetic
+TARGET_AVX2 bool rasterizeBlockAvx2(const BlockSetup& s, float* depth, uint32_t* ids, float& farthest) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zStep = _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(s.zdx));
+    const __m256 id = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(s.id)));
+    __m256i e[3], dy[3];
+    for (int i = 0; i < 3; ++i) {
+        e[i] = _mm256_add_epi32(_mm256_set1_epi32(s.e[i]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(s.dx[i])));
+        dy[i] = _mm256_set1_epi32(s.dy[i]);
+    }
+
+    int written = 0;
+    __m256 blockFar = _mm256_setzero_ps();
+    for (int y = 0; y < BlockSize; ++y) {
+        float* depthRow = depth + y * TileSize;
+        float* idRow = reinterpret_cast<float*>(ids + y * TileSize);
+        const float zRow = s.z + static_cast<float>(y) * s.zdy;
+        const __m256 z = _mm256_add_ps(_mm256_set1_ps(zRow), zStep);
+        __m256 d = _mm256_loadu_ps(depthRow);
+        __m256 pass = _mm256_cmp_ps(z, d, _CMP_LT_OQ);
+        if (s.testEdges) {
+            // The sign bit of the OR is set when any edge is negative
+            const __m256i outside = _mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(e[0], e[1]), e[2]), 31);
+            pass = _mm256_andnot_ps(_mm256_castsi256_ps(outside), pass);
+            for (int i = 0; i < 3; ++i)
+                e[i] = _mm256_add_epi32(e[i], dy[i]);
+        }
+        const int mask = _mm256_movemask_ps(pass);
+        if (mask) {
+            d = _mm256_blendv_ps(d, z, pass);
+            _mm256_storeu_ps(depthRow, d);
+            _mm256_storeu_ps(idRow, _mm256_blendv_ps(_mm256_loadu_ps(idRow), id, pass));
+            written |= mask;
+        }
+        blockFar = _mm256_max_ps(blockFar, d);
+    }
+    if (!written)
+        return false;
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(blockFar), _mm256_extractf128_ps(blockFar, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    farthest = _mm_cvtss_f32(m);
+    return true;
+}
+#endif
+
+double milliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+} // namespace
+
+std::shared_ptr<SoftwareTexture> SoftwareTexture::load(const std::string& path) {
+    std::vector<unsigned char> bytes;
+    Image image;
+    std::string error;
+    if (!readFileBytes(path, bytes)) {
+        std::cerr << "Failed to read texture " << path << std::endl;
+        return nullptr;
+    }
+    if (!decodeImage(bytes, image, error)) {
+        std::cerr << "Failed to decode texture " << path << ": " << error << std::endl;
+        return nullptr;
+    }
+    auto texture = std::make_shared<SoftwareTexture>();
+    texture->m_Levels = buildMipChain(std::move(image));
+    return texture;
+}
+
+glm::vec3 SoftwareTexture::bilinear(const Image& level, const glm::vec2& uv) const {
+    const float fx = uv.x * level.width - 0.5f, fy = uv.y * level.height - 0.5f;
+    const float x0f = std::floor(fx), y0f = std::floor(fy);
+    const float tx = fx - x0f, ty = fy - y0f;
+    auto wrap = [](int v, int size) { return ((v % size) + size) % size; };
+    const int x0 = wrap(static_cast<int>(x0f), level.width), x1 = wrap(x0 + 1, level.width);
+    const int y0 = wrap(static_cast<int>(y0f), level.height), y1 = wrap(y0 + 1, level.height);
+    auto texel = [&](int x, int y) {
+        const unsigned char* p = &level.pixels[(static_cast<size_t>(y) * level.width + x) * 4];
+        return glm::vec3(p[0], p[1], p[2]) * (1.0f / 255.0f);
+    };
+    const glm::vec3 bottom = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * tx;
+    const glm::vec3 top = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * tx;
+    return bottom + (top - bottom) * ty;
+}
+
+glm::vec3 SoftwareTexture::sample(const glm::vec2& uv, float lod) const {
+    if (m_Levels.empty())
+        return glm::vec3(1.0f);
+    // GL_LINEAR when magnified, GL_LINEAR_MIPMAP_LINEAR otherwise
+    if (!(lod > 0.0f))
+        return bilinear(m_Levels[0], uv);
+    const float level = std::min(lod, static_cast<float>(m_Levels.size() - 1));
+    const size_t fine = static_cast<size_t>(level);
+    const size_t coarse = std::min(fine + 1, m_Levels.size() - 1);
+    const glm::vec3 a = bilinear(m_Levels[fine], uv);
+    return a + (bilinear(m_Levels[coarse], uv) - a) * (level - static_cast<float>(fine));
+}
+
+struct SoftwareRasterizer::Triangle {
+    int64_t c[3];               // edge constants with the fill rule applied
+    int32_t a[3], b[3];         // edge slopes per subpixel; edge i is opposite vertex i
+    int minX, minY, maxX, maxY; // pixels whose centers may be covered
+    float zMin;
+    float x0, y0;               // vertex 0 in pixels
+    float z0, zdx, zdy;         // window depth
+    float l1dx, l1dy, l2dx, l2dy; // screen-space weights of vertices 1 and 2
+    float invW[3];
+    glm::vec3 world[3];
+    glm::vec3 normal[3];
+    glm::vec2 uv[3];
+    uint32_t draw;
+};
+
+struct SoftwareRasterizer::Chunk {
+    uint32_t index = 0;
+    uint32_t draw = 0;
+    size_t first = 0, count = 0; // triangles of the draw
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<uint16_t>> bins; // per tile, indices into triangles
+    size_t culled = 0, clipped = 0, binned = 0;
+};
+
+struct SoftwareRasterizer::TileStats {
+    size_t tilesRejected = 0, blocksRejected = 0, blocksRasterized = 0, pixelsShaded = 0;
+};
+
+SoftwareRasterizer::SoftwareRasterizer(ThreadPool& pool, int width, int height) :
+m_Pool(pool),
+m_UseAvx2(cpuHasAvx2())
+{
+    resize(width, height);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() = default;
+
+bool SoftwareRasterizer::cpuHasAvx2() {
+#ifdef SOFTWARE_RASTERIZER_AVX2
+#ifdef _MSC_VER
+    static const bool supported = [] {
+        int info[4];
+        __cpuid(info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5));
+    }();
+    return supported;
+#else
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#endif
+#else
+    return false;
+#endif
+}
+
+void SoftwareRasterizer::resize(int width, int height) {
+    if (width > MaxSize || height > MaxSize)
+        std::cerr << "SoftwareRasterizer: " << width << "x" << height << " clamped to " << MaxSize << std::endl;
+    m_Width = std::clamp(width, 1, MaxSize);
+    m_Height = std::clamp(height, 1, MaxSize);
+    m_TilesX = (m_Width + TileSize - 1) / TileSize;
+    m_TilesY = (m_Height + TileSize - 1) / TileSize;
+    m_Color.assign(static_cast<size_t>(m_Width) * m_Height * 4, 0);
+    m_Depth.assign(static_cast<size_t>(m_TilesX) * m_TilesY * TileSize * TileSize, 1.0f);
+}
+
+void SoftwareRasterizer::clear(const glm::vec3& color) {
+    uint8_t rgba[4] = {255, 255, 255, 255};
+    for (int c = 0; c < 3; ++c)
+        rgba[c] = static_cast<uint8_t>(std::clamp(color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+    for (size_t i = 0; i < m_Color.size(); i += 4)
+        std::memcpy(&m_Color[i], rgba, 4);
+    std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+    m_Draws.clear();
+    m_Stats = Stats();
+}
+
+void SoftwareRasterizer::drawTriangles(const float* vertices, size_t vertexCount, const Material& material) {
+    if (vertexCount < 3)
+        return;
+    Draw draw;
+    draw.vertices = vertices;
+    draw.vertexCount = vertexCount;
+    draw.material = material;
+    draw.uniforms = m_Uniforms;
+    draw.modelViewProjection = m_Uniforms.projection * m_Uniforms.view * m_Uniforms.model;
+    draw.normalMatrix = glm::mat3(glm::transpose(glm::inverse(m_Uniforms.model)));
+    m_Draws.push_back(draw);
+}
+
+void SoftwareRasterizer::finish() {
+    if (m_Draws.empty())
+        return;
+
+    // Fixed-size runs of triangles, each set up and binned on its own
+    const size_t tileCount = static_cast<size_t>(m_TilesX) * m_TilesY;
+    m_ChunkCount = 0;
+    for (size_t d = 0; d < m_Draws.size(); ++d) {
+        const size_t triangles = m_Draws[d].vertexCount / 3;
+        m_Stats.triangles += triangles;
+        for (size_t first = 0; first < triangles; first += ChunkTriangles) {
+            if (m_ChunkCount == m_Chunks.size())
+                m_Chunks.push_back(std::make_unique<Chunk>());
+            Chunk& chunk = *m_Chunks[m_ChunkCount];
+            chunk.index = static_cast<uint32_t>(m_ChunkCount++);
+            chunk.draw = static_cast<uint32_t>(d);
+            chunk.first = first;
+            chunk.count = std::min(ChunkTriangles, triangles - first);
+            chunk.bins.resize(tileCount);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    m_Pool.parallelFor(m_ChunkCount, 1, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            setupChunk(*m_Chunks[i]);
+    });
+    const auto binned = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < m_ChunkCount; ++i) {
+        m_Stats.culled += m_Chunks[i]->culled;
+        m_Stats.clipped += m_Chunks[i]->clipped;
+        m_Stats.binned += m_Chunks[i]->binned;
+    }
+
+    std::vector<TileStats> tileStats(tileCount);
+    m_Pool.parallelFor(tileCount, 1, [this, &tileStats](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; ++tile)
+            rasterTile(tile, tileStats[tile]);
+    });
+    for (const TileStats& stats : tileStats) {
+        m_Stats.tilesRejected += stats.tilesRejected;
+        m_Stats.blocksRejected += stats.blocksRejected;
+        m_Stats.blocksRasterized += stats.blocksRasterized;
+        m_Stats.pixelsShaded += stats.pixelsShaded;
+    }
+    m_Stats.geometryTime += milliseconds(binned - start);
+    m_Stats.rasterTime += milliseconds(std::chrono::steady_clock::now() - binned);
+    m_Draws.clear();
+}
+
+void SoftwareRasterizer::setupChunk(Chunk& chunk) {
+    chunk.triangles.clear();
+    for (auto& bin : chunk.bins)
+        bin.clear();
+    chunk.culled = chunk.clipped = chunk.binned = 0;
+
+    const Draw& draw = m_Draws[chunk.draw];
+    const float halfWidth = 0.5f * m_Width, halfHeight = 0.5f * m_Height;
+
+    // Window coordinates, then everything raster and shading need
+    auto emit = [&](const ClipVertex* v0, const ClipVertex* v1, const ClipVertex* v2) {
+        const ClipVertex* v[3] = {v0, v1, v2};
+        int64_t x[3], y[3];
+        float z[3], invW[3];
+        for (int k = 0; k < 3; ++k) {
+            if (!(v[k]->clip.w > 0.0f))
+                return false;
+            invW[k] = 1.0f / v[k]->clip.w;
+            x[k] = std::llround((v[k]->clip.x * invW[k] + 1.0f) * halfWidth * Subpixels);
+            y[k] = std::llround((v[k]->clip.y * invW[k] + 1.0f) * halfHeight * Subpixels);
+            z[k] = v[k]->clip.z * invW[k] * 0.5f + 0.5f;
+        }
+        int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area == 0)
+            return false;
+        // Both faces are drawn, as in the viewer; raster wants them counter-clockwise
+        if (area < 0) {
+            std::swap(v[1], v[2]);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            std::swap(invW[1], invW[2]);
+            area = -area;
+        }
+
+        // Pixels (px, py) sample at ((px + 0.5) * 16, (py + 0.5) * 16)
+        const int64_t half = Subpixels / 2;
+        const int64_t minX = std::min({x[0], x[1], x[2]}), maxX = std::max({x[0], x[1], x[2]});
+        const int64_t minY = std::min({y[0], y[1], y[2]}), maxY = std::max({y[0], y[1], y[2]});
+        Triangle t;
+        t.minX = static_cast<int>(std::max<int64_t>((minX - half + Subpixels - 1) >> SubpixelBits, 0));
+        t.minY = static_cast<int>(std::max<int64_t>((minY - half + Subpixels - 1) >> SubpixelBits, 0));
+        t.maxX = static_cast<int>(std::min<int64_t>((maxX - half) >> SubpixelBits, m_Width - 1));
+        t.maxY = static_cast<int>(std::min<int64_t>((maxY - half) >> SubpixelBits, m_Height - 1));
+        if (t.minX > t.maxX || t.minY > t.maxY)
+            return false;
+
+        for (int k = 0; k < 3; ++k) {
+            const int i = (k + 1) % 3, j = (k + 2) % 3;
+            t.a[k] = static_cast<int32_t>(y[i] - y[j]);
+            t.b[k] = static_cast<int32_t>(x[j] - x[i]);
+            t.c[k] = x[i] * y[j] - y[i] * x[j];
+            // Top-left rule: a pixel center exactly on an edge belongs to
+            // the triangle only when the edge is a left or top edge
+            const bool topLeft = t.a[k] > 0 || (t.a[k] == 0 && t.b[k] < 0);
+            if (!topLeft)
+                t.c[k] -= 1;
+        }
+
+        // Weights of vertices 1 and 2 and depth as planes around vertex 0, in pixels
+        const double scale = 1.0 / Subpixels;
+        const double e1x = (x[1] - x[0]) * scale, e1y = (y[1] - y[0]) * scale;
+        const double e2x = (x[2] - x[0]) * scale, e2y = (y[2] - y[0]) * scale;
+        const double det = e1x * e2y - e2x * e1y;
+        t.l1dx = static_cast<float>(e2y / det);
+        t.l1dy = static_cast<float>(-e2x / det);
+        t.l2dx = static_cast<float>(-e1y / det);
+        t.l2dy = static_cast<float>(e1x / det);
+        t.x0 = static_cast<float>(x[0] * scale);
+        t.y0 = static_cast<float>(y[0] * scale);
+        t.z0 = z[0];
+        t.zdx = t.l1dx * (z[1] - z[0]) + t.l2dx * (z[2] - z[0]);
+        t.zdy = t.l1dy * (z[1] - z[0]) + t.l2dy * (z[2] - z[0]);
+        t.zMin = std::min({z[0], z[1], z[2]});
+        for (int k = 0; k < 3; ++k) {
+            t.invW[k] = invW[k];
+            t.world[k] = v[k]->world;
+            t.normal[k] = v[k]->normal;
+            t.uv[k] = v[k]->uv;
+        }
+        t.draw = chunk.draw;
+
+        const uint16_t index = static_cast<uint16_t>(chunk.triangles.size());
+        chunk.triangles.push_back(t);
+        for (int ty = t.minY / TileSize; ty <= t.maxY / TileSize; ++ty) {
+            for (int tx = t.minX / TileSize; tx <= t.maxX / TileSize; ++tx) {
+                chunk.bins[static_cast<size_t>(ty) * m_TilesX + tx].push_back(index);
+                ++chunk.binned;
+            }
+        }
+        return true;
+    };
+
+    // default.vert: world position, normal through the normal matrix, clip position
+    const float* vertices = draw.vertices + chunk.first * 3 * 8;
+    ClipVertex polygon[9];
+    for (size_t n = 0; n < chunk.count; ++n) {
+        int all = 0x3f, any = 0;
+        for (int k = 0; k < 3; ++k) {
+            const float* p = vertices + (n * 3 + k) * 8;
+            const glm::vec4 position(p[0], p[1], p[2], 1.0f);
+            ClipVertex& v = polygon[k];
+            v.world = glm::vec3(draw.uniforms.model * position);
+            v.clip = draw.modelViewProjection * position;
+            v.normal = draw.normalMatrix * glm::vec3(p[3], p[4], p[5]);
+            v.uv = glm::vec2(p[6], p[7]);
+            const int code = outcode(v.clip);
+            all &= code;
+            any |= code;
+        }
+        if (all) {
+            ++chunk.culled;
+            continue;
+        }
+
+        bool drawn = false;
+        if (!any) {
+            drawn = emit(&polygon[0], &polygon[1], &polygon[2]);
+        } else {
+            ++chunk.clipped;
+            const int count = clipPolygon(polygon, 3, any);
+            for (int i = 1; i + 1 < count; ++i)
+                drawn = emit(&polygon[0], &polygon[i], &polygon[i + 1]) || drawn;
+        }
+        if (!drawn)
+            ++chunk.culled;
+    }
+}
+
+void SoftwareRasterizer::rasterTile(size_t tile, TileStats& stats) {
+    const int originX = static_cast<int>(tile % m_TilesX) * TileSize;
+    const int originY = static_cast<int>(tile / m_TilesX) * TileSize;
+    float* depth = &m_Depth[tile * TileSize * TileSize];
+    uint32_t ids[TileSize * TileSize];
+    std::fill(ids, ids + TileSize * TileSize, NoTriangle);
+
+    // Farthest depth per block and for the whole tile: a triangle whose
+    // nearest vertex is at or behind it cannot pass the depth test there
+    float blockFar[BlocksPerTile * BlocksPerTile];
+    for (int by = 0; by < BlocksPerTile; ++by) {
+        for (int bx = 0; bx < BlocksPerTile; ++bx) {
+            float farthest = 0.0f;
+            for (int y = 0; y < BlockSize; ++y) {
+                const float* row = depth + (by * BlockSize + y) * TileSize + bx * BlockSize;
+                farthest = std::max(farthest, *std::max_element(row, row + BlockSize));
+            }
+            blockFar[by * BlocksPerTile + bx] = farthest;
+        }
+    }
+    float tileFar = *std::max_element(blockFar, blockFar + BlocksPerTile * BlocksPerTile);
+
+#ifdef SOFTWARE_RASTERIZER_AVX2
+    const auto rasterize = m_UseAvx2 ? &rasterizeBlockAvx2 : &rasterizeBlock;
+#else
+    const auto rasterize = &rasterizeBlock;
+#endif
+
+    for (size_t c = 0; c < m_ChunkCount; ++c) {
+        const Chunk& chunk = *m_Chunks[c];
+        for (uint16_t index : chunk.bins[tile]) {
+            const Triangle& t = chunk.triangles[index];
+            if (t.zMin >= tileFar) {
+                ++stats.tilesRejected;
+                continue;
+            }
+            const int bx0 = (std::max(t.minX, originX) - originX) / BlockSize;
+            const int bx1 = (std::min(t.maxX, originX + TileSize - 1) - originX) / BlockSize;
+            const int by0 = (std::max(t.minY, originY) - originY) / BlockSize;
+            const int by1 = (std::min(t.maxY, originY + TileSize - 1) - originY) / BlockSize;
+            bool changed = false;
+            for (int by = by0; by <= by1; ++by) {
+                for (int bx = bx0; bx <= bx1; ++bx) {
+                    float& farthest = blockFar[by * BlocksPerTile + bx];
+                    if (t.zMin >= farthest) {
+                        ++stats.blocksRejected;
+                        continue;
+                    }
+
+                    // Edge values over the block's pixel centers span
+                    // [lo, hi]; only edges crossing it are tested per pixel
+                    const int px = originX + bx * BlockSize, py = originY + by * BlockSize;
+                    BlockSetup s;
+                    bool outside = false, inside = true;
+                    for (int i = 0; i < 3 && !outside; ++i) {
+                        const int64_t e = int64_t(t.a[i]) * (px * Subpixels + Subpixels / 2) +
+                                          int64_t(t.b[i]) * (py * Subpixels + Subpixels / 2) + t.c[i];
+                        const int64_t spanX = int64_t(t.a[i]) * Subpixels * (BlockSize - 1);
+                        const int64_t spanY = int64_t(t.b[i]) * Subpixels * (BlockSize - 1);
+                        const int64_t lo = e + std::min<int64_t>(spanX, 0) + std::min<int64_t>(spanY, 0);
+                        const int64_t hi = e + std::max<int64_t>(spanX, 0) + std::max<int64_t>(spanY, 0);
+                        if (hi < 0) {
+                            outside = true;
+                        } else if (lo >= 0) {
+                            s.e[i] = s.dx[i] = s.dy[i] = 0;
+                        } else {
+                            inside = false;
+                            s.e[i] = static_cast<int32_t>(e); // |e| < span, well inside 32 bits
+                            s.dx[i] = t.a[i] * Subpixels;
+                            s.dy[i] = t.b[i] * Subpixels;
+                        }
+                    }
+                    if (outside)
+                        continue;
+                    s.testEdges = !inside;
+                    s.z = t.z0 + t.zdx * (px + 0.5f - t.x0) + t.zdy * (py + 0.5f - t.y0);
+                    s.zdx = t.zdx;
+                    s.zdy = t.zdy;
+                    s.id = (chunk.index << IndexBits) | index;
+                    ++stats.blocksRasterized;
+                    const size_t offset = static_cast<size_t>(by * BlockSize) * TileSize + bx * BlockSize;
+                    changed = rasterize(s, depth + offset, ids + offset, farthest) || changed;
+                }
+            }
+            if (changed)
+                tileFar = *std::max_element(blockFar, blockFar + BlocksPerTile * BlocksPerTile);
+        }
+    }
+
+    // Shade each covered pixel once, with the triangle that won it
+    const int width = std::min(TileSize, m_Width - originX), height = std::min(TileSize, m_Height - originY);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = &m_Color[(static_cast<size_t>(originY + y) * m_Width + originX) * 4];
+        for (int x = 0; x < width; ++x) {
+            const uint32_t id = ids[y * TileSize + x];
+            if (id == NoTriangle)
+                continue;
+            const Triangle& t = m_Chunks[id >> IndexBits]->triangles[id & ((1u << IndexBits) - 1)];
+            const uint32_t color = shade(t, originX + x + 0.5f, originY + y + 0.5f);
+            std::memcpy(row + x * 4, &color, 4);
+            ++stats.pixelsShaded;
+        }
+    }
+}
+
+// default.frag with lighting.glsl, at pixel center (x, y)
+uint32_t SoftwareRasterizer::shade(const Triangle& t, float x, float y) const {
+    const Draw& draw = m_Draws[t.draw];
+    const Uniforms& uniforms = draw.uniforms;
+
+    // Perspective-correct weights
+    auto weights = [&t](float px, float py) {
+        const float dx = px - t.x0, dy = py - t.y0;
+        const float l1 = t.l1dx * dx + t.l1dy * dy, l2 = t.l2dx * dx + t.l2dy * dy;
+        glm::vec3 w((1.0f - l1 - l2) * t.invW[0], l1 * t.invW[1], l2 * t.invW[2]);
+        return w / (w.x + w.y + w.z);
+    };
+    const glm::vec3 w = weights(x, y);
+    const glm::vec3 fragPos = t.world[0] * w.x + t.world[1] * w.y + t.world[2] * w.z;
+    const glm::vec3 normal = t.normal[0] * w.x + t.normal[1] * w.y + t.normal[2] * w.z;
+
+    glm::vec3 color;
+    if (const SoftwareTexture* map = draw.material.diffuseMap) {
+        auto uvAt = [&t](const glm::vec3& weight) { return t.uv[0] * weight.x + t.uv[1] * weight.y + t.uv[2] * weight.z; };
+        const glm::vec2 uv = uvAt(w);
+        // The texel footprint from the neighbouring pixels, as derivatives would
+        const glm::vec2 size(static_cast<float>(map->width()), static_cast<float>(map->height()));
+        const glm::vec2 ddx = (uvAt(weights(x + 1.0f, y)) - uv) * size;
+        const glm::vec2 ddy = (uvAt(weights(x, y + 1.0f)) - uv) * size;
+        const float footprint = std::max(glm::dot(ddx, ddx), glm::dot(ddy, ddy));
+        const float lod = footprint > 0.0f ? 0.5f * std::log2(footprint) : 0.0f;
+        color = map->sample(uv, lod) * draw.material.diffuseColor;
+    } else {
+        const float time = uniforms.time;
+        color = glm::vec3(0.5f + 0.5f * std::cos(time + fragPos.x), 0.5f + 0.5f * std::cos(time + fragPos.y + 2.0f),
+                          0.5f + 0.5f * std::cos(time + fragPos.x + 4.0f));
+    }
+
+    static const glm::vec3 lightDir = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+    const float length = glm::length(normal);
+    const glm::vec3 n = length > 0.0f ? normal / length : normal;
+    const float diff = std::max(glm::dot(n, lightDir), 0.0f);
+    glm::vec3 result = color * (0.1f + diff);
+    if (uniforms.blinnPhong && diff > 0.0f) {
+        const glm::vec3 halfway = glm::normalize(lightDir + glm::normalize(uniforms.viewPos - fragPos));
+        result += glm::vec3(0.4f * std::pow(std::max(glm::dot(n, halfway), 0.0f), 32.0f));
+    }
+
+    uint8_t rgba[4] = {0, 0, 0, 255};
+    for (int c = 0; c < 3; ++c)
+        rgba[c] = static_cast<uint8_t>(std::clamp(result[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+    uint32_t packed;
+    std::memcpy(&packed, rgba, 4);
+    return packed;
+}
+
+Image SoftwareRasterizer::image() const {
+    Image image;
+    image.width = m_Width;
+    image.height = m_Height;
+    image.pixels = m_Color;
+    return image;
+}
@@ -0,0 +1,252 @@
+#include "Texture.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+
+Texture::Texture(std::string path) : m_Path(std::move(path)) {}
+
+Texture::~Texture() = default;
+
+GLuint Texture::id() const {
+    if (m_Alias)
+        return m_Alias->id();
+    return m_BaseLevel < m_LevelCount ? m_ID.id() : 0;
+}
+
+bool Texture::isComplete() const {
+    if (m_Alias)
+        return m_Alias->isComplete();
+    return m_ID != 0 && m_BaseLevel == 0;
+}
+
+PixelUploadRing::PixelUploadRing(size_t slotCount) : m_Slots(slotCount) {}
+
+PixelUploadRing::~PixelUploadRing() {
+    for (auto& slot : m_Slots) {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+    }
+}
+
+void PixelUploadRing::upload(GLint level, const TextureLevel& data, BlockFormat format) {
+    const size_t size = data.data.size();
+    Slot& slot = m_Slots[m_Next];
+    m_Next = (m_Next + 1) % m_Slots.size();
+
+    // The GPU has normally consumed this slot a couple of frames ago, so
+    // the wait is a formality; it only blocks if uploads outrun the GPU.
+    if (slot.fence) {
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    if (!slot.buffer)
+        slot.buffer.create("PixelUploadRing staging", GL_HERE);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    if (slot.capacity < size) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        slot.capacity = size;
+        slot.buffer.setBytes(size);
+    }
+
+    auto define = [&](const void* pixels) {
+        if (format == BlockFormat::RGBA8)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, data.width, data.height, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, blockFormatGLEnum(format), data.width, data.height, 0,
+                                   static_cast<GLsizei>(size), pixels);
+    };
+
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (dst) {
+        std::memcpy(dst, data.data.data(), size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        define(nullptr); // reads from offset 0 of the bound unpack buffer
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!dst) // mapping failed: fall back to a plain synchronous upload
+        define(data.data.data());
+}
+
+TextureCache::TextureCache(ThreadPool& pool, std::string compressedCacheDir) :
+m_Pool(pool),
+m_CompressedCacheDir(std::move(compressedCacheDir)),
+m_Support(CompressionSupport::query())
+{
+    if (!m_Support.bc7 && !m_Support.bc1bc3)
+        m_CompressedCacheDir.clear(); // nothing worth encoding to
+}
+
+static std::string cacheFileName(const std::string& dir, uint64_t hash, BlockFormat format) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx.%s.ktx2", static_cast<unsigned long long>(hash),
+                  blockFormatName(format));
+    return (std::filesystem::path(dir) / name).string();
+}
+
+static double mebibytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+std::shared_ptr<Texture> TextureCache::acquire(const std::string& path) {
+    const std::string key = std::filesystem::path(path).lexically_normal().generic_string();
+
+    auto found = m_ByPath.find(key);
+    if (found != m_ByPath.end()) {
+        if (auto texture = found->second.lock())
+            return texture;
+    }
+
+    auto texture = std::make_shared<Texture>(key);
+    m_ByPath[key] = texture;
+    m_Decoding.push_back({texture, m_Pool.submit([key, pool = &m_Pool, dir = m_CompressedCacheDir,
+                                                  support = m_Support]() {
+        Decoded decoded;
+        std::vector<unsigned char> bytes;
+        if (!readFileBytes(key, bytes)) {
+            decoded.error = "cannot open file";
+            return decoded;
+        }
+        decoded.hash = hashBytes(bytes.data(), bytes.size());
+
+        // Any previously transcoded chain the driver can use skips decoding entirely
+        if (!dir.empty()) {
+            for (BlockFormat format : {BlockFormat::BC7, BlockFormat::BC1, BlockFormat::BC3}) {
+                if (format == BlockFormat::BC7 ? !support.bc7 : !support.bc1bc3)
+                    continue;
+                if (readTextureCache(cacheFileName(dir, decoded.hash, format), decoded.hash,
+                                     decoded.format, decoded.levels)) {
+                    decoded.fromCache = true;
+                    return decoded;
+                }
+            }
+        }
+
+        Image base;
+        if (!decodeImage(bytes, base, decoded.error))
+            return decoded;
+        decoded.format = dir.empty() ? BlockFormat::RGBA8 : chooseBlockFormat(base, support);
+
+        for (Image& mip : buildMipChain(std::move(base))) {
+            TextureLevel level;
+            level.width = mip.width;
+            level.height = mip.height;
+            level.data = decoded.format == BlockFormat::RGBA8 ? std::move(mip.pixels)
+                                                              : compressImage(mip, decoded.format, pool);
+            decoded.levels.push_back(std::move(level));
+        }
+
+        if (decoded.format != BlockFormat::RGBA8) {
+            std::error_code ignored;
+            std::filesystem::create_directories(dir, ignored);
+            writeTextureCache(cacheFileName(dir, decoded.hash, decoded.format), decoded.format,
+                              decoded.hash, decoded.levels);
+        }
+        return decoded;
+    })});
+    return texture;
+}
+
+void TextureCache::beginUpload(const std::shared_ptr<Texture>& texture, Decoded decoded) {
+    if (!decoded.error.empty()) {
+        std::cerr << "Failed to load texture " << texture->m_Path << ": " << decoded.error << std::endl;
+        texture->m_Failed = true;
+        return;
+    }
+
+    auto existing = m_ByHash.find(decoded.hash);
+    if (existing != m_ByHash.end()) {
+        if (auto shared = existing->second.lock()) {
+            texture->m_Alias = shared;
+            return;
+        }
+    }
+    m_ByHash[decoded.hash] = texture;
+
+    texture->m_Format = decoded.format;
+    texture->m_Levels = std::move(decoded.levels);
+    texture->m_LevelCount = static_cast<int>(texture->m_Levels.size());
+    texture->m_BaseLevel = texture->m_LevelCount;
+
+    // Levels are defined by update(); until then nothing may be sampled
+    texture->m_ID.create(texture->m_Path, GL_HERE);
+    glBindTexture(GL_TEXTURE_2D, texture->m_ID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture->m_LevelCount - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    size_t bytes = 0, uncompressed = 0;
+    for (const auto& level : texture->m_Levels) {
+        bytes += level.data.size();
+        uncompressed += levelByteSize(BlockFormat::RGBA8, level.width, level.height);
+    }
+    std::cout << "Texture " << texture->m_Path << ": " << blockFormatName(texture->m_Format) << " "
+              << texture->m_Levels[0].width << "x" << texture->m_Levels[0].height << ", "
+              << mebibytes(bytes) << " MiB (RGBA8: " << mebibytes(uncompressed) << " MiB)"
+              << (decoded.fromCache ? " [cached]" : "") << std::endl;
+
+    m_Uploading.push_back(texture);
+}
+
+void TextureCache::update(size_t budgetBytes) {
+    for (auto it = m_Decoding.begin(); it != m_Decoding.end();) {
+        if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        beginUpload(it->texture, it->result.get());
+        it = m_Decoding.erase(it);
+    }
+
+    size_t uploaded = 0;
+    while (!m_Uploading.empty() && (uploaded == 0 || uploaded < budgetBytes)) {
+        Texture& texture = *m_Uploading.front();
+        const int level = texture.m_BaseLevel - 1;
+        TextureLevel& data = texture.m_Levels[level];
+
+        glBindTexture(GL_TEXTURE_2D, texture.m_ID);
+        m_Uploads.upload(level, data, texture.m_Format);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        uploaded += data.data.size();
+        texture.m_ID.setBytes(texture.m_ID.bytes() + data.data.size());
+        texture.m_UncompressedBytes += levelByteSize(BlockFormat::RGBA8, data.width, data.height);
+        data = TextureLevel();
+        texture.m_BaseLevel = level;
+        if (level == 0) {
+            texture.m_Levels.clear();
+            m_Uploading.erase(m_Uploading.begin());
+        }
+    }
+
+    // Totals over the textures still alive: the last owner of a texture
+    // frees its GL storage. Textures with GL storage are exactly the
+    // entries of m_ByHash (aliases own none)
+    m_ResidentBytes = m_UncompressedBytes = 0;
+    for (auto it = m_ByHash.begin(); it != m_ByHash.end();) {
+        if (auto texture = it->second.lock()) {
+            m_ResidentBytes += texture->m_ID.bytes();
+            m_UncompressedBytes += texture->m_UncompressedBytes;
+            ++it;
+        } else {
+            it = m_ByHash.erase(it);
+        }
+    }
+    for (auto it = m_ByPath.begin(); it != m_ByPath.end();)
+        it = it->second.expired() ? m_ByPath.erase(it) : std::next(it);
+}
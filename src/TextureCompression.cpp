@@ -0,0 +1,531 @@
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHADERVIEWER_SSE2 1
+#endif
+
+const char* blockFormatName(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1: return "BC1";
+    case BlockFormat::BC3: return "BC3";
+    case BlockFormat::BC5: return "BC5";
+    case BlockFormat::BC7: return "BC7";
+    default: return "RGBA8";
+    }
+}
+
+GLenum blockFormatGLEnum(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default: return GL_RGBA8;
+    }
+}
+
+static size_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t levelByteSize(BlockFormat format, int width, int height) {
+    if (format == BlockFormat::RGBA8)
+        return static_cast<size_t>(width) * height * 4;
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+CompressionSupport CompressionSupport::query() {
+    CompressionSupport support;
+    support.bc5 = true;
+
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    support.bc7 = major > 4 || (major == 4 && minor >= 2);
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (!name)
+            continue;
+        if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            support.bc1bc3 = true;
+        else if (std::strcmp(name, "GL_ARB_texture_compression_bptc") == 0)
+            support.bc7 = true;
+    }
+    return support;
+}
+
+BlockFormat chooseBlockFormat(const Image& image, const CompressionSupport& support) {
+    if (support.bc7)
+        return BlockFormat::BC7;
+    if (!support.bc1bc3)
+        return BlockFormat::RGBA8;
+    for (size_t i = 3; i < image.pixels.size(); i += 4) {
+        if (image.pixels[i] != 255)
+            return BlockFormat::BC3;
+    }
+    return BlockFormat::BC1;
+}
+
+namespace {
+
+// 4x4 texels stored channel-major so four texels fit one SSE register
+struct Block {
+    float c[4][16];
+};
+
+void fetchBlock(const Image& image, int bx, int by, Block& block) {
+    for (int y = 0; y < 4; ++y) {
+        const int sy = std::min(by * 4 + y, image.height - 1);
+        for (int x = 0; x < 4; ++x) {
+            const int sx = std::min(bx * 4 + x, image.width - 1);
+            const unsigned char* p = &image.pixels[(static_cast<size_t>(sy) * image.width + sx) * 4];
+            for (int c = 0; c < 4; ++c)
+                block.c[c][y * 4 + x] = p[c];
+        }
+    }
+}
+
+// Projects every texel onto the e0->e1 segment over channels
+// [first, first + count) and quantizes to `levels` evenly spaced steps.
+void projectIndices(const Block& block, int first, int count, const float* e0, const float* e1,
+                    int levels, int* indices) {
+    float d[4] = {};
+    float lengthSq = 0.0f;
+    for (int c = 0; c < count; ++c) {
+        d[c] = e1[c] - e0[c];
+        lengthSq += d[c] * d[c];
+    }
+    if (lengthSq < 1e-6f) {
+        std::fill(indices, indices + 16, 0);
+        return;
+    }
+    const float scale = (levels - 1) / lengthSq;
+
+#ifdef SHADERVIEWER_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 maxLevel = _mm_set1_ps(static_cast<float>(levels - 1));
+    for (int i = 0; i < 16; i += 4) {
+        __m128 t = zero;
+        for (int c = 0; c < count; ++c) {
+            __m128 v = _mm_sub_ps(_mm_loadu_ps(&block.c[first + c][i]), _mm_set1_ps(e0[c]));
+            t = _mm_add_ps(t, _mm_mul_ps(v, _mm_set1_ps(d[c] * scale)));
+        }
+        t = _mm_min_ps(_mm_max_ps(t, zero), maxLevel);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), _mm_cvtps_epi32(t));
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < count; ++c)
+            t += (block.c[first + c][i] - e0[c]) * d[c] * scale;
+        indices[i] = static_cast<int>(std::lround(std::clamp(t, 0.0f, static_cast<float>(levels - 1))));
+    }
+#endif
+}
+
+// Endpoints along the principal axis of the texels (power iteration on the
+// covariance matrix), clamped to the 0..255 range.
+void principalEndpoints(const Block& block, int first, int count, float* e0, float* e1) {
+    float mean[4] = {}, lo[4], hi[4];
+    for (int c = 0; c < count; ++c) {
+        lo[c] = 255.0f;
+        hi[c] = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            const float v = block.c[first + c][i];
+            mean[c] += v;
+            lo[c] = std::min(lo[c], v);
+            hi[c] = std::max(hi[c], v);
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        for (int a = 0; a < count; ++a) {
+            const float da = block.c[first + a][i] - mean[a];
+            for (int b = a; b < count; ++b)
+                cov[a][b] += da * (block.c[first + b][i] - mean[b]);
+        }
+    }
+    for (int a = 0; a < count; ++a)
+        for (int b = 0; b < a; ++b)
+            cov[a][b] = cov[b][a];
+
+    float axis[4];
+    for (int c = 0; c < count; ++c)
+        axis[c] = hi[c] - lo[c];
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {}, length = 0.0f;
+        for (int a = 0; a < count; ++a) {
+            for (int b = 0; b < count; ++b)
+                next[a] += cov[a][b] * axis[b];
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < count; ++c)
+            axis[c] = next[c] / length;
+    }
+
+    float lengthSq = 0.0f;
+    for (int c = 0; c < count; ++c)
+        lengthSq += axis[c] * axis[c];
+    if (lengthSq < 1e-6f) { // flat block
+        for (int c = 0; c < count; ++c)
+            e0[c] = e1[c] = mean[c];
+        return;
+    }
+
+    float tMin = 1e30f, tMax = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < count; ++c)
+            t += (block.c[first + c][i] - mean[c]) * axis[c];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    for (int c = 0; c < count; ++c) {
+        e0[c] = std::clamp(mean[c] + axis[c] * tMin / lengthSq, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * tMax / lengthSq, 0.0f, 255.0f);
+    }
+}
+
+uint16_t packRGB565(const float* rgb) {
+    const int r = static_cast<int>(std::lround(rgb[0] * 31.0f / 255.0f));
+    const int g = static_cast<int>(std::lround(rgb[1] * 63.0f / 255.0f));
+    const int b = static_cast<int>(std::lround(rgb[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(uint16_t color, float* rgb) {
+    const int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = static_cast<float>((r << 3) | (r >> 2));
+    rgb[1] = static_cast<float>((g << 2) | (g >> 4));
+    rgb[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+void encodeBC1(const Block& block, unsigned char* out) {
+    float e0[3], e1[3];
+    principalEndpoints(block, 0, 3, e0, e1);
+
+    // Four-color mode requires color0 > color1
+    uint16_t c0 = packRGB565(e1), c1 = packRGB565(e0);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    uint32_t bits = 0;
+    if (c0 != c1) {
+        float q0[3], q1[3];
+        unpackRGB565(c0, q0);
+        unpackRGB565(c1, q1);
+        int levels[16];
+        projectIndices(block, 0, 3, q0, q1, 4, levels);
+        static const uint32_t remap[4] = {0, 2, 3, 1};
+        for (int i = 0; i < 16; ++i)
+            bits |= remap[levels[i]] << (2 * i);
+    }
+
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; ++i)
+        out[4 + i] = (bits >> (8 * i)) & 0xff;
+}
+
+void encodeBC4(const Block& block, int channel, unsigned char* out) {
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        lo = std::min(lo, block.c[channel][i]);
+        hi = std::max(hi, block.c[channel][i]);
+    }
+
+    // Eight-value mode requires a0 > a1
+    const int a0 = static_cast<int>(std::lround(hi));
+    const int a1 = static_cast<int>(std::lround(lo));
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+
+    uint64_t bits = 0;
+    if (a0 != a1) {
+        const float q0 = static_cast<float>(a0), q1 = static_cast<float>(a1);
+        int levels[16];
+        projectIndices(block, channel, 1, &q0, &q1, 8, levels);
+        for (int i = 0; i < 16; ++i) {
+            const int level = levels[i];
+            const uint64_t index = level == 0 ? 0 : level == 7 ? 1 : level + 1;
+            bits |= index << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = (bits >> (8 * i)) & 0xff;
+}
+
+void putBits(unsigned char* out, int& position, uint32_t value, int count) {
+    for (int i = 0; i < count; ++i, ++position) {
+        if (value & (1u << i))
+            out[position >> 3] |= static_cast<unsigned char>(1u << (position & 7));
+    }
+}
+
+// BC7 mode 6: one subset, RGBA endpoints at 7 bits plus a p-bit each, and
+// 4-bit indices. The single most useful mode for general color textures.
+void encodeBC7(const Block& block, unsigned char* out) {
+    float e[2][4];
+    principalEndpoints(block, 0, 4, e[0], e[1]);
+
+    int q[2][4], p[2];
+    float recon[2][4];
+    for (int end = 0; end < 2; ++end) {
+        float bestError = 1e30f;
+        for (int pbit = 0; pbit < 2; ++pbit) {
+            float error = 0.0f;
+            int candidate[4];
+            for (int c = 0; c < 4; ++c) {
+                candidate[c] = std::clamp(static_cast<int>(std::lround((e[end][c] - pbit) / 2.0f)), 0, 127);
+                const float diff = (candidate[c] * 2 + pbit) - e[end][c];
+                error += diff * diff;
+            }
+            if (error < bestError) {
+                bestError = error;
+                p[end] = pbit;
+                for (int c = 0; c < 4; ++c) {
+                    q[end][c] = candidate[c];
+                    recon[end][c] = static_cast<float>(candidate[c] * 2 + pbit);
+                }
+            }
+        }
+    }
+
+    int indices[16];
+    projectIndices(block, 0, 4, recon[0], recon[1], 16, indices);
+
+    // The anchor texel's index has an implicit zero top bit
+    if (indices[0] >= 8) {
+        std::swap(q[0], q[1]);
+        std::swap(p[0], p[1]);
+        for (int& index : indices)
+            index = 15 - index;
+    }
+
+    std::memset(out, 0, 16);
+    int position = 0;
+    putBits(out, position, 1u << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        putBits(out, position, q[0][c], 7);
+        putBits(out, position, q[1][c], 7);
+    }
+    putBits(out, position, p[0], 1);
+    putBits(out, position, p[1], 1);
+    putBits(out, position, indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        putBits(out, position, indices[i], 4);
+}
+
+} // namespace
+
+std::vector<unsigned char> compressImage(const Image& image, BlockFormat format, ThreadPool* pool) {
+    if (format == BlockFormat::RGBA8)
+        return image.pixels;
+
+    const int blocksX = (image.width + 3) / 4;
+    const int blocksY = (image.height + 3) / 4;
+    const size_t stride = blockBytes(format);
+    std::vector<unsigned char> out(static_cast<size_t>(blocksX) * blocksY * stride);
+
+    auto encodeRows = [&](size_t begin, size_t end) {
+        Block block;
+        for (size_t by = begin; by < end; ++by) {
+            for (int bx = 0; bx < blocksX; ++bx) {
+                fetchBlock(image, bx, static_cast<int>(by), block);
+                unsigned char* dst = &out[(by * blocksX + bx) * stride];
+                switch (format) {
+                case BlockFormat::BC1:
+                    encodeBC1(block, dst);
+                    break;
+                case BlockFormat::BC3:
+                    encodeBC4(block, 3, dst);
+                    encodeBC1(block, dst + 8);
+                    break;
+                case BlockFormat::BC5:
+                    encodeBC4(block, 0, dst);
+                    encodeBC4(block, 1, dst + 8);
+                    break;
+                case BlockFormat::BC7:
+                    encodeBC7(block, dst);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    };
+
+    // Roughly 4K blocks per task keeps scheduling overhead negligible
+    const size_t rowsPerTask = std::max<size_t>(1, 4096 / blocksX);
+    if (pool)
+        pool->parallelFor(blocksY, rowsPerTask, encodeRows);
+    else
+        encodeRows(0, blocksY);
+    return out;
+}
+
+namespace {
+
+const unsigned char kKtx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+const char kHashKey[] = "ShaderViewer.sourceHash";
+
+uint32_t vkFormat(BlockFormat format) {
+    switch (format) {
+    case BlockFormat::BC1: return 133; // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+    case BlockFormat::BC3: return 137; // VK_FORMAT_BC3_UNORM_BLOCK
+    case BlockFormat::BC5: return 141; // VK_FORMAT_BC5_UNORM_BLOCK
+    case BlockFormat::BC7: return 145; // VK_FORMAT_BC7_UNORM_BLOCK
+    default: return 37;                // VK_FORMAT_R8G8B8A8_UNORM
+    }
+}
+
+struct Ktx2Header {
+    unsigned char identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct Ktx2Level {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+bool writeTextureCache(const std::string& path, BlockFormat format, uint64_t sourceHash,
+                       const std::vector<TextureLevel>& levels) {
+    if (levels.empty())
+        return false;
+
+    // Key/value data: one entry holding the hash of the source image
+    std::vector<unsigned char> kvd;
+    const uint32_t entryLength = sizeof(kHashKey) + sizeof(sourceHash);
+    kvd.resize(alignUp(sizeof(entryLength) + entryLength, 4));
+    std::memcpy(&kvd[0], &entryLength, sizeof(entryLength));
+    std::memcpy(&kvd[4], kHashKey, sizeof(kHashKey));
+    std::memcpy(&kvd[4 + sizeof(kHashKey)], &sourceHash, sizeof(sourceHash));
+
+    Ktx2Header header = {};
+    std::memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+    header.vkFormat = vkFormat(format);
+    header.typeSize = 1;
+    header.pixelWidth = levels[0].width;
+    header.pixelHeight = levels[0].height;
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.kvdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2Level));
+    header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+    // As in KTX2, the smallest level is stored first
+    std::vector<Ktx2Level> index(levels.size());
+    size_t offset = header.kvdByteOffset + kvd.size();
+    for (size_t i = levels.size(); i-- > 0;) {
+        offset = alignUp(offset, 16);
+        index[i] = {offset, levels[i].data.size(), levels[i].data.size()};
+        offset += levels[i].data.size();
+    }
+
+    // Write to a temporary name so concurrent viewers never see partial files
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(Ktx2Level));
+        file.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+        for (size_t i = levels.size(); i-- > 0;) {
+            const size_t padding = index[i].byteOffset - static_cast<size_t>(file.tellp());
+            static const char zeros[16] = {};
+            file.write(zeros, padding);
+            file.write(reinterpret_cast<const char*>(levels[i].data.data()), levels[i].data.size());
+        }
+        if (!file)
+            return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool readTextureCache(const std::string& path, uint64_t sourceHash, BlockFormat& format,
+                      std::vector<TextureLevel>& levels) {
+    std::vector<unsigned char> bytes;
+    if (!readFileBytes(path, bytes) || bytes.size() < sizeof(Ktx2Header))
+        return false;
+
+    Ktx2Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0 ||
+        header.levelCount == 0 || header.levelCount > 32)
+        return false;
+
+    static const BlockFormat formats[] = {BlockFormat::RGBA8, BlockFormat::BC1, BlockFormat::BC3,
+                                          BlockFormat::BC5, BlockFormat::BC7};
+    const BlockFormat* found = std::find_if(std::begin(formats), std::end(formats),
+                                            [&](BlockFormat f) { return vkFormat(f) == header.vkFormat; });
+    if (found == std::end(formats))
+        return false;
+
+    // Stale entry if the source image changed since it was transcoded
+    const size_t hashOffset = header.kvdByteOffset + 4 + sizeof(kHashKey);
+    uint64_t storedHash = 0;
+    if (hashOffset + sizeof(storedHash) > bytes.size() ||
+        std::memcmp(&bytes[header.kvdByteOffset + 4], kHashKey, sizeof(kHashKey)) != 0)
+        return false;
+    std::memcpy(&storedHash, &bytes[hashOffset], sizeof(storedHash));
+    if (storedHash != sourceHash)
+        return false;
+
+    std::vector<Ktx2Level> index(header.levelCount);
+    if (sizeof(Ktx2Header) + index.size() * sizeof(Ktx2Level) > bytes.size())
+        return false;
+    std::memcpy(index.data(), &bytes[sizeof(Ktx2Header)], index.size() * sizeof(Ktx2Level));
+
+    levels.assign(header.levelCount, TextureLevel());
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        TextureLevel& level = levels[i];
+        level.width = std::max(1u, header.pixelWidth >> i);
+        level.height = std::max(1u, header.pixelHeight >> i);
+        if (index[i].byteLength != levelByteSize(*found, level.width, level.height) ||
+            index[i].byteOffset + index[i].byteLength > bytes.size())
+            return false;
+        level.data.assign(bytes.begin() + index[i].byteOffset,
+                          bytes.begin() + index[i].byteOffset + index[i].byteLength);
+    }
+    format = *found;
+    return true;
+}
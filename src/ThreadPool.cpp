@@ -0,0 +1,76 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        threadCount = std::max(1u, hw > 1 ? hw - 1 : 1u);
+    }
+    m_Workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i)
+        m_Workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+        // Drop work that never started; its futures report broken_promise
+        std::queue<std::function<void()>>().swap(m_Tasks);
+    }
+    m_Condition.notify_all();
+    for (auto& worker : m_Workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+            if (m_Stopping)
+                return;
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+    if (count == 0)
+        return;
+    grain = std::max<size_t>(grain, 1);
+    const size_t chunks = (count + grain - 1) / grain;
+
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto state = std::make_shared<State>();
+
+    // Helpers that start after every chunk was claimed exit without touching
+    // fn, so it is only referenced while this call is still waiting.
+    auto work = [state, chunks, count, grain, &fn]() {
+        for (size_t chunk; (chunk = state->next.fetch_add(1)) < chunks;) {
+            const size_t begin = chunk * grain;
+            fn(begin, std::min(count, begin + grain));
+            if (state->done.fetch_add(1) + 1 == chunks) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    const size_t helpers = std::min(m_Workers.size(), chunks - 1);
+    for (size_t i = 0; i < helpers; ++i)
+        submit(work);
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&] { return state->done.load() == chunks; });
+}
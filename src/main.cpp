@@ -34,21 +34,64 @@
 
 // Standard libraries for I/O and math
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 // Project headers
 #include "Camera.h"   // Provides view and projection matrices
+#include "ChunkedMesh.h" // Out-of-core mesh streamed from a chunk file
+#include "DynamicResolution.h" // Scales the scene resolution to hold a GPU time
+#include "FrameCapture.h" // Screenshots and video through async PBO readback
+#include "FrameScheduler.h" // Draws only when something changed, caps the rate
+#include "GLResource.h" // Tracks GL objects and the memory they hold
+#include "GLTrace.h" // Records GL calls for tools/glreplay
 #include "ObjModel.h" // Loads and draws a 3D .obj model
+#include "OcclusionCuller.h" // Frustum + Hi-Z occlusion culling
+#include "OverdrawView.h" // Overdraw / fragment-cost heatmap
+#include "Overlay.h"  // Stats panel (or window title without ImGui)
+#include "PointCloud.h" // Vertex-only OBJs drawn as points
+#include "RingBuffer.h" // Fenced per-frame regions for dynamic GPU data
 #include "Shader.h"   // Handles GLSL shader program compilation & usage
+#include "ShaderVariants.h" // Feature permutations built in the background
+#include "ShaderWatcher.h" // Rebuilds shaders whose files (or includes) changed
+#include "Texture.h"  // Asynchronously loaded, cached material textures
+#include "ThreadPool.h"
 
 bool reloadRequested = false;
+bool blinnPhongRequested = false; // Toggled with L: selects the lighting variant
+bool dynamicResolutionEnabled = true; // F toggles fixed full resolution
+bool sharpenUpscale = true;           // U: sharpening pass vs bilinear blit
+bool onDemandRendering = true; // I: draw only when something changed
+bool gridScene = false;        // G: many copies of the model (culling test)
+bool occlusionCulling = true;  // O
+bool meshletCulling = true;    // M: per-cluster frustum and back-face culling
+bool screenshotRequested = false; // P
+bool recordingToggled = false;    // V starts/stops a recording
+int heatmapView = 0;     // H cycles: scene, overdraw, fragment cost
+bool depthPrepass = false; // K: depth-only pass before the heatmap passes
+int framebufferWidth = 0, framebufferHeight = 0;
+bool windowDirty = true; // Resized, exposed or a key changed a setting
 
 // Callback to adjust OpenGL viewport when the window is resized
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
   glViewport(0, 0, width, height);
+  framebufferWidth = width;
+  framebufferHeight = height;
+  windowDirty = true;
 }
 
+// Contents damaged (uncovered, restored, ...) and need drawing again
+void window_refresh_callback(GLFWwindow *) { windowDirty = true; }
+
 void key_callback(GLFWwindow *window, int key, int scancode, int action,
                   int mods) {
   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
@@ -56,9 +99,104 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action,
 
   if (key == GLFW_KEY_R && action == GLFW_PRESS)
     reloadRequested = true;
+
+  if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    blinnPhongRequested = !blinnPhongRequested;
+
+  if (key == GLFW_KEY_F && action == GLFW_PRESS)
+    dynamicResolutionEnabled = !dynamicResolutionEnabled;
+
+  if (key == GLFW_KEY_U && action == GLFW_PRESS)
+    sharpenUpscale = !sharpenUpscale;
+
+  if (key == GLFW_KEY_I && action == GLFW_PRESS)
+    onDemandRendering = !onDemandRendering;
+
+  if (key == GLFW_KEY_G && action == GLFW_PRESS)
+    gridScene = !gridScene;
+
+  if (key == GLFW_KEY_O && action == GLFW_PRESS)
+    occlusionCulling = !occlusionCulling;
+
+  if (key == GLFW_KEY_M && action == GLFW_PRESS)
+    meshletCulling = !meshletCulling;
+
+  if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    screenshotRequested = true;
+
+  if (key == GLFW_KEY_V && action == GLFW_PRESS)
+    recordingToggled = true;
+
+  if (key == GLFW_KEY_H && action == GLFW_PRESS)
+    heatmapView = (heatmapView + 1) % 3;
+
+  if (key == GLFW_KEY_K && action == GLFW_PRESS)
+    depthPrepass = !depthPrepass;
+
+  if (action == GLFW_PRESS)
+    windowDirty = true;
 }
 
-int main() {
+// The model once, or a dense grid of copies receding from the camera where
+// the front rows hide most of the ones behind them
+std::vector<OcclusionCuller::Object> buildScene(const glm::vec3 &boundsMin,
+                                                const glm::vec3 &boundsMax,
+                                                bool grid) {
+  std::vector<OcclusionCuller::Object> objects;
+  const int columns = grid ? 32 : 1, rows = grid ? 32 : 1;
+  const float spacing = 0.8f;
+  for (int row = 0; row < rows; ++row) {
+    for (int column = 0; column < columns; ++column) {
+      const glm::vec3 offset((column - (columns - 1) * 0.5f) * spacing, 0.0f,
+                             -row * spacing);
+      objects.push_back(
+          {glm::translate(glm::mat4(1.0f), offset), boundsMin, boundsMax});
+    }
+  }
+  return objects;
+}
+
+// "captures/<prefix>-20260101-120000<extension>"
+std::string capturePath(const char *prefix, const char *extension) {
+  char stamp[32];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+  return std::string("captures/") + prefix + "-" + stamp + extension;
+}
+
+int main(int argc, char **argv) {
+  // --record PATH starts recording with the first frame; --record-frames N
+  // closes the viewer after N frames (offline capture of a fixed length).
+  // --chunks PATH shows a mesh preprocessed by meshchunk instead;
+  // --chunk-memory MiB caps its GPU memory, --chunk-upload MiB its uploads
+  // per frame and --chunk-error PIXELS the error it tolerates.
+  // --trace PATH records every GL call for glreplay
+  std::string recordPath, chunksPath, tracePath;
+  int recordFps = 60;
+  long recordFrames = 0;
+  long chunkMemory = 512, chunkUpload = 32; // MiB
+  float chunkError = 1.5f;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      recordPath = argv[++i];
+    else if (std::strcmp(argv[i], "--record-fps") == 0 && i + 1 < argc)
+      recordFps = std::max(std::atoi(argv[++i]), 1);
+    else if (std::strcmp(argv[i], "--record-frames") == 0 && i + 1 < argc)
+      recordFrames = std::atol(argv[++i]);
+    else if (std::strcmp(argv[i], "--chunks") == 0 && i + 1 < argc)
+      chunksPath = argv[++i];
+    else if (std::strcmp(argv[i], "--chunk-memory") == 0 && i + 1 < argc)
+      chunkMemory = std::max(std::atol(argv[++i]), 1L);
+    else if (std::strcmp(argv[i], "--chunk-upload") == 0 && i + 1 < argc)
+      chunkUpload = std::max(std::atol(argv[++i]), 1L);
+    else if (std::strcmp(argv[i], "--chunk-error") == 0 && i + 1 < argc)
+      chunkError = std::max(static_cast<float>(std::atof(argv[++i])), 0.1f);
+    else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+      tracePath = argv[++i];
+    else
+      std::cerr << "Unknown argument " << argv[i] << std::endl;
+  }
+  recordingToggled = !recordPath.empty();
 
   /////////////////////////////////////////////////INITIALIZATION
   /// PHASE////////////////////////////////
@@ -83,6 +221,8 @@ int main() {
 
   // Set a callback for window resize events
   glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  glfwSetWindowRefreshCallback(window, window_refresh_callback);
+  glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
   // Step 4: Load OpenGL function pointers via GLAD
   // Must be called AFTER you have a valid OpenGL context (i.e., after
@@ -94,6 +234,13 @@ int main() {
     return -1;
   }
 
+  // Before the first GL call, so replay sees every object created
+  if (!tracePath.empty())
+    GLTracer::shared().start(tracePath, framebufferWidth, framebufferHeight);
+
+  // Name GL objects for debuggers, if the driver has KHR_debug
+  GLRegistry::shared().enableLabels((GLADloadfunc)glfwGetProcAddress);
+
   // still need to understand this !!!!!
   glEnable(GL_DEPTH_TEST);
   //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -102,126 +249,446 @@ int main() {
   std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 
   // Step 5: Load and set up core objects
-  // Local for now
-  Shader shader("shaders/default.vert",
-                "shaders/default.frag"); // Loads and compiles shaders
-  ObjModel model("assets/suzanne.obj");  // Loads a 3D model from .obj file
-  Camera camera; // Camera providing view/projection matrices
-
-  // subscribe to user input for keys
-  glfwSetKeyCallback(window, key_callback);
-
-  // Step 6: Main rendering loop
-  while (!glfwWindowShouldClose(window)) {
-
-    // Check if Shader reload was requested
-    if (reloadRequested) {
-      shader.reload();
-      std::cout << "Shaders reloaded!" << std::endl;
-      reloadRequested = false;
-    }
+  // Scoped so GL objects are released while the context is still alive
+  {
+    ThreadPool workers;             // CPU work (texture decode, mip generation)
+    TextureCache textures(workers); // Shares textures between materials/models
 
-    // Clear the screen with a dark gray color
-    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+    ShaderWatcher watcher; // Hot reload on save
 
-    // still need to understand this !!!!!
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Local for now
+    ShaderVariants shaders("shaders/default.vert", "shaders/default.frag",
+                           {"DIFFUSE_MAP", "BLINN_PHONG", "INSTANCED"},
+                           &watcher); // Loads and compiles shader variants
+    ObjModel model("assets/suzanne.obj",
+                   &textures); // Loads a 3D model from .obj file
+    Camera camera;             // Camera providing view/projection matrices
+
+    // Streamed in place of the model; only what the view needs is resident
+    std::unique_ptr<ChunkedMesh> chunked;
+    if (!chunksPath.empty()) {
+      chunked = std::make_unique<ChunkedMesh>(chunksPath, workers);
+      if (!chunked->isLoaded())
+        chunked.reset();
+    }
+    if (chunked) {
+      chunked->setMemoryCap(static_cast<size_t>(chunkMemory) << 20);
+      chunked->setUploadBudget(static_cast<size_t>(chunkUpload) << 20);
+      chunked->setErrorThreshold(chunkError);
+    }
 
-    // Use shader program and set matrices
-    shader.use();
+    // Vertex-only OBJs load as point clouds, drawn with their own shader
+    PointCloud *cloud = model.pointCloud();
+    Shader pointShader("shaders/points.vert", "shaders/points.frag");
+    watcher.watch(pointShader);
+
+    // Precompile the variants this viewer can switch between at runtime
+    const ShaderVariants::Mask diffuseMapBit = shaders.feature("DIFFUSE_MAP");
+    const ShaderVariants::Mask blinnPhongBit = shaders.feature("BLINN_PHONG");
+    const ShaderVariants::Mask instancedBit = shaders.feature("INSTANCED");
+    shaders.warmUpAll(diffuseMapBit | blinnPhongBit);
+
+    // Render the scene offscreen at 25-100% resolution, adjusted to keep
+    // its GPU time under the target (~60 fps with room for the upscale)
+    DynamicResolution resolution(&watcher);
+    resolution.setTargetTime(12.0);
+    resolution.setScaleRange(0.25f, 1.0f);
+
+    // Draws only when needed (blocking in glfwWaitEventsTimeout otherwise)
+    // and at most 60 times per second, so idle viewers cost next to nothing
+    FrameScheduler scheduler(60.0);
+    scheduler.setIdleTimeout(0.25); // ShaderWatcher's polling interval
+
+    // Objects to draw, rebuilt when G switches scenes. A streamed mesh is
+    // meant to fill memory on its own, so it is never repeated in a grid
+    OcclusionCuller culler(512, &watcher);
+    const glm::vec3 boundsMin =
+        chunked ? chunked->getBoundsMin() : model.getBoundsMin();
+    const glm::vec3 boundsMax =
+        chunked ? chunked->getBoundsMax() : model.getBoundsMax();
+    bool sceneIsGrid = gridScene && !chunked;
+    std::vector<OcclusionCuller::Object> objects =
+        buildScene(boundsMin, boundsMax, sceneIsGrid);
+    std::vector<char> visible;
+    std::vector<size_t> drawList; // indices of the visible objects
+
+    // Replaces the scene while H selects a heatmap
+    OverdrawView heatmap(&watcher);
+
+    // What the last drawn frame showed, to detect changes
+    glm::vec3 drawnCameraPosition = camera.position;
+    GLuint drawnProgram = 0;
+    size_t drawnTextureBytes = 0;
+
+    // subscribe to user input for keys
+    glfwSetKeyCallback(window, key_callback);
 
-    // Identity model matrix (no transformations yet)
-    glm::mat4 modelMat = glm::mat4(1.0f);
+    // After the key callback: with ImGui its GLFW backend chains to ours
+    Overlay overlay(window);
 
-    //still need to understand this !!!!!
-    glEnable(GL_DEPTH_TEST);
-    //////////////////////////////////////////////////////////////////////////////////////////////////
-    
-    // Log the active OpenGL version
-    std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
+    // Instance transforms and other per-frame data; three regions, so the
+    // CPU writes one while the GPU may still read the two before it
+    RingBuffer frameData(256 * 1024, 3, "Per-frame data");
 
-    // Step 5: Load and set up core objects
-    // Local for now
-    Shader shader("shaders/default.vert", "shaders/default.frag"); // Loads and compiles shaders
-    ObjModel model("assets/suzanne.obj");                          // Loads a 3D model from .obj file
-    Camera camera;                                                 // Camera providing view/projection matrices
-
-    //subscribe to user input for keys
-    glfwSetKeyCallback(window, key_callback);
+    // Readbacks are fenced and mapped a few frames later; encoding and
+    // writing run on the workers, so capturing costs the loop little
+    FrameCapture capture(workers);
+    double animationTime = 0.0;
+    double lastFrameTime = glfwGetTime();
 
     // Step 6: Main rendering loop
     while (!glfwWindowShouldClose(window)) {
 
-        //Check if Shader reload was requested
-        if (reloadRequested) {
-        shader.reload();
+      // Check if Shader reload was requested
+      if (reloadRequested) {
+        shaders.reloadAll();
         std::cout << "Shaders reloaded!" << std::endl;
         reloadRequested = false;
-        }
-
-        // Clear the screen with a dark gray color
-        glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-        
-        //still need to understand this !!!!!
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // Use shader program and set matrices
-        shader.use();
+      }
 
-        // Identity model matrix (no transformations yet)
-        glm::mat4 modelMat = glm::mat4(1.0f);
-
-        // Get view matrix from camera (defines camera position/direction)
-        glm::mat4 view = camera.getViewMatrix();
+      // Rebuild only the shaders whose sources or includes were saved
+      if (watcher.poll() > 0) {
+        std::cout << "Shaders reloaded!" << std::endl;
+        scheduler.requestRedraw();
+      }
+
+      // Finish/submit background variant builds (small per-frame budget)
+      shaders.update();
+
+      // Finish textures decoded on worker threads (bounded upload per frame)
+      textures.update();
+
+      // Pick the variant for the current features; if it is still being
+      // built this returns the closest ready one instead of stalling
+      ShaderVariants::Mask features = 0;
+      if (model.hasTextures() && !chunked)
+        features |= diffuseMapBit;
+      if (blinnPhongRequested)
+        features |= blinnPhongBit;
+      // Without meshlet culling a grid is one instanced draw per material;
+      // per-object draws continue until that variant is built
+      bool instanced = false;
+      if (objects.size() > 1 && !meshletCulling && heatmapView == 0 &&
+          !cloud) {
+        instanced = shaders.isReady(features | instancedBit);
+        if (instanced)
+          features |= instancedBit;
+        else
+          shaders.warmUp(features | instancedBit);
+      }
+      Shader &shader = cloud ? pointShader : shaders.get(features);
+
+      if (recordingToggled) {
+        recordingToggled = false;
+        if (capture.isRecording())
+          capture.stopRecording();
+        else
+          capture.startRecording(recordPath.empty()
+                                     ? capturePath("recording", ".y4m")
+                                     : recordPath,
+                                 recordFps, framebufferWidth,
+                                 framebufferHeight);
+      }
+      if (screenshotRequested) {
+        screenshotRequested = false;
+        capture.screenshot(capturePath("screenshot", ".png"));
+        scheduler.requestRedraw();
+      }
+
+      // A recording needs every frame, as fast as they can be made
+      const bool recording = capture.isRecording();
+      scheduler.setMaxFps(recording ? 0.0 : 60.0);
+
+      // Decide whether anything visible changed since the last frame;
+      // heatmap statistics and timings need a steady stream of frames
+      scheduler.setOnDemand(onDemandRendering && !recording &&
+                            heatmapView == 0);
+      if (windowDirty || camera.position != drawnCameraPosition ||
+          shader.ID != drawnProgram ||
+          textures.residentBytes() != drawnTextureBytes)
+        scheduler.requestRedraw();
+      windowDirty = false;
+      // The linker drops `time` unless the shader really animates with it
+      scheduler.setAnimating(shader.hasUniform("time"));
+      scheduler.setBusy(shaders.queuedCount() > 0 ||
+                        textures.pendingCount() > 0 ||
+                        (chunked && chunked->isStreaming()) ||
+                        (cloud && cloud->isRefining()));
+
+      if (!scheduler.shouldDraw()) {
+        scheduler.waitForEvents();
+        continue;
+      }
+      drawnCameraPosition = camera.position;
+      drawnProgram = shader.ID;
+      drawnTextureBytes = textures.residentBytes();
+      frameData.beginFrame();
+
+      if (sceneIsGrid != (gridScene && !chunked)) {
+        sceneIsGrid = gridScene && !chunked;
+        objects = buildScene(boundsMin, boundsMax, sceneIsGrid);
+      }
+
+      // Get view matrix from camera (defines camera position/direction)
+      glm::mat4 view = camera.getViewMatrix();
+
+      // Calculate projection matrix based on window aspect ratio
+      const float aspect =
+          framebufferWidth / (float)std::max(framebufferHeight, 1);
+      glm::mat4 projection = camera.getProjectionMatrix(aspect);
+
+      // How many points to draw: fewer while moving, all once still
+      if (cloud)
+        cloud->update(objects[0].model, view, projection, framebufferWidth,
+                      framebufferHeight);
+
+      // Pick the octree cut for this view and stream in what it lacks
+      if (chunked)
+        chunked->update(objects[0].model, view, projection, camera.position,
+                        framebufferHeight);
+
+      // Frustum and occlusion culling; the depth pass of last frame's
+      // visible objects runs in the culler's own small framebuffer
+      culler.setOcclusionEnabled(occlusionCulling);
+      culler.cull(objects, view, projection, aspect,
+                  [&](size_t) {
+                    if (chunked)
+                      chunked->drawGeometry();
+                    else
+                      model.drawGeometry();
+                  },
+                  visible);
+
+      drawList.clear();
+      for (size_t i = 0; i < objects.size(); ++i) {
+        if (visible[i])
+          drawList.push_back(i);
+      }
+
+      // Draws the objects that survived culling, dropping their off-screen
+      // and back-facing meshlets too
+      const glm::mat4 viewProjection = projection * view;
+      Meshlets::Stats meshletStats, heatmapMeshletStats;
+      auto drawObject = [&](size_t i, Shader &with,
+                            Meshlets::Stats &stats) {
+        with.setMat4("model", glm::value_ptr(objects[i].model));
+        if (chunked)
+          chunked->draw(with);
+        else if (meshletCulling)
+          model.drawCulled(with, objects[i].model, viewProjection,
+                           camera.position, stats);
+        else
+          model.draw(with);
+      };
+
+      // Bind the (scaled) scene target; also starts the GPU timer.
+      // Recordings keep full resolution: scale changes would flicker
+      if (heatmapView == 0) {
+        resolution.setEnabled(dynamicResolutionEnabled && !recording);
+        resolution.setFilter(sharpenUpscale
+                                 ? DynamicResolution::Filter::Sharpen
+                                 : DynamicResolution::Filter::Bilinear);
+        resolution.resize(framebufferWidth, framebufferHeight);
+        resolution.beginScene();
+      }
+
+      // Clear the screen with a dark gray color
+      glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+
+      // still need to understand this !!!!!
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      // Recordings step the animation time by exactly one video frame so
+      // playback runs at real speed however slow capture is
+      const double now = glfwGetTime();
+      animationTime += recording ? capture.timeStep() : now - lastFrameTime;
+      lastFrameTime = now;
+
+      // Use a shader program and send it the matrices and time
+      auto useShader = [&](Shader &with) {
+        with.use();
+        with.setMat4("view", glm::value_ptr(view));
+        with.setMat4("projection", glm::value_ptr(projection));
+        with.setVec3("viewPos", glm::value_ptr(camera.position));
+        with.setFloat("time", static_cast<float>(animationTime));
+      };
+      useShader(shader);
+
+      if (heatmapView == 0) {
+        RingBuffer::Allocation transforms;
+        if (instanced)
+          transforms = frameData.allocate(drawList.size() * sizeof(glm::mat4));
+        if (transforms) {
+          glm::mat4 *matrices = static_cast<glm::mat4 *>(transforms.data);
+          for (size_t n = 0; n < drawList.size(); ++n)
+            matrices[n] = objects[drawList[n]].model;
+          frameData.commit();
+          model.drawInstanced(shader, transforms.buffer, transforms.offset,
+                              static_cast<GLsizei>(drawList.size()));
+        } else {
+          // No room for the transforms: the per-object variant instead
+          Shader &perObject =
+              instanced ? shaders.get(features & ~instancedBit) : shader;
+          if (&perObject != &shader)
+            useShader(perObject);
+          for (size_t i : drawList)
+            drawObject(i, perObject, meshletStats);
+        }
 
-        // Calculate projection matrix based on window aspect ratio
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        glm::mat4 projection = camera.getProjectionMatrix(width / (float)height);
+        // Upscale into the window and adapt the scale to the measured time
+        resolution.endScene();
+        overlay.remove("Heatmap");
+      } else {
+        // Fragments per pixel, or their estimated cost, at full resolution
+        heatmap.setMode(heatmapView == 1 ? OverdrawView::Mode::Overdraw
+                                         : OverdrawView::Mode::FragmentCost);
+        heatmap.setDepthPrepass(depthPrepass);
+        heatmap.resize(framebufferWidth, framebufferHeight);
+        heatmap.render(drawList, shader, view, projection,
+                       [&](size_t i, Shader &with) {
+                         drawObject(i, with, heatmapMeshletStats);
+                       });
+
+        const OverdrawView::Stats &heat = heatmap.stats();
+        char heatmapText[128];
+        if (heatmap.mode() == OverdrawView::Mode::Overdraw)
+          std::snprintf(heatmapText, sizeof(heatmapText),
+                        "overdraw %.2fx avg, %.2f per pixel, max %.0f, "
+                        "%.0f%% covered%s",
+                        heat.average, heat.screenAverage, heat.maxValue,
+                        heat.coverage * 100.0, depthPrepass ? ", prepass" : "");
+        else
+          std::snprintf(heatmapText, sizeof(heatmapText),
+                        "cost %.2f ns avg, %.2f ns per pixel, max %.2f ns%s",
+                        heat.average, heat.screenAverage, heat.maxValue,
+                        depthPrepass ? ", prepass" : "");
+        overlay.set("Heatmap", heatmapText);
+      }
+
+      char resolutionText[96];
+      std::snprintf(resolutionText, sizeof(resolutionText),
+                    "%d%% (%dx%d, %s), scene %.2f ms",
+                    static_cast<int>(resolution.scale() * 100.0f + 0.5f),
+                    resolution.renderWidth(), resolution.renderHeight(),
+                    !resolution.isEnabled() ? "native"
+                    : sharpenUpscale        ? "sharpen"
+                                            : "bilinear",
+                    resolution.gpuTime());
+      overlay.set("Resolution", resolutionText);
+
+      const OcclusionCuller::Stats &cullStats = culler.stats();
+      char cullingText[128];
+      std::snprintf(cullingText, sizeof(cullingText),
+                    "%zu objects, %zu frustum, %zu occluded%s, %zu drawn "
+                    "(%.2f ms)",
+                    cullStats.objects, cullStats.frustumCulled,
+                    cullStats.occluded, culler.isOcclusionEnabled() ? "" : " (off)",
+                    cullStats.objects - cullStats.frustumCulled -
+                        cullStats.occluded,
+                    cullStats.cpuTime);
+      overlay.set("Culling", cullingText);
+
+      // The heatmap's passes would count every meshlet several times
+      if (heatmapView == 0) {
+        char meshletText[96];
+        if (meshletCulling)
+          std::snprintf(meshletText, sizeof(meshletText),
+                        "%zu tested, %zu outside, %zu back-facing",
+                        meshletStats.total, meshletStats.outside,
+                        meshletStats.backFacing);
+        else
+          std::snprintf(meshletText, sizeof(meshletText),
+                        "off (%zu per model)", model.meshletCount());
+        overlay.set("Meshlets", meshletText);
+      }
+
+      if (cloud) {
+        char pointsText[96];
+        std::snprintf(pointsText, sizeof(pointsText), "%zu of %zu drawn%s",
+                      cloud->drawnCount(), cloud->size(),
+                      cloud->isRefining() ? ", refining" : "");
+        overlay.set("Points", pointsText);
+      }
+
+      if (chunked) {
+        const ChunkedMesh::Stats &streamStats = chunked->stats();
+        char streamingText[128];
+        std::snprintf(streamingText, sizeof(streamingText),
+                      "%zu/%zu nodes drawn/resident of %zu, %zu MiB, "
+                      "%zu queued, %zu held back by the cap",
+                      streamStats.drawn, streamStats.resident,
+                      streamStats.nodes, streamStats.residentBytes >> 20,
+                      streamStats.queued, streamStats.capLimited);
+        overlay.set("Streaming", streamingText);
+      }
+
+      const RingBuffer::Stats &frameDataStats = frameData.stats();
+      char frameDataText[96];
+      std::snprintf(frameDataText, sizeof(frameDataText),
+                    "%zu KiB (peak %zu), %zu waits, %.2f ms max",
+                    frameDataStats.usedBytes / 1024,
+                    frameDataStats.peakBytes / 1024, frameDataStats.waits,
+                    frameDataStats.maxWaitTime);
+      overlay.set("Frame data", frameDataText);
+
+      char framesText[64];
+      std::snprintf(framesText, sizeof(framesText), "%s, %.1f fps drawn",
+                    scheduler.isOnDemand() ? "on demand" : "continuous",
+                    scheduler.drawnFps());
+      overlay.set("Frames", framesText);
+
+      GLRegistry::shared().update();
+      overlay.set("GPU memory", GLRegistry::shared().summary());
+
+      const GLTracer &tracer = GLTracer::shared();
+      if (tracer.isRecording()) {
+        char traceText[96];
+        std::snprintf(traceText, sizeof(traceText),
+                      "%zu frames, %zu calls, %llu MiB", tracer.recordedFrames(),
+                      tracer.recordedCalls(),
+                      static_cast<unsigned long long>(tracer.writtenBytes() >> 20));
+        overlay.set("Trace", traceText);
+      }
+
+      // Read back the finished frame before the overlay is drawn over it
+      capture.captureFrame(framebufferWidth, framebufferHeight);
+      if (capture.isRecording()) {
+        overlay.set("Capture", "recording, " +
+                                   std::to_string(capture.recordedFrames()) +
+                                   " frames");
+        if (recordFrames > 0 &&
+            capture.recordedFrames() >= static_cast<size_t>(recordFrames)) {
+          capture.stopRecording();
+          glfwSetWindowShouldClose(window, true);
+        }
+      } else {
+        overlay.remove("Capture");
+      }
+      overlay.render();
 
-        // Send matrices to the shader
-        shader.setMat4("model", glm::value_ptr(modelMat));
-        shader.setMat4("view", glm::value_ptr(view));
-        shader.setMat4("projection", glm::value_ptr(projection));
+      // Nothing reads this frame's region after here
+      frameData.endFrame();
 
-        //Add time uniform for animation
-        float timeVal = static_cast<float>(glfwGetTime());
-        shader.setFloat("time", timeVal);
-        
-        // Draw the 3D model
-        model.draw();
+      // Hold the frame until it is due under the frame-rate cap
+      scheduler.frameDone();
+      GLTracer::shared().frameDone();
 
-        // Swap front and back buffers (double-buffered rendering)
-        glfwSwapBuffers(window);
+      // Swap front and back buffers (double-buffered rendering)
+      glfwSwapBuffers(window);
 
-        // Poll for window events (input, resize, etc.)
-        glfwPollEvents();
+      // Poll for window events (input, resize, etc.)
+      glfwPollEvents();
     }
-
-    // Calculate projection matrix based on window aspect ratio
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    glm::mat4 projection = camera.getProjectionMatrix(width / (float)height);
-
-    // Send matrices to the shader
-    shader.setMat4("model", glm::value_ptr(modelMat));
-    shader.setMat4("view", glm::value_ptr(view));
-    shader.setMat4("projection", glm::value_ptr(projection));
-
-    // Add time uniform for animation
-    float timeValue = static_cast<float>(glfwGetTime());
-    shader.setFloat("time", timeValue);
-
-    // Draw the 3D model
-    model.draw();
-
-    // Swap front and back buffers (double-buffered rendering)
-    glfwSwapBuffers(window);
-
-    // Poll for window events (input, resize, etc.)
-    glfwPollEvents();
   }
 
+  // Everything above released its GL objects; whatever is left leaked
+  GLTracer::shared().stop();
+  const GLRegistry &registry = GLRegistry::shared();
+  std::cout << "Peak tracked GPU memory: " << registry.peakBytes() / 1024
+            << " KiB" << std::endl;
+  if (const size_t leaks = registry.reportLeaks(std::cerr))
+    std::cerr << leaks << " GL objects leaked" << std::endl;
+
   // Cleanup and exit
   glfwDestroyWindow(window);
   glfwTerminate();
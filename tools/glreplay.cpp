@@ -0,0 +1,510 @@
+// glreplay: re-issues a GL trace recorded with `--trace` (GLTrace.h) in a
+// hidden window and compares the driver time of every call and frame with
+// the recording, to isolate driver and GPU costs from the application.
+//
+//   glreplay trace.gltrace [--frames A:B] [--finish] [--top N] [--csv file] [--osmesa]
+//
+// Object names, uniform locations and syncs are remapped to the ones the
+// replay context creates; client memory comes from the trace, so the
+// original scene files are not needed. Every frame before A still runs to
+// rebuild state, but only frames A..B-1 are measured. --finish waits for
+// the GPU at each frame boundary, so replayed frame times include GPU
+// work. Calls whose client memory the recorder could not size are skipped
+// and listed. Without a GPU:
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./glreplay trace.gltrace
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glad/gl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GLTraceFormat.h"
+#include "MappedFile.h"
+
+using namespace GLTraceFormat;
+using Clock = std::chrono::steady_clock;
+
+struct FunctionStats {
+    size_t calls = 0;
+    size_t skipped = 0;
+    uint64_t recordedNs = 0;
+    uint64_t replayedNs = 0;
+};
+
+struct FrameStats {
+    uint64_t recordedNs = 0;   // whole frame, as the application saw it
+    uint64_t recordedGLNs = 0; // inside GL calls
+    uint64_t replayedNs = 0;
+    uint64_t replayedGLNs = 0;
+    size_t calls = 0;
+};
+
+struct Payload {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    bool present = false;
+};
+
+class Replayer {
+public:
+    Replayer(size_t firstFrame, size_t endFrame, bool finish, GLFWwindow* window) :
+    m_FirstFrame(firstFrame),
+    m_EndFrame(endFrame),
+    m_Finish(finish),
+    m_Window(window)
+    {
+    }
+
+    // False on a malformed trace; a trace cut short (the application
+    // crashed) replays up to where it ends
+    bool run(const uint8_t* in, const uint8_t* end);
+
+    const std::vector<FrameStats>& frames() const { return m_Frames; }
+    const std::vector<FunctionStats>& functions() const { return m_Stats; }
+    const std::vector<const FunctionInfo*>& infos() const { return m_Infos; }
+
+private:
+    bool call(const uint8_t*& in, const uint8_t* end);
+    bool measuring() const { return m_Frame >= m_FirstFrame && m_Frame < m_EndFrame; }
+
+    GLuint name(Space space, uint64_t recorded) const {
+        const auto& names = m_Names[static_cast<size_t>(space)];
+        auto found = names.find(static_cast<GLuint>(recorded));
+        return found == names.end() ? static_cast<GLuint>(recorded) : found->second;
+    }
+
+    size_t m_FirstFrame, m_EndFrame;
+    bool m_Finish;
+    GLFWwindow* m_Window;
+
+    std::vector<const FunctionInfo*> m_Infos; // by trace id
+    std::vector<FunctionStats> m_Stats;
+    std::vector<FrameStats> m_Frames;
+    size_t m_Frame = 0;
+    FrameStats m_Current;
+    Clock::time_point m_FrameStart = Clock::now();
+
+    ClientState m_State;
+    std::unordered_map<GLuint, GLuint> m_Names[static_cast<size_t>(Space::Count)];
+    std::unordered_map<uint64_t, GLsync> m_Syncs;
+    std::map<std::pair<GLuint, int64_t>, GLint> m_Locations; // (recorded program, location)
+    GLuint m_Program = 0;                                    // recorded name
+    struct Mapping {
+        void* data = nullptr;
+        size_t length = 0;
+    };
+    std::unordered_map<GLenum, Mapping> m_Mappings; // by target
+    std::vector<uint8_t> m_Scratch[MaxParams + 1];
+    std::vector<const GLchar*> m_Strings;
+};
+
+bool Replayer::run(const uint8_t* in, const uint8_t* end) {
+    while (in < end) {
+        const uint8_t tag = *in++;
+        if (tag == End) {
+            return true;
+        } else if (tag == Function) {
+            uint64_t id, length;
+            if (!getVarint(in, end, id) || !getVarint(in, end, length) || length > static_cast<uint64_t>(end - in))
+                break;
+            const std::string functionName(reinterpret_cast<const char*>(in), length);
+            in += length;
+            const FunctionInfo* info = findFunction(functionName);
+            if (!info) {
+                std::cerr << functionName << " is not in this build's GLTraceFunctions.inc" << std::endl;
+                return false;
+            }
+            if (id >= m_Infos.size()) {
+                m_Infos.resize(id + 1, nullptr);
+                m_Stats.resize(id + 1);
+            }
+            m_Infos[id] = info;
+        } else if (tag == Call) {
+            if (!call(in, end))
+                return false;
+        } else if (tag == Frame) {
+            uint64_t recorded;
+            if (!getVarint(in, end, recorded))
+                break;
+            if (m_Finish)
+                glFinish();
+            glfwSwapBuffers(m_Window);
+            glfwPollEvents();
+            const auto now = Clock::now();
+            if (measuring()) {
+                m_Current.recordedNs = recorded;
+                m_Current.replayedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_FrameStart).count();
+                m_Frames.push_back(m_Current);
+            }
+            m_Current = FrameStats();
+            m_FrameStart = now;
+            if (++m_Frame >= m_EndFrame)
+                return true;
+        } else {
+            std::cerr << "Unknown record " << int(tag) << "; the trace is corrupt" << std::endl;
+            return false;
+        }
+    }
+    std::cerr << "The trace ends without an end record (did the application exit cleanly?)" << std::endl;
+    return true;
+}
+
+bool Replayer::call(const uint8_t*& in, const uint8_t* end) {
+    uint64_t id, duration, payloadCount;
+    if (!getVarint(in, end, id) || id >= m_Infos.size() || !m_Infos[id] || !getVarint(in, end, duration)) {
+        std::cerr << "Call to an undeclared function; the trace is corrupt" << std::endl;
+        return false;
+    }
+    const FunctionInfo& function = *m_Infos[id];
+    const size_t count = function.params.size();
+    Value recorded[MaxParams], args[MaxParams], result;
+    bool ok = true;
+    for (size_t i = 0; i < count; ++i)
+        ok = ok && getValue(in, end, function.params[i].kind, recorded[i]);
+    ok = ok && getValue(in, end, function.result, result) && getVarint(in, end, payloadCount);
+    Payload payloads[MaxParams + 1];
+    for (uint64_t p = 0; ok && p < payloadCount; ++p) {
+        uint64_t index, size;
+        ok = getVarint(in, end, index) && getVarint(in, end, size) && index <= count &&
+             size <= static_cast<uint64_t>(end - in);
+        if (ok) {
+            payloads[index] = {in, static_cast<size_t>(size), true};
+            in += size;
+        }
+    }
+    if (!ok) {
+        std::cerr << "Truncated " << function.name << " record" << std::endl;
+        return false;
+    }
+
+    // Rebuild the arguments for this context
+    bool skip = false;
+    for (size_t i = 0; i < count; ++i) {
+        const Param& param = function.params[i];
+        args[i] = recorded[i];
+        std::vector<uint8_t>& scratch = m_Scratch[i];
+        switch (param.role) {
+        case Role::Value:
+            break;
+        case Role::Object:
+            args[i].u = name(param.space, recorded[i].u);
+            break;
+        case Role::Location: {
+            auto found = m_Locations.find({m_Program, recorded[i].i});
+            if (found != m_Locations.end())
+                args[i].i = found->second;
+            break;
+        }
+        case Role::Sync: {
+            auto found = m_Syncs.find(recorded[i].u);
+            args[i].u = found == m_Syncs.end() ? 0 : reinterpret_cast<uintptr_t>(found->second);
+            break;
+        }
+        case Role::Objects:
+            if (payloads[i].present) {
+                scratch.resize(payloads[i].size);
+                for (size_t n = 0; n < payloads[i].size / sizeof(GLuint); ++n) {
+                    GLuint object;
+                    std::memcpy(&object, payloads[i].data + n * sizeof(GLuint), sizeof(GLuint));
+                    object = name(param.space, object);
+                    std::memcpy(scratch.data() + n * sizeof(GLuint), &object, sizeof(GLuint));
+                }
+                args[i].u = reinterpret_cast<uintptr_t>(scratch.data());
+            }
+            break;
+        case Role::CString:
+        case Role::Input:
+            if (payloads[i].present) {
+                // Copied so the driver gets aligned memory
+                scratch.assign(payloads[i].data, payloads[i].data + payloads[i].size);
+                args[i].u = reinterpret_cast<uintptr_t>(scratch.data());
+            } else if (recorded[i].u && clientBytes(function, i, recorded, m_State) == SIZE_MAX) {
+                skip = true;
+            }
+            break;
+        case Role::StringList:
+            if (payloads[i].present) {
+                scratch.assign(payloads[i].data, payloads[i].data + payloads[i].size);
+                m_Strings.clear();
+                for (size_t offset = 0; offset < scratch.size();) {
+                    const GLchar* string = reinterpret_cast<const GLchar*>(scratch.data() + offset);
+                    m_Strings.push_back(string);
+                    offset += std::strlen(string) + 1;
+                }
+                args[i].u = reinterpret_cast<uintptr_t>(m_Strings.data());
+            }
+            break;
+        case Role::NewObjects:
+        case Role::Output:
+            if (recorded[i].u) {
+                const size_t bytes = clientBytes(function, i, recorded, m_State);
+                if (bytes == SIZE_MAX) {
+                    skip = true;
+                } else if (bytes > 0) {
+                    scratch.assign(bytes, 0);
+                    args[i].u = reinterpret_cast<uintptr_t>(scratch.data());
+                }
+            }
+            break;
+        }
+    }
+
+    FunctionStats& stats = m_Stats[id];
+    m_State.observe(function, recorded);
+    if (skip) {
+        if (stats.skipped++ == 0)
+            std::cerr << "Skipping " << function.name << ": client memory of unknown size" << std::endl;
+        return true;
+    }
+
+    // What the application wrote into the mapping it is ending
+    const std::string functionName = function.name;
+    if (functionName == "glUnmapBuffer" && payloads[count].present) {
+        const Mapping& mapping = m_Mappings[static_cast<GLenum>(args[0].u)];
+        if (mapping.data)
+            std::memcpy(mapping.data, payloads[count].data, std::min(mapping.length, payloads[count].size));
+    }
+
+    const auto start = Clock::now();
+    const Value returned = function.call(args);
+    const uint64_t replayed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+    if (measuring()) {
+        ++stats.calls;
+        stats.recordedNs += duration;
+        stats.replayedNs += replayed;
+        ++m_Current.calls;
+        m_Current.recordedGLNs += duration;
+        m_Current.replayedGLNs += replayed;
+    }
+
+    // Remember what this context named the objects the recording created
+    for (size_t i = 0; i < count; ++i) {
+        const Param& param = function.params[i];
+        if (param.role == Role::NewObjects && payloads[i].present && args[i].u) {
+            auto& names = m_Names[static_cast<size_t>(param.space)];
+            const size_t n = std::min(payloads[i].size, m_Scratch[i].size()) / sizeof(GLuint);
+            for (size_t k = 0; k < n; ++k) {
+                GLuint before, after;
+                std::memcpy(&before, payloads[i].data + k * sizeof(GLuint), sizeof(GLuint));
+                std::memcpy(&after, m_Scratch[i].data() + k * sizeof(GLuint), sizeof(GLuint));
+                names[before] = after;
+            }
+        }
+    }
+    if (function.resultSpace != Space::None)
+        m_Names[static_cast<size_t>(function.resultSpace)][static_cast<GLuint>(result.u)] =
+            static_cast<GLuint>(returned.u);
+
+    if (functionName == "glUseProgram") {
+        m_Program = static_cast<GLuint>(recorded[0].u);
+    } else if (functionName == "glGetUniformLocation") {
+        m_Locations[{static_cast<GLuint>(recorded[0].u), result.i}] = static_cast<GLint>(returned.i);
+    } else if (functionName == "glFenceSync") {
+        m_Syncs[result.u] = reinterpret_cast<GLsync>(static_cast<uintptr_t>(returned.u));
+    } else if (functionName == "glDeleteSync") {
+        m_Syncs.erase(recorded[0].u);
+    } else if (functionName == "glMapBufferRange") {
+        m_Mappings[static_cast<GLenum>(args[0].u)] = {reinterpret_cast<void*>(static_cast<uintptr_t>(returned.u)),
+                                                      static_cast<size_t>(args[2].i)};
+    } else if (functionName == "glMapBuffer") {
+        GLint64 size = 0;
+        glad_glGetBufferParameteri64v(static_cast<GLenum>(args[0].u), GL_BUFFER_SIZE, &size);
+        m_Mappings[static_cast<GLenum>(args[0].u)] = {reinterpret_cast<void*>(static_cast<uintptr_t>(returned.u)),
+                                                      static_cast<size_t>(size)};
+    } else if (functionName == "glUnmapBuffer") {
+        m_Mappings.erase(static_cast<GLenum>(args[0].u));
+    }
+    return true;
+}
+
+static double ms(uint64_t ns) {
+    return ns / 1e6;
+}
+
+static bool parseRange(const std::string& text, size_t& first, size_t& end) {
+    const size_t colon = text.find(':');
+    if (colon == std::string::npos)
+        return false;
+    const std::string a = text.substr(0, colon), b = text.substr(colon + 1);
+    first = a.empty() ? 0 : std::strtoull(a.c_str(), nullptr, 10);
+    end = b.empty() ? SIZE_MAX : std::strtoull(b.c_str(), nullptr, 10);
+    return first < end;
+}
+
+static void printReport(const Replayer& replayer, size_t top) {
+    const auto& frames = replayer.frames();
+    if (frames.empty()) {
+        std::cout << "No frames measured" << std::endl;
+        return;
+    }
+
+    FrameStats total;
+    for (const auto& frame : frames) {
+        total.recordedNs += frame.recordedNs;
+        total.recordedGLNs += frame.recordedGLNs;
+        total.replayedNs += frame.replayedNs;
+        total.replayedGLNs += frame.replayedGLNs;
+        total.calls += frame.calls;
+    }
+    const double n = static_cast<double>(frames.size());
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << frames.size() << " frames, " << total.calls / frames.size() << " calls per frame\n"
+              << "                 recorded   replayed  (ms per frame)\n"
+              << "  frame       " << std::setw(11) << ms(total.recordedNs) / n << std::setw(11)
+              << ms(total.replayedNs) / n << "\n"
+              << "  in GL calls " << std::setw(11) << ms(total.recordedGLNs) / n << std::setw(11)
+              << ms(total.replayedGLNs) / n << "\n"
+              << "  outside GL  " << std::setw(11) << ms(total.recordedNs - std::min(total.recordedNs, total.recordedGLNs)) / n
+              << std::setw(11) << ms(total.replayedNs - std::min(total.replayedNs, total.replayedGLNs)) / n << "\n";
+
+    std::vector<size_t> order(frames.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return frames[a].replayedNs > frames[b].replayedNs; });
+    std::cout << "Slowest replayed frames:\n";
+    for (size_t i = 0; i < std::min<size_t>(top, order.size()); ++i) {
+        const FrameStats& frame = frames[order[i]];
+        std::cout << "  #" << std::setw(6) << std::left << order[i] << std::right << std::setw(11)
+                  << ms(frame.recordedNs) << std::setw(11) << ms(frame.replayedNs) << "  " << frame.calls
+                  << " calls\n";
+    }
+
+    const auto& stats = replayer.functions();
+    std::vector<size_t> byTime;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (stats[i].calls || stats[i].skipped)
+            byTime.push_back(i);
+    }
+    std::sort(byTime.begin(), byTime.end(),
+              [&](size_t a, size_t b) { return stats[a].replayedNs > stats[b].replayedNs; });
+    std::cout << "Most expensive functions (ms per frame, recorded / replayed):\n";
+    for (size_t i = 0; i < std::min(top, byTime.size()); ++i) {
+        const FunctionStats& s = stats[byTime[i]];
+        std::cout << "  " << std::setw(28) << std::left << replayer.infos()[byTime[i]]->name << std::right
+                  << std::setw(9) << s.calls / n << " calls" << std::setw(11) << ms(s.recordedNs) / n
+                  << std::setw(11) << ms(s.replayedNs) / n << "\n";
+    }
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (stats[i].skipped)
+            std::cout << "  skipped " << stats[i].skipped << " x " << replayer.infos()[i]->name << "\n";
+    }
+    std::cout.flush();
+}
+
+static bool writeCsv(const Replayer& replayer, size_t firstFrame, const std::string& path) {
+    std::ofstream csv(path, std::ios::trunc);
+    if (!csv) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    csv << "frame,calls,recorded_ms,recorded_gl_ms,replayed_ms,replayed_gl_ms\n";
+    const auto& frames = replayer.frames();
+    for (size_t i = 0; i < frames.size(); ++i) {
+        csv << firstFrame + i << "," << frames[i].calls << "," << ms(frames[i].recordedNs) << ","
+            << ms(frames[i].recordedGLNs) << "," << ms(frames[i].replayedNs) << "," << ms(frames[i].replayedGLNs)
+            << "\n";
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string path, csvPath;
+    size_t firstFrame = 0, endFrame = SIZE_MAX, top = 10;
+    bool finish = false;
+    bool osmesa = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc && parseRange(argv[i + 1], firstFrame, endFrame)) {
+            ++i;
+        } else if (arg == "--finish") {
+            finish = true;
+        } else if (arg == "--top" && i + 1 < argc) {
+            top = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (arg == "--osmesa") {
+            osmesa = true;
+        } else if (path.empty() && arg[0] != '-') {
+            path = arg;
+        } else {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "usage: glreplay trace.gltrace [--frames A:B] [--finish] [--top N] [--csv file] [--osmesa]"
+                  << std::endl;
+        return 2;
+    }
+
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return 1;
+    }
+    const uint8_t* in = file.data();
+    const uint8_t* end = in + file.size();
+    uint32_t header[3];
+    if (file.size() < sizeof(Magic) + sizeof(header) || std::memcmp(in, Magic, sizeof(Magic)) != 0) {
+        std::cerr << path << " is not a GL trace" << std::endl;
+        return 1;
+    }
+    std::memcpy(header, in + sizeof(Magic), sizeof(header));
+    in += sizeof(Magic) + sizeof(header);
+    if (header[0] != Version) {
+        std::cerr << path << " is trace version " << header[0] << "; this glreplay reads " << Version << std::endl;
+        return 1;
+    }
+
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    if (osmesa)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    // The default framebuffer matches the recording's
+    GLFWwindow* window = glfwCreateWindow(std::max<int>(header[1], 1), std::max<int>(header[2], 1), "glreplay",
+                                          NULL, NULL);
+    if (!window) {
+        std::cerr << "Failed to create an OpenGL 3.3 core context" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    if (!gladLoadGL(glfwGetProcAddress)) {
+        std::cerr << "Failed to load OpenGL functions" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    std::cout << "Replaying " << path << " (" << header[1] << "x" << header[2] << ") on "
+              << glGetString(GL_RENDERER) << std::endl;
+
+    Replayer replayer(firstFrame, endFrame, finish, window);
+    const bool ok = replayer.run(in, end);
+    printReport(replayer, top);
+    const bool csvOk = csvPath.empty() || writeCsv(replayer, firstFrame, csvPath);
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return ok && csvOk ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+# Regenerates include/GLTraceFunctions.inc, the list of GL functions GLTrace
+# records and glreplay re-issues, from glad's debug wrappers. Run it from
+# the repository root after regenerating glad:
+#
+#   python3 tools/gltrace_signatures.py
+#
+# Only the names and parameter declarations are taken from gl.c; the C++
+# side gets the actual types from glad's PFN typedefs.
+
+import re
+import sys
+
+SOURCE = "external/glad/gl.c"
+OUTPUT = "include/GLTraceFunctions.inc"
+
+WRAPPER = re.compile(r"^static .+? GLAD_API_PTR glad_debug_impl_(\w+)\((.*)\) \{$")
+
+
+def main():
+    functions = []
+    with open(SOURCE) as source:
+        for line in source:
+            match = WRAPPER.match(line.rstrip("\n"))
+            if not match:
+                continue
+            name, parameters = match.groups()
+            if parameters == "void":
+                parameters = ""
+            # One space around '*', so the C++ side can split on it
+            parameters = re.sub(r"\s*\*\s*", " * ", parameters)
+            functions.append((name, " ".join(parameters.split())))
+
+    if not functions:
+        sys.exit("no glad debug wrappers found in " + SOURCE)
+
+    with open(OUTPUT, "w") as output:
+        output.write("// Generated from " + SOURCE + " by tools/gltrace_signatures.py; do not edit.\n")
+        output.write("// GL_TRACE_FUNCTION(name, \"parameter declarations\")\n")
+        for name, parameters in functions:
+            output.write('GL_TRACE_FUNCTION(%s, "%s")\n' % (name, parameters))
+    print("%d functions written to %s" % (len(functions), OUTPUT))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,315 @@
+// meshchunk: converts an OBJ into the chunked format ChunkedMesh streams
+// (ChunkFormat.h), for meshes too large to load whole.
+//
+//   meshchunk input.obj output.svchunks [--leaf-triangles N] [--max-depth D] [--grid N]
+//
+// Triangles are split into an octree until a cell holds at most
+// --leaf-triangles (default 65536). Each inner node gets a simplified copy
+// of its subtree made by vertex clustering on a --grid^3 lattice over its
+// cell (default 64), and a geometric error of one lattice cell diagonal,
+// which the runtime turns into a screen-space error. The model is centered
+// and scaled like ObjModel does, so the viewer's camera frames it the same.
+//
+// The whole OBJ is loaded into memory here; only the viewer side is out of
+// core, so very large scans are converted on a machine with enough RAM.
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ChunkFormat.h"
+
+constexpr size_t kStride = ChunkFormat::FloatsPerVertex;
+constexpr size_t kTriangleStride = 3 * kStride;
+
+struct Settings {
+    size_t leafTriangles = 65536;
+    int maxDepth = 10;
+    int grid = 64;
+};
+
+struct BuildNode {
+    float boundsMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float boundsMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    float error = 0.0f;
+    std::vector<float> vertices;
+    std::vector<std::unique_ptr<BuildNode>> children;
+};
+
+static size_t triangleCount(const std::vector<float>& vertices) {
+    return vertices.size() / kTriangleStride;
+}
+
+static void computeBounds(BuildNode& node) {
+    for (size_t i = 0; i < node.vertices.size(); i += kStride) {
+        for (int axis = 0; axis < 3; ++axis) {
+            node.boundsMin[axis] = std::min(node.boundsMin[axis], node.vertices[i + axis]);
+            node.boundsMax[axis] = std::max(node.boundsMax[axis], node.vertices[i + axis]);
+        }
+    }
+}
+
+// Vertex clustering: vertices in the same lattice cell merge into their
+// average, and triangles left with fewer than three distinct cells vanish
+static std::vector<float> simplify(const std::vector<float>& vertices, const float cellMin[3], float cellSize,
+                                   int grid) {
+    struct Cluster {
+        float sum[kStride] = {};
+        uint32_t count = 0;
+    };
+    auto cellOf = [&](const float* vertex) {
+        uint64_t key = 0;
+        for (int axis = 2; axis >= 0; --axis) {
+            const int cell = static_cast<int>((vertex[axis] - cellMin[axis]) / cellSize * grid);
+            key = key * grid + std::clamp(cell, 0, grid - 1);
+        }
+        return key;
+    };
+
+    std::unordered_map<uint64_t, Cluster> clusters;
+    for (size_t i = 0; i < vertices.size(); i += kStride) {
+        Cluster& cluster = clusters[cellOf(&vertices[i])];
+        for (size_t c = 0; c < kStride; ++c)
+            cluster.sum[c] += vertices[i + c];
+        ++cluster.count;
+    }
+
+    auto emit = [&](std::vector<float>& out, uint64_t key) {
+        const Cluster& cluster = clusters[key];
+        float vertex[kStride];
+        for (size_t c = 0; c < kStride; ++c)
+            vertex[c] = cluster.sum[c] / cluster.count;
+        const float length = std::sqrt(vertex[3] * vertex[3] + vertex[4] * vertex[4] + vertex[5] * vertex[5]);
+        if (length > 0.0f) {
+            for (int c = 3; c < 6; ++c)
+                vertex[c] /= length;
+        }
+        out.insert(out.end(), vertex, vertex + kStride);
+    };
+
+    // Several triangles often collapse onto the same three cells; keep one,
+    // compared in a rotation that preserves the winding
+    const int bits = static_cast<int>(std::ceil(std::log2(double(grid) * grid * grid)));
+    std::unordered_set<uint64_t> seen;
+    std::vector<float> out;
+    for (size_t i = 0; i < vertices.size(); i += kTriangleStride) {
+        std::array<uint64_t, 3> keys = {cellOf(&vertices[i]), cellOf(&vertices[i + kStride]),
+                                        cellOf(&vertices[i + 2 * kStride])};
+        if (keys[0] == keys[1] || keys[1] == keys[2] || keys[0] == keys[2])
+            continue;
+        std::rotate(keys.begin(), std::min_element(keys.begin(), keys.end()), keys.end());
+        if (!seen.insert((keys[0] << (2 * bits)) | (keys[1] << bits) | keys[2]).second)
+            continue;
+        for (uint64_t key : keys)
+            emit(out, key);
+    }
+    return out;
+}
+
+// `cellMin`/`cellSize` describe the node's cube, which its triangles are
+// assigned to by centroid; the triangles themselves may stick out of it
+static std::unique_ptr<BuildNode> build(std::vector<float> vertices, const float cellMin[3], float cellSize,
+                                        int depth, const Settings& settings) {
+    auto node = std::make_unique<BuildNode>();
+    node->vertices = std::move(vertices);
+    computeBounds(*node);
+    if (triangleCount(node->vertices) <= settings.leafTriangles || depth >= settings.maxDepth)
+        return node;
+
+    std::array<std::vector<float>, 8> octants;
+    const float half = cellSize * 0.5f;
+    for (size_t i = 0; i < node->vertices.size(); i += kTriangleStride) {
+        int octant = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float centroid =
+                (node->vertices[i + axis] + node->vertices[i + kStride + axis] + node->vertices[i + 2 * kStride + axis]) /
+                3.0f;
+            if (centroid >= cellMin[axis] + half)
+                octant |= 1 << axis;
+        }
+        octants[octant].insert(octants[octant].end(), node->vertices.begin() + i,
+                               node->vertices.begin() + i + kTriangleStride);
+    }
+
+    // Simplify before recursing, so only one full copy of the triangles is
+    // alive at a time
+    node->vertices = simplify(node->vertices, cellMin, cellSize, settings.grid);
+
+    float childError = 0.0f;
+    for (int octant = 0; octant < 8; ++octant) {
+        if (octants[octant].empty())
+            continue;
+        const float childMin[3] = {cellMin[0] + ((octant & 1) ? half : 0.0f),
+                                   cellMin[1] + ((octant & 2) ? half : 0.0f),
+                                   cellMin[2] + ((octant & 4) ? half : 0.0f)};
+        node->children.push_back(build(std::move(octants[octant]), childMin, half, depth + 1, settings));
+        childError = std::max(childError, node->children.back()->error);
+    }
+
+    // Errors must grow towards the root, or refinement could stop above a
+    // node that is coarser than its parent claims
+    node->error = std::max(cellSize / settings.grid * std::sqrt(3.0f), childError * 1.5f);
+    return node;
+}
+
+static bool loadObj(const std::string& path, std::vector<float>& vertices, float boundsMin[3], float boundsMax[3]) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str(), nullptr)) {
+        std::cerr << "Failed to load OBJ: " << path << "\n" << err << std::endl;
+        return false;
+    }
+    if (!warn.empty())
+        std::cout << "TinyObjLoader warning: " << warn << std::endl;
+
+    float minimum[3] = {FLT_MAX, FLT_MAX, FLT_MAX}, maximum[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (size_t i = 0; i < attrib.vertices.size(); i += 3) {
+        for (int axis = 0; axis < 3; ++axis) {
+            minimum[axis] = std::min(minimum[axis], attrib.vertices[i + axis]);
+            maximum[axis] = std::max(maximum[axis], attrib.vertices[i + axis]);
+        }
+    }
+
+    // Same placement as ObjModel: centered, half size
+    const float scale = 0.5f;
+    float middle[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        middle[axis] = (minimum[axis] + maximum[axis]) * 0.5f;
+        boundsMin[axis] = (minimum[axis] - middle[axis]) * scale;
+        boundsMax[axis] = (maximum[axis] - middle[axis]) * scale;
+    }
+
+    for (const auto& shape : shapes) {
+        for (const auto& index : shape.mesh.indices) {
+            for (int axis = 0; axis < 3; ++axis)
+                vertices.push_back((attrib.vertices[3 * index.vertex_index + axis] - middle[axis]) * scale);
+            for (int axis = 0; axis < 3; ++axis)
+                vertices.push_back(index.normal_index >= 0 ? attrib.normals[3 * index.normal_index + axis] : 0.0f);
+            for (int axis = 0; axis < 2; ++axis)
+                vertices.push_back(index.texcoord_index >= 0 ? attrib.texcoords[2 * index.texcoord_index + axis]
+                                                             : 0.0f);
+        }
+    }
+    return true;
+}
+
+static void pad(std::ofstream& file, uint64_t alignment) {
+    const uint64_t position = static_cast<uint64_t>(file.tellp());
+    const uint64_t padding = (alignment - position % alignment) % alignment;
+    static const char zeros[ChunkFormat::PayloadAlignment] = {};
+    file.write(zeros, static_cast<std::streamsize>(padding));
+}
+
+int main(int argc, char** argv) {
+    std::string input, output;
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--leaf-triangles" && i + 1 < argc) {
+            settings.leafTriangles = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--max-depth" && i + 1 < argc) {
+            settings.maxDepth = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--grid" && i + 1 < argc) {
+            settings.grid = std::clamp(std::atoi(argv[++i]), 2, 128); // three cells fit 64 bits
+        } else if (input.empty() && arg[0] != '-') {
+            input = arg;
+        } else if (output.empty() && arg[0] != '-') {
+            output = arg;
+        } else {
+            input.clear();
+            break;
+        }
+    }
+    if (input.empty() || output.empty()) {
+        std::cerr << "usage: meshchunk input.obj output.svchunks [--leaf-triangles N] [--max-depth D] [--grid N]"
+                  << std::endl;
+        return 2;
+    }
+
+    std::vector<float> vertices;
+    float boundsMin[3], boundsMax[3];
+    if (!loadObj(input, vertices, boundsMin, boundsMax))
+        return 1;
+    if (vertices.empty()) {
+        std::cerr << input << " has no triangles" << std::endl;
+        return 1;
+    }
+    std::cout << "Loaded " << triangleCount(vertices) << " triangles" << std::endl;
+
+    // The octree's cells are cubes around the bounds
+    float size = 0.0f;
+    for (int axis = 0; axis < 3; ++axis)
+        size = std::max(size, boundsMax[axis] - boundsMin[axis]);
+    size = std::max(size, 1e-6f);
+    std::unique_ptr<BuildNode> root = build(std::move(vertices), boundsMin, size, 0, settings);
+
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to open " << output << std::endl;
+        return 1;
+    }
+    ChunkFormat::Header header = {};
+    std::memcpy(header.magic, ChunkFormat::Magic, sizeof(header.magic));
+    std::memcpy(header.boundsMin, boundsMin, sizeof(boundsMin));
+    std::memcpy(header.boundsMax, boundsMax, sizeof(boundsMax));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Breadth-first, so children get contiguous indices; payloads are
+    // written (and freed) as nodes are numbered
+    std::vector<ChunkFormat::Node> table;
+    std::vector<BuildNode*> queue = {root.get()};
+    size_t leafTriangles = 0;
+    for (size_t next = 0; next < queue.size(); ++next) {
+        BuildNode& node = *queue[next];
+        ChunkFormat::Node entry = {};
+        std::memcpy(entry.boundsMin, node.boundsMin, sizeof(entry.boundsMin));
+        std::memcpy(entry.boundsMax, node.boundsMax, sizeof(entry.boundsMax));
+        entry.geometricError = node.error;
+        entry.firstChild = static_cast<uint32_t>(queue.size());
+        entry.childCount = static_cast<uint32_t>(node.children.size());
+        entry.vertexCount = static_cast<uint32_t>(node.vertices.size() / kStride);
+
+        pad(file, ChunkFormat::PayloadAlignment);
+        entry.vertexOffset = static_cast<uint64_t>(file.tellp());
+        file.write(reinterpret_cast<const char*>(node.vertices.data()),
+                   static_cast<std::streamsize>(node.vertices.size() * sizeof(float)));
+        if (node.children.empty())
+            leafTriangles += triangleCount(node.vertices);
+        std::vector<float>().swap(node.vertices);
+
+        for (auto& child : node.children)
+            queue.push_back(child.get());
+        table.push_back(entry);
+    }
+
+    header.nodeCount = static_cast<uint32_t>(table.size());
+    header.nodeTableOffset = static_cast<uint64_t>(file.tellp());
+    file.write(reinterpret_cast<const char*>(table.data()),
+               static_cast<std::streamsize>(table.size() * sizeof(ChunkFormat::Node)));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file) {
+        std::cerr << "Failed to write " << output << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << output << ": " << table.size() << " nodes, " << leafTriangles
+              << " triangles at full detail, root " << table[0].vertexCount / 3 << " triangles" << std::endl;
+    return 0;
+}
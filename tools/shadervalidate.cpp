@@ -0,0 +1,490 @@
+// shadervalidate: compiles and links every shader under a directory without
+// opening a visible window, for CI gating.
+//
+//   shadervalidate [--dir shaders] [--jobs N] [--no-variants] [--osmesa] [-DNAME[=VALUE] ...]
+//
+// For each .vert/.frag pair with the same stem (and every lone .vert,
+// .frag or .geom) it
+//  - preprocesses with the viewer's ShaderPreprocessor, so logs point at the
+//    original file and line even inside #include'd files
+//  - compiles and links, printing complete driver logs
+//  - checks that fragment inputs are produced by the vertex stage with the
+//    same type
+//  - checks vertex attributes against the layout ObjModel sets up
+//    (VertexLayout.h)
+// Every combination of the feature macros a pair tests with #ifdef is
+// validated too, unless --no-variants is given. Jobs run in parallel, one
+// hidden GL context per thread. Mesa's llvmpipe works fine without a GPU:
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./shadervalidate
+// or, with a GLFW built with OSMesa support, `--osmesa` and no X server.
+// Exit status is non-zero if anything fails.
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glad/gl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+#include "VertexLayout.h"
+
+namespace fs = std::filesystem;
+
+struct Job {
+    std::string vertexPath;   // may be empty
+    std::string fragmentPath; // may be empty
+    std::string geometryPath; // lone geometry shader
+    std::vector<std::string> defines;
+};
+
+struct JobResult {
+    bool ok = true;
+    std::string report;
+};
+
+static std::string describe(const Job& job) {
+    std::string name;
+    for (const std::string* path : {&job.vertexPath, &job.fragmentPath, &job.geometryPath}) {
+        if (path->empty())
+            continue;
+        if (!name.empty())
+            name += " + ";
+        name += fs::path(*path).filename().string();
+    }
+    if (!job.defines.empty()) {
+        name += " {";
+        for (size_t i = 0; i < job.defines.size(); ++i)
+            name += (i ? "," : "") + job.defines[i];
+        name += "}";
+    }
+    return name;
+}
+
+static std::string stripComments(const std::string& source) {
+    std::string out;
+    out.reserve(source.size());
+    for (size_t i = 0; i < source.size(); ++i) {
+        if (source.compare(i, 2, "//") == 0) {
+            while (i < source.size() && source[i] != '\n')
+                ++i;
+            out += '\n';
+        } else if (source.compare(i, 2, "/*") == 0) {
+            size_t end = source.find("*/", i + 2);
+            end = end == std::string::npos ? source.size() : end + 1;
+            out.append(std::count(source.begin() + i, source.begin() + end, '\n'), '\n');
+            i = end;
+        } else {
+            out += source[i];
+        }
+    }
+    return out;
+}
+
+// Macros a shader branches on with #ifdef / #ifndef / defined(), minus the
+// ones it defines itself and GL_* extension macros
+static std::set<std::string> featureMacros(const std::string& source) {
+    static const std::regex tested(R"((?:#\s*ifn?def\s+|defined\s*\(\s*)([A-Z_][A-Z0-9_]*))");
+    static const std::regex definedHere(R"(#\s*define\s+([A-Z_][A-Z0-9_]*))");
+    std::set<std::string> features, local;
+    for (std::sregex_iterator it(source.begin(), source.end(), definedHere), end; it != end; ++it)
+        local.insert((*it)[1]);
+    for (std::sregex_iterator it(source.begin(), source.end(), tested), end; it != end; ++it) {
+        const std::string name = (*it)[1];
+        if (name.compare(0, 3, "GL_") != 0 && !local.count(name))
+            features.insert(name);
+    }
+    return features;
+}
+
+// `in`/`out` declarations (name -> type) in the active branches of a
+// preprocessed stage. Conditionals on defined-ness are evaluated; any other
+// #if is assumed true.
+static std::map<std::string, std::string> interfaceVariables(const std::string& source, const std::string& qualifier,
+                                                            const std::vector<std::string>& defines) {
+    static const std::regex directive(R"(^\s*#\s*(\w+)\s*(.*)$)");
+    static const std::regex declaration(
+        R"(^\s*(?:layout\s*\([^)]*\)\s*)?(?:(?:flat|smooth|noperspective|centroid)\s+)*(in|out)\s+(\w+)\s+(\w+)\s*(\[[^\]]*\])?\s*;)");
+    static const std::regex definedTest(R"(^(!?)\s*defined\s*\(?\s*(\w+)\s*\)?\s*$)");
+
+    std::set<std::string> defined;
+    for (const auto& define : defines)
+        defined.insert(define.substr(0, define.find('=')));
+
+    // Each level: is this branch active, and has any branch of the chain been taken
+    std::vector<std::pair<bool, bool>> stack;
+    auto active = [&] { return stack.empty() || stack.back().first; };
+    auto parentActive = [&] { return stack.size() < 2 || stack[stack.size() - 2].first; };
+    auto evaluate = [&](const std::string& keyword, const std::string& argument) {
+        std::smatch match;
+        if (keyword == "ifdef")
+            return defined.count(argument.substr(0, argument.find_first_of(" \t"))) > 0;
+        if (keyword == "ifndef")
+            return defined.count(argument.substr(0, argument.find_first_of(" \t"))) == 0;
+        if (std::regex_match(argument, match, definedTest))
+            return (defined.count(match[2]) > 0) != (match[1] == "!");
+        return true;
+    };
+
+    std::map<std::string, std::string> variables;
+    std::istringstream lines(stripComments(source));
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::smatch match;
+        if (std::regex_match(line, match, directive)) {
+            const std::string keyword = match[1], argument = match[2];
+            if (keyword == "ifdef" || keyword == "ifndef" || keyword == "if") {
+                const bool taken = active() && evaluate(keyword, argument);
+                stack.emplace_back(taken, taken);
+            } else if (keyword == "elif" && !stack.empty()) {
+                const bool taken = parentActive() && !stack.back().second && evaluate("if", argument);
+                stack.back() = {taken, stack.back().second || taken};
+            } else if (keyword == "else" && !stack.empty()) {
+                stack.back().first = parentActive() && !stack.back().second;
+            } else if (keyword == "endif" && !stack.empty()) {
+                stack.pop_back();
+            } else if (keyword == "define" && active()) {
+                defined.insert(argument.substr(0, argument.find_first_of(" \t(")));
+            }
+            continue;
+        }
+        if (active() && std::regex_search(line, match, declaration) && match[1] == qualifier)
+            variables[match[3]] = match[2].str() + match[4].str();
+    }
+    return variables;
+}
+
+static GLuint compileStage(GLenum type, const ShaderPreprocessor::Result& source, const char* label,
+                           JobResult& result) {
+    const char* code = source.source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+
+    GLint success = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    const std::string log = Shader::shaderLog(shader);
+    if (!success) {
+        result.ok = false;
+        result.report += std::string("  ") + label + " compile failed:\n" + ShaderPreprocessor::mapLog(log, source);
+        glDeleteShader(shader);
+        return 0;
+    }
+    if (!log.empty())
+        result.report += std::string("  ") + label + " warnings:\n" + ShaderPreprocessor::mapLog(log, source);
+    return shader;
+}
+
+static const char* glslTypeName(GLenum type) {
+    switch (type) {
+    case GL_FLOAT: return "float";
+    case GL_FLOAT_VEC2: return "vec2";
+    case GL_FLOAT_VEC3: return "vec3";
+    case GL_FLOAT_VEC4: return "vec4";
+    case GL_FLOAT_MAT3: return "mat3";
+    case GL_FLOAT_MAT4: return "mat4";
+    case GL_INT: return "int";
+    case GL_INT_VEC2: return "ivec2";
+    case GL_INT_VEC3: return "ivec3";
+    case GL_INT_VEC4: return "ivec4";
+    case GL_UNSIGNED_INT: return "uint";
+    default: return "?";
+    }
+}
+
+// Compares the linked program's active attributes with VertexLayout
+static void checkAttributes(GLuint program, JobResult& result) {
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i < count; ++i) {
+        char name[256];
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(program, i, sizeof(name), NULL, &size, &type, name);
+        if (std::strncmp(name, "gl_", 3) == 0)
+            continue;
+        const GLint location = glGetAttribLocation(program, name);
+
+        const VertexLayout::Attribute* expected = nullptr;
+        for (const auto& attribute : VertexLayout::Attributes) {
+            if (static_cast<GLint>(attribute.location) == location)
+                expected = &attribute;
+        }
+        if (!expected) {
+            result.ok = false;
+            result.report += "  attribute '" + std::string(name) + "' at location " + std::to_string(location) +
+                             " is not provided by ObjModel (see VertexLayout.h)\n";
+        } else if (expected->type != type) {
+            result.ok = false;
+            result.report += "  attribute '" + std::string(name) + "' at location " + std::to_string(location) +
+                             " is " + glslTypeName(type) + " but ObjModel provides " + glslTypeName(expected->type) +
+                             " " + expected->meaning + "\n";
+        }
+    }
+}
+
+static void checkInterface(const ShaderPreprocessor::Result& vertex, const ShaderPreprocessor::Result& fragment,
+                           const std::vector<std::string>& defines, JobResult& result) {
+    const auto outputs = interfaceVariables(vertex.source, "out", defines);
+    const auto inputs = interfaceVariables(fragment.source, "in", defines);
+    for (const auto& [name, type] : inputs) {
+        auto output = outputs.find(name);
+        if (output == outputs.end()) {
+            result.ok = false;
+            result.report += "  fragment input '" + type + " " + name + "' is not written by the vertex shader\n";
+        } else if (output->second != type) {
+            result.ok = false;
+            result.report += "  '" + name + "' is " + output->second + " in the vertex shader but " + type +
+                             " in the fragment shader\n";
+        }
+    }
+    for (const auto& [name, type] : outputs) {
+        if (!inputs.count(name))
+            result.report += "  warning: vertex output '" + type + " " + name + "' is unused by the fragment shader\n";
+    }
+}
+
+static JobResult runJob(const Job& job, ShaderPreprocessor& preprocessor) {
+    JobResult result;
+    struct Stage {
+        const std::string* path;
+        GLenum type;
+        const char* label;
+        ShaderPreprocessor::Result source;
+        GLuint shader = 0;
+    };
+    Stage stages[] = {{&job.vertexPath, GL_VERTEX_SHADER, "vertex", {}},
+                      {&job.geometryPath, GL_GEOMETRY_SHADER, "geometry", {}},
+                      {&job.fragmentPath, GL_FRAGMENT_SHADER, "fragment", {}}};
+
+    bool compiled = true;
+    for (Stage& stage : stages) {
+        if (stage.path->empty())
+            continue;
+        stage.source = preprocessor.preprocess(*stage.path, job.defines);
+        if (!stage.source.ok) {
+            result.ok = compiled = false;
+            result.report += "  " + stage.source.error + "\n";
+            continue;
+        }
+        stage.shader = compileStage(stage.type, stage.source, stage.label, result);
+        compiled = compiled && stage.shader;
+    }
+
+    // Lone stages cannot be linked into a complete program
+    const bool pair = !job.vertexPath.empty() && !job.fragmentPath.empty();
+    if (compiled && pair) {
+        GLuint program = glCreateProgram();
+        for (const Stage& stage : stages) {
+            if (stage.shader)
+                glAttachShader(program, stage.shader);
+        }
+        glLinkProgram(program);
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        const std::string log = Shader::programLog(program);
+        if (!success) {
+            result.ok = false;
+            result.report += "  link failed:\n" + log;
+        } else {
+            if (!log.empty())
+                result.report += "  link warnings:\n" + log;
+            checkAttributes(program, result);
+        }
+        glDeleteProgram(program);
+        checkInterface(stages[0].source, stages[2].source, job.defines, result);
+    } else if (compiled && !job.vertexPath.empty()) {
+        // Attributes can still be checked on a lone vertex shader via a
+        // program with just that stage, which GL 3.3 allows to link
+        GLuint program = glCreateProgram();
+        glAttachShader(program, stages[0].shader);
+        glLinkProgram(program);
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (success)
+            checkAttributes(program, result);
+        glDeleteProgram(program);
+    }
+
+    for (const Stage& stage : stages) {
+        if (stage.shader)
+            glDeleteShader(stage.shader);
+    }
+    return result;
+}
+
+static std::vector<Job> collectJobs(const std::string& dir, const std::vector<std::string>& defines, bool variants,
+                                    ShaderPreprocessor& preprocessor) {
+    std::map<std::string, Job> byStem;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file())
+            continue;
+        const fs::path path = entry.path();
+        const std::string stem = path.stem().string();
+        const std::string extension = path.extension().string();
+        const std::string file = path.generic_string();
+        if (extension == ".vert")
+            byStem[stem].vertexPath = file;
+        else if (extension == ".frag")
+            byStem[stem].fragmentPath = file;
+        else if (extension == ".geom")
+            byStem[stem + ".geom"].geometryPath = file;
+    }
+
+    std::vector<Job> jobs;
+    for (auto& [stem, job] : byStem) {
+        job.defines = defines;
+        std::vector<std::string> features;
+        if (variants) {
+            std::set<std::string> found;
+            for (const std::string* path : {&job.vertexPath, &job.fragmentPath, &job.geometryPath}) {
+                if (path->empty())
+                    continue;
+                auto source = preprocessor.preprocess(*path);
+                auto macros = featureMacros(source.source);
+                found.insert(macros.begin(), macros.end());
+            }
+            for (const auto& name : found) {
+                bool given = std::any_of(defines.begin(), defines.end(), [&](const std::string& define) {
+                    return define.substr(0, define.find('=')) == name;
+                });
+                if (!given)
+                    features.push_back(name);
+            }
+        }
+
+        // All combinations while that stays small; otherwise each feature alone
+        if (features.size() <= 6) {
+            for (uint32_t mask = 0; mask < (1u << features.size()); ++mask) {
+                Job variant = job;
+                for (size_t bit = 0; bit < features.size(); ++bit) {
+                    if (mask & (1u << bit))
+                        variant.defines.push_back(features[bit]);
+                }
+                jobs.push_back(variant);
+            }
+        } else {
+            jobs.push_back(job);
+            for (const auto& feature : features) {
+                Job variant = job;
+                variant.defines.push_back(feature);
+                jobs.push_back(variant);
+            }
+        }
+    }
+    return jobs;
+}
+
+int main(int argc, char** argv) {
+    std::string dir = "shaders";
+    std::vector<std::string> defines;
+    unsigned jobCount = std::max(1u, std::thread::hardware_concurrency());
+    bool variants = true;
+    bool osmesa = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobCount = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--no-variants") {
+            variants = false;
+        } else if (arg == "--osmesa") {
+            osmesa = true;
+        } else if (arg.compare(0, 2, "-D") == 0 && arg.size() > 2) {
+            defines.push_back(arg.substr(2));
+        } else {
+            std::cerr << "usage: shadervalidate [--dir shaders] [--jobs N] [--no-variants] [--osmesa] [-DNAME[=VALUE]]"
+                      << std::endl;
+            return 2;
+        }
+    }
+
+    ShaderPreprocessor preprocessor({(fs::path(dir) / "include").generic_string()});
+    const std::vector<Job> jobs = collectJobs(dir, defines, variants, preprocessor);
+    if (jobs.empty()) {
+        std::cerr << "No shaders found in " << dir << std::endl;
+        return 1;
+    }
+    jobCount = std::min<unsigned>(jobCount, static_cast<unsigned>(jobs.size()));
+
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    if (osmesa)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
+    // Windows must be created on the main thread; their contexts can then
+    // be made current on the worker threads
+    std::vector<GLFWwindow*> contexts;
+    for (unsigned i = 0; i < jobCount; ++i) {
+        GLFWwindow* window = glfwCreateWindow(16, 16, "shadervalidate", NULL, NULL);
+        if (!window)
+            break;
+        contexts.push_back(window);
+    }
+    if (contexts.empty()) {
+        std::cerr << "Failed to create an OpenGL 3.3 core context" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+
+    glfwMakeContextCurrent(contexts[0]);
+    if (!gladLoadGL(glfwGetProcAddress)) {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    std::cout << "Validating " << jobs.size() << " program(s) on " << glGetString(GL_RENDERER) << " with "
+              << contexts.size() << " thread(s)" << std::endl;
+    glfwMakeContextCurrent(NULL);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<JobResult> results(jobs.size());
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (GLFWwindow* context : contexts) {
+        workers.emplace_back([&, context] {
+            glfwMakeContextCurrent(context);
+            for (size_t i; (i = next.fetch_add(1)) < jobs.size();)
+                results[i] = runJob(jobs[i], preprocessor);
+            glfwMakeContextCurrent(NULL);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t failures = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        std::cout << (results[i].ok ? "[PASS] " : "[FAIL] ") << describe(jobs[i]) << "\n" << results[i].report;
+        failures += results[i].ok ? 0 : 1;
+    }
+    std::cout << jobs.size() - failures << "/" << jobs.size() << " passed in " << seconds << " s" << std::endl;
+
+    for (GLFWwindow* context : contexts)
+        glfwDestroyWindow(context);
+    glfwTerminate();
+    return failures == 0 ? 0 : 1;
+}
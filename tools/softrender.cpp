@@ -0,0 +1,354 @@
+// softrender: renders an OBJ with SoftwareRasterizer, the CPU backend for
+// machines without a GPU, and optionally the same frames through OpenGL
+// to compare against the driver's rasterizer (llvmpipe on those machines).
+//
+//   softrender [model.obj] [--size WxH] [--frames N] [--threads N] [--grid N]
+//              [--blinn-phong] [--scalar] [--out image.png] [--gl] [--osmesa]
+//
+// The camera orbits the model (default assets/suzanne.obj) once over
+// --frames (default 60) at 1280x720; --grid N draws N x N copies laid out
+// like the viewer's grid scene. Frame times are wall-clock from clear to
+// the finished image. --scalar turns off the AVX2 path; --threads sets the
+// pool's workers (default hardware threads - 1; the calling thread helps).
+// --out writes the last frame as PNG, and with --gl also the GL frame next
+// to it ("-gl" before the extension).
+//
+// --gl draws every frame with default.vert/default.frag into an offscreen
+// framebuffer of a hidden GL 3.3 window, with glFinish before each frame
+// time is taken, then reports both and how far the last images differ.
+// Without a GPU:
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./softrender --gl
+// or --osmesa where GLFW was built with OSMesa.
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glad/gl.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "GLResource.h"
+#include "Image.h"
+#include "ObjModel.h"
+#include "Shader.h"
+#include "SoftwareRasterizer.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Settings {
+    std::string modelPath = "assets/suzanne.obj";
+    std::string outPath;
+    int width = 1280, height = 720;
+    int frames = 60;
+    unsigned threads = 0;
+    int grid = 1;
+    bool blinnPhong = false;
+    bool scalar = false;
+    bool gl = false;
+    bool osmesa = false;
+};
+
+struct FrameTimes {
+    std::vector<double> ms;
+
+    void add(Clock::duration duration) { ms.push_back(std::chrono::duration<double, std::milli>(duration).count()); }
+    double average() const {
+        double sum = 0.0;
+        for (double t : ms)
+            sum += t;
+        return ms.empty() ? 0.0 : sum / ms.size();
+    }
+    double min() const { return ms.empty() ? 0.0 : *std::min_element(ms.begin(), ms.end()); }
+    double max() const { return ms.empty() ? 0.0 : *std::max_element(ms.begin(), ms.end()); }
+};
+
+// What one frame of the orbit sees, the same for both renderers
+struct View {
+    glm::mat4 view, projection;
+    glm::vec3 position;
+    float time;
+};
+
+static View orbitView(const Settings& settings, int frame) {
+    Camera camera;
+    const float radius = glm::length(glm::vec2(camera.position.x, camera.position.z));
+    const float angle = 6.2831853f * frame / settings.frames;
+    camera.position = glm::vec3(radius * std::sin(angle), camera.position.y, radius * std::cos(angle));
+    return {camera.getViewMatrix(), camera.getProjectionMatrix(static_cast<float>(settings.width) / settings.height),
+            camera.position, frame / 60.0f};
+}
+
+// The viewer's grid scene: rows of copies going away from the camera
+static std::vector<glm::mat4> sceneTransforms(int grid) {
+    std::vector<glm::mat4> models;
+    const float spacing = 0.8f;
+    for (int row = 0; row < grid; ++row) {
+        for (int column = 0; column < grid; ++column) {
+            const glm::vec3 offset((column - (grid - 1) * 0.5f) * spacing, 0.0f, -row * spacing);
+            models.push_back(glm::translate(glm::mat4(1.0f), offset));
+        }
+    }
+    return models;
+}
+
+static bool writePNG(const Image& image, const std::string& path) {
+    std::vector<unsigned char> png;
+    encodePNG(image, png);
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    if (!out) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << path << std::endl;
+    return true;
+}
+
+static void printTimes(const char* name, const FrameTimes& times) {
+    std::cout << std::fixed << std::setprecision(2) << name << ": " << times.average() << " ms average, "
+              << times.min() << " min, " << times.max() << " max over " << times.ms.size() << " frames" << std::endl;
+}
+
+static bool renderSoftware(const Settings& settings, Image& last, FrameTimes& times) {
+    ThreadPool pool(settings.threads);
+    ObjModel model(settings.modelPath, nullptr, "cache/meshes", ObjModel::Storage::CPU);
+    if (model.pointCloud())
+        return false;
+
+    SoftwareRasterizer target(pool, settings.width, settings.height);
+    target.setUseAvx2(!settings.scalar);
+    std::cout << "Software: " << pool.threadCount() + 1 << " threads, "
+              << (target.usesAvx2() ? "AVX2" : "scalar") << std::endl;
+
+    const std::vector<glm::mat4> models = sceneTransforms(settings.grid);
+    for (int frame = 0; frame < settings.frames; ++frame) {
+        const View view = orbitView(settings, frame);
+        const auto start = Clock::now();
+        target.clear(glm::vec3(0.2f));
+        SoftwareRasterizer::Uniforms& uniforms = target.uniforms();
+        uniforms.view = view.view;
+        uniforms.projection = view.projection;
+        uniforms.viewPos = view.position;
+        uniforms.time = view.time;
+        uniforms.blinnPhong = settings.blinnPhong;
+        for (const glm::mat4& transform : models) {
+            uniforms.model = transform;
+            model.draw(target);
+        }
+        target.finish();
+        times.add(Clock::now() - start);
+    }
+
+    const SoftwareRasterizer::Stats& stats = target.stats();
+    std::cout << std::fixed << std::setprecision(2) << "  last frame: " << stats.triangles << " triangles ("
+              << stats.culled << " culled, " << stats.clipped << " clipped), " << stats.binned << " tile bins ("
+              << stats.tilesRejected << " rejected by tile depth), " << stats.blocksRasterized << " blocks ("
+              << stats.blocksRejected << " rejected by block depth), " << stats.pixelsShaded << " pixels shaded"
+              << std::endl;
+    std::cout << "  geometry " << stats.geometryTime << " ms, raster and shading " << stats.rasterTime << " ms"
+              << std::endl;
+    last = target.image();
+    return true;
+}
+
+static bool renderGL(const Settings& settings, Image& last, FrameTimes& times) {
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    if (settings.osmesa)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "softrender", NULL, NULL);
+    if (!window) {
+        std::cerr << "Failed to create an OpenGL 3.3 core context" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGL(glfwGetProcAddress)) {
+        std::cerr << "Failed to load OpenGL functions" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    std::cout << "OpenGL: " << glGetString(GL_RENDERER) << std::endl;
+
+    bool ok = true;
+    {
+        // Uncompressed textures, to sample what the software path samples
+        ThreadPool pool(settings.threads);
+        TextureCache textures(pool, "");
+        ObjModel model(settings.modelPath, &textures);
+        std::vector<std::string> defines;
+        if (model.hasTextures())
+            defines.push_back("DIFFUSE_MAP");
+        if (settings.blinnPhong)
+            defines.push_back("BLINN_PHONG");
+        Shader shader("shaders/default.vert", "shaders/default.frag", defines);
+        while (textures.pendingCount() > 0)
+            textures.update();
+
+        // The window is only there for the context; frames go to this
+        GLFramebuffer framebuffer;
+        GLRenderbuffer color, depth;
+        const size_t pixels = static_cast<size_t>(settings.width) * settings.height;
+        color.create("softrender color", GL_HERE);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, settings.width, settings.height);
+        color.setBytes(pixels * 4);
+        depth.create("softrender depth", GL_HERE);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.width, settings.height);
+        depth.setBytes(pixels * 4); // 24-bit depth is stored in 32 bits
+        framebuffer.create("softrender", GL_HERE);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+            ok = false;
+        }
+
+        const std::vector<glm::mat4> models = sceneTransforms(settings.grid);
+        glViewport(0, 0, settings.width, settings.height);
+        glEnable(GL_DEPTH_TEST);
+        glFinish();
+        for (int frame = 0; ok && frame < settings.frames; ++frame) {
+            const View view = orbitView(settings, frame);
+            const auto start = Clock::now();
+            glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.use();
+            shader.setMat4("view", glm::value_ptr(view.view));
+            shader.setMat4("projection", glm::value_ptr(view.projection));
+            shader.setVec3("viewPos", glm::value_ptr(view.position));
+            shader.setFloat("time", view.time);
+            for (const glm::mat4& transform : models) {
+                shader.setMat4("model", glm::value_ptr(transform));
+                model.draw(shader);
+            }
+            glFinish();
+            times.add(Clock::now() - start);
+        }
+
+        // Bottom-up rows, like Image
+        last.width = settings.width;
+        last.height = settings.height;
+        last.pixels.resize(static_cast<size_t>(settings.width) * settings.height * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, settings.width, settings.height, GL_RGBA, GL_UNSIGNED_BYTE, last.pixels.data());
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return ok;
+}
+
+// Rasterization rules and float precision differ, so only report how much
+static void compareImages(const Image& software, const Image& gl) {
+    size_t differing = 0;
+    double sum = 0.0;
+    for (size_t i = 0; i + 3 < software.pixels.size() && i + 3 < gl.pixels.size(); i += 4) {
+        int largest = 0;
+        for (int c = 0; c < 3; ++c) {
+            const int difference = std::abs(software.pixels[i + c] - gl.pixels[i + c]);
+            sum += difference;
+            largest = std::max(largest, difference);
+        }
+        differing += largest > 8;
+    }
+    const size_t pixels = software.pixels.size() / 4;
+    std::cout << std::fixed << std::setprecision(2) << "Images: mean channel difference "
+              << sum / std::max<size_t>(pixels * 3, 1) << ", " << 100.0 * differing / std::max<size_t>(pixels, 1)
+              << "% of pixels differ by more than 8" << std::endl;
+}
+
+static std::string glImagePath(const std::string& path) {
+    const size_t dot = path.find_last_of('.');
+    const size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + "-gl";
+    return path.substr(0, dot) + "-gl" + path.substr(dot);
+}
+
+static bool parseSize(const char* text, int& width, int& height) {
+    return std::sscanf(text, "%dx%d", &width, &height) == 2 && width > 0 && height > 0 &&
+           width <= SoftwareRasterizer::MaxSize && height <= SoftwareRasterizer::MaxSize;
+}
+
+int main(int argc, char** argv) {
+    Settings settings;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            valid = parseSize(argv[++i], settings.width, settings.height);
+        } else if (arg == "--frames" && i + 1 < argc) {
+            settings.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            settings.threads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--grid" && i + 1 < argc) {
+            settings.grid = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--blinn-phong") {
+            settings.blinnPhong = true;
+        } else if (arg == "--scalar") {
+            settings.scalar = true;
+        } else if (arg == "--out" && i + 1 < argc) {
+            settings.outPath = argv[++i];
+        } else if (arg == "--gl") {
+            settings.gl = true;
+        } else if (arg == "--osmesa") {
+            settings.gl = settings.osmesa = true;
+        } else if (arg[0] != '-') {
+            settings.modelPath = arg;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        std::cerr << "usage: softrender [model.obj] [--size WxH] [--frames N] [--threads N] [--grid N]\n"
+                     "                  [--blinn-phong] [--scalar] [--out image.png] [--gl] [--osmesa]"
+                  << std::endl;
+        return 2;
+    }
+    std::cout << "Rendering " << settings.modelPath << " at " << settings.width << "x" << settings.height << ", "
+              << settings.frames << " frames, " << settings.grid * settings.grid << " copies" << std::endl;
+
+    Image software, gl;
+    FrameTimes softwareTimes, glTimes;
+    if (!renderSoftware(settings, software, softwareTimes))
+        return 1;
+    printTimes("Software", softwareTimes);
+    if (!settings.outPath.empty() && !writePNG(software, settings.outPath))
+        return 1;
+    if (!settings.gl)
+        return 0;
+
+    if (!renderGL(settings, gl, glTimes))
+        return 1;
+    printTimes("OpenGL", glTimes);
+    std::cout << std::fixed << std::setprecision(2) << "Software is " << glTimes.average() / softwareTimes.average()
+              << "x the speed of OpenGL" << std::endl;
+    compareImages(software, gl);
+    if (!settings.outPath.empty() && !writePNG(gl, glImagePath(settings.outPath)))
+        return 1;
+    return 0;
+}